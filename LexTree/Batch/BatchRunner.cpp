@@ -0,0 +1,289 @@
+#include "BatchRunner.h"
+#include "Scheduler.h"
+#include "ThreadPool.h"
+#include "../Instrumentation/Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+namespace lex
+{
+    namespace
+    {
+        bool within(const std::filesystem::path &path, const std::filesystem::path &directory)
+        {
+            auto [end, unused] = std::mismatch(directory.begin(), directory.end(), path.begin(), path.end());
+            return end == directory.end();
+        }
+
+        // <output_dir>/<script path below the directory holding all the scripts>.out: the input tree is mirrored,
+        // so different scripts never share a file. "" for a script whose file is already taken (listed twice).
+        std::vector<std::string> output_files(const std::string &output_dir, const std::vector<std::string> &paths)
+        {
+            namespace fs = std::filesystem;
+            std::vector<fs::path> scripts;
+            std::error_code error;
+            for (const std::string &path : paths)
+                scripts.push_back(fs::absolute(path, error).lexically_normal());
+
+            fs::path base = scripts.empty() ? fs::path() : scripts.front().parent_path();
+            for (const fs::path &script : scripts)
+            {
+                while (!within(script, base))
+                    base = base.parent_path() == base ? fs::path() : base.parent_path(); // other drives: no base
+            }
+
+            std::vector<std::string> files;
+            std::set<std::string> taken;
+            for (const fs::path &script : scripts)
+            {
+                fs::path below = base.empty() ? script.relative_path() : script.lexically_relative(base);
+                std::string file = (fs::path(output_dir) / below).string() + ".out";
+                files.push_back(taken.insert(file).second ? file : std::string());
+            }
+            return files;
+        }
+
+        std::string listed_twice(const std::string &path)
+        {
+            return "Output of " + path + " would overwrite another script's, it is listed twice\n";
+        }
+
+        // creates the directories on the way
+        bool open_output(const std::string &file, std::ofstream &out)
+        {
+            std::error_code error;
+            std::filesystem::create_directories(std::filesystem::path(file).parent_path(), error);
+            out.open(file);
+            return out.is_open();
+        }
+
+        bool read_source(const std::string &path, std::string &source)
+        {
+            std::ifstream file(path);
+            if (!file.is_open())
+                return false;
+            std::stringstream buffer;
+            buffer << file.rdbuf();
+            source = buffer.str();
+            return true;
+        }
+    }
+
+    std::vector<std::string> BatchRunner::collect(const std::string &target)
+    {
+        namespace fs = std::filesystem;
+        std::vector<std::string> paths;
+        std::error_code error;
+
+        if (fs::is_directory(target, error))
+        {
+            for (auto it = fs::recursive_directory_iterator(target, error); !error && it != fs::end(it);
+                 it.increment(error))
+            {
+                if (it->is_regular_file(error) && it->path().extension() == ".lex")
+                    paths.push_back(it->path().string());
+            }
+            std::sort(paths.begin(), paths.end());
+            return paths;
+        }
+
+        std::ifstream manifest(target);
+        fs::path base = fs::path(target).parent_path();
+        std::string line;
+        while (std::getline(manifest, line))
+        {
+            line.erase(0, line.find_first_not_of(" \t"));
+            line.erase(line.find_last_not_of(" \t\r") + 1);
+            if (line.empty() || line[0] == '#')
+                continue;
+            fs::path script(line);
+            paths.push_back(script.is_absolute() ? script.string() : (base / script).string());
+        }
+        return paths;
+    }
+
+    std::vector<BatchResult> BatchRunner::run(const std::vector<std::string> &paths)
+    {
+        std::vector<BatchResult> results(paths.size());
+        auto start = std::chrono::steady_clock::now();
+        size_t hits_before = programs.hits();
+
+        outputs.clear();
+        if (!options.output_dir.empty())
+            outputs = output_files(options.output_dir, paths);
+
+        ThreadPool pool(options.jobs);
+        if (options.slice > 0)
+        {
+            // one scheduler per worker, script i goes to worker i % workers
+            size_t workers = std::max<size_t>(std::min(pool.size(), paths.size()), 1);
+            for (size_t first = 0; first < workers; first++)
+                pool.submit([this, &paths, &results, first, workers]
+                            { run_interleaved(paths, results, first, workers); });
+        }
+        else
+        {
+            for (size_t i = 0; i < paths.size(); i++)
+                pool.submit([this, &paths, &results, i] { results[i] = run_one(paths[i], output_of(i)); });
+        }
+        pool.wait();
+
+        totals = Summary{};
+        totals.scripts = results.size();
+        totals.threads = pool.size();
+        totals.cache_hits = programs.hits() - hits_before;
+        totals.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        for (const auto &result : results)
+        {
+            if (result.status == Engine::Status::COMPILE_ERROR)
+                totals.compile_errors++;
+            else if (result.status == Engine::Status::RUNTIME_ERROR)
+                totals.runtime_errors++;
+            else if (result.status == Engine::Status::IO_ERROR)
+                totals.io_errors++;
+        }
+        return results;
+    }
+
+    std::string BatchRunner::output_of(size_t index) const
+    {
+        return outputs.empty() ? std::string() : outputs[index];
+    }
+
+    BatchResult BatchRunner::run_one(const std::string &path, const std::string &output_file)
+    {
+        BatchResult result;
+        result.path = path;
+        if (!options.output_dir.empty() && output_file.empty())
+        {
+            result.errors = listed_twice(path);
+            result.status = Engine::Status::IO_ERROR;
+            return result;
+        }
+        auto start = std::chrono::steady_clock::now();
+        LEX_TRACE_SCRIPT(path);
+
+        std::ostringstream errors;
+        try
+        {
+            std::string source;
+            std::ofstream to_file;
+            if (!read_source(path, source))
+            {
+                errors << "Could not open file: " << path << "\n";
+                result.status = Engine::Status::IO_ERROR;
+            }
+            else if (!options.output_dir.empty() && !open_output(output_file, to_file))
+            {
+                errors << "Could not write: " << output_file << "\n";
+                result.status = Engine::Status::IO_ERROR;
+            }
+            else
+            {
+                std::ostringstream memory;
+                std::ostream &out = options.output_dir.empty() ? static_cast<std::ostream &>(memory) : to_file;
+
+                Engine engine(options.engine, out, errors);
+                if (options.prelude)
+                    engine.fork(options.prelude);
+                engine.set_source(path, source);
+                result.status = engine.run(programs.get(source, options.engine, path));
+                result.output = memory.str();
+
+                if (to_file.is_open() && !to_file.flush())
+                {
+                    errors << "Could not write: " << output_file << "\n";
+                    if (result.status == Engine::Status::OK)
+                        result.status = Engine::Status::IO_ERROR;
+                }
+            }
+        }
+        catch (const std::exception &error)
+        {
+            errors << "Internal error: " << error.what() << "\n";
+            result.status = Engine::Status::RUNTIME_ERROR;
+        }
+
+        result.errors = errors.str();
+        result.milliseconds =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+
+    void BatchRunner::run_interleaved(const std::vector<std::string> &paths, std::vector<BatchResult> &results,
+                                      size_t first, size_t step)
+    {
+        struct Slot
+        {
+            size_t index = 0;
+            size_t task = 0;
+            std::ostringstream output;
+            std::ostringstream errors;
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        Scheduler scheduler(options.slice);
+        std::deque<Slot> slots; // streams the scheduler writes to, must not move
+        try
+        {
+            for (size_t i = first; i < paths.size(); i += step)
+            {
+                results[i].path = paths[i];
+                if (!options.output_dir.empty() && outputs[i].empty())
+                {
+                    results[i].errors = listed_twice(paths[i]);
+                    results[i].status = Engine::Status::IO_ERROR;
+                    continue;
+                }
+                std::string source;
+                if (!read_source(paths[i], source))
+                {
+                    results[i].errors = "Could not open file: " + paths[i] + "\n";
+                    results[i].status = Engine::Status::IO_ERROR;
+                    continue;
+                }
+                Slot &slot = slots.emplace_back();
+                slot.index = i;
+                slot.task = scheduler.add(programs.get(source, options.engine, paths[i]), options.engine, slot.output,
+                                          slot.errors, options.prelude, paths[i]);
+            }
+            scheduler.run();
+        }
+        catch (const std::exception &error)
+        {
+            for (size_t i = first; i < paths.size(); i += step)
+            {
+                results[i].errors = std::string("Internal error: ") + error.what() + "\n";
+                results[i].status = Engine::Status::RUNTIME_ERROR;
+            }
+            return;
+        }
+
+        double milliseconds =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        for (Slot &slot : slots)
+        {
+            BatchResult &result = results[slot.index];
+            result.status = scheduler.status(slot.task);
+            result.errors = slot.errors.str();
+            result.milliseconds = milliseconds;
+            if (options.output_dir.empty())
+            {
+                result.output = slot.output.str();
+                continue;
+            }
+            std::ofstream file;
+            if (!open_output(outputs[slot.index], file) || !(file << slot.output.str()).flush())
+            {
+                result.errors += "Could not write: " + outputs[slot.index] + "\n";
+                if (result.status == Engine::Status::OK)
+                    result.status = Engine::Status::IO_ERROR;
+            }
+        }
+    }
+}
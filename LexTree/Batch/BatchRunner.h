@@ -0,0 +1,71 @@
+#pragma once
+
+#include "../Engine.h"
+#include "../Cache/ProgramCache.h"
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace lex
+{
+    // outcome of one script of a batch
+    struct BatchResult
+    {
+        std::string path;
+        Engine::Status status = Engine::Status::OK;
+        std::string output; // what the script printed (empty when written to a file)
+        std::string errors; // diagnostics, same text the command line would print on stderr
+        double milliseconds = 0; // with interleaving, from the start of the worker's share until it finished
+    };
+
+    /*
+     * Runs many independent scripts on a ThreadPool, each on a fresh Engine with its own output buffer
+     * (`lextree --batch <dir|manifest>`). Results come back in input order.
+     */
+    class BatchRunner
+    {
+    public:
+        struct Options
+        {
+            EngineOptions engine;
+            size_t jobs = std::thread::hardware_concurrency(); // worker threads
+            std::string output_dir; // when set, script output goes to <output_dir>/<script>.out instead of memory,
+                                    // mirroring the tree of the scripts below their common directory
+            Snapshot prelude;       // when set, every script starts with these globals (Engine::fork)
+            uint64_t slice = 0;     // when set, each worker interleaves its share of the scripts (Scheduler) in
+                                    // slices of this many loop iterations, instead of running them one by one
+        };
+
+        struct Summary
+        {
+            size_t scripts = 0;
+            size_t compile_errors = 0;
+            size_t runtime_errors = 0;
+            size_t io_errors = 0;
+            size_t cache_hits = 0; // scripts whose program came from the ProgramCache
+            size_t threads = 0;
+            double seconds = 0;
+        };
+
+        explicit BatchRunner(Options options) : options(std::move(options)) {}
+
+        std::vector<BatchResult> run(const std::vector<std::string> &paths);
+        const Summary &summary() const { return totals; }
+
+        // every *.lex below a directory (sorted), or the lines of a manifest file (relative to the manifest,
+        // blank lines and `#` comments skipped)
+        static std::vector<std::string> collect(const std::string &target);
+
+    private:
+        Options options;
+        Summary totals;
+        ProgramCache programs;
+        std::vector<std::string> outputs; // output file of every script with output_dir, "" when it is taken
+
+        std::string output_of(size_t index) const;
+        BatchResult run_one(const std::string &path, const std::string &output_file);
+        void run_interleaved(const std::vector<std::string> &paths, std::vector<BatchResult> &results, size_t first,
+                             size_t step);
+    };
+}
@@ -0,0 +1,151 @@
+#include "Scheduler.h"
+#include "../Instrumentation/Trace.h"
+#include <deque>
+#include <streambuf>
+#include <string>
+
+namespace lex
+{
+    struct Scheduler::Task
+    {
+        // collects what the script prints, asks the engine to pause once `limit` bytes piled up
+        class Buffer : public std::streambuf
+        {
+        public:
+            explicit Buffer(size_t limit) : limit(limit) {}
+
+            std::string text;
+            Engine *engine = nullptr;
+
+        protected:
+            int_type overflow(int_type c) override
+            {
+                if (c != traits_type::eof())
+                {
+                    char ch = traits_type::to_char_type(c);
+                    append(&ch, 1);
+                }
+                return traits_type::not_eof(c);
+            }
+
+            std::streamsize xsputn(const char *data, std::streamsize size) override
+            {
+                append(data, static_cast<size_t>(size));
+                return size;
+            }
+
+        private:
+            size_t limit;
+
+            void append(const char *data, size_t size)
+            {
+                text.append(data, size);
+                if (text.size() >= limit && engine)
+                    engine->pause();
+            }
+        };
+
+        Task(size_t limit, std::ostream &out, std::ostream &err) : buffer(limit), stream(&buffer), out(out), err(err) {}
+
+        Buffer buffer;
+        std::ostream stream;
+        std::ostream &out;
+        std::ostream &err;
+        std::unique_ptr<Engine> engine; // released once the script finished
+        Engine::Status status = Engine::Status::OK;
+        std::string name;
+        uint64_t track = 0; // in the trace, every slice the task ran shows on it
+
+        void drain()
+        {
+            stream.flush();
+            out.write(buffer.text.data(), static_cast<std::streamsize>(buffer.text.size()));
+            buffer.text.clear();
+        }
+    };
+
+    Scheduler::Scheduler(uint64_t slice, size_t output_buffer)
+        : slice(slice == 0 ? DEFAULT_SLICE : slice), output_buffer(output_buffer)
+    {
+    }
+
+    Scheduler::~Scheduler() = default;
+
+    size_t Scheduler::add(const ProgramPtr &program, const EngineOptions &options, std::ostream &out,
+                          std::ostream &err, const Snapshot &prelude, const std::string &name)
+    {
+        auto task = std::make_unique<Task>(output_buffer, out, err);
+#ifdef LEXTREE_TRACING
+        if (Trace::on())
+        {
+            task->name = name.empty() ? "task " + std::to_string(tasks.size()) : name;
+            task->track = Trace::open_track(task->name);
+        }
+#else
+        (void)name;
+#endif
+        task->engine = std::make_unique<Engine>(options, task->stream, err);
+        task->buffer.engine = task->engine.get();
+        if (prelude)
+            task->engine->fork(prelude);
+        task->engine->start(program);
+        tasks.push_back(std::move(task));
+        return tasks.size() - 1;
+    }
+
+    void Scheduler::run()
+    {
+        std::deque<Task *> ready;
+        for (const auto &task : tasks)
+        {
+            if (task->engine)
+                ready.push_back(task.get());
+        }
+
+        // round robin: a task that did not finish goes to the back of the queue
+        while (!ready.empty())
+        {
+            Task &task = *ready.front();
+            ready.pop_front();
+
+            bool finished = true;
+#ifdef LEXTREE_TRACING
+            double started = Trace::on() ? Trace::now() : -1;
+#endif
+            try
+            {
+                finished = task.engine->resume(slice);
+                task.status = task.engine->status();
+            }
+            catch (const std::exception &error)
+            {
+                task.err << "Internal error: " << error.what() << "\n";
+                task.status = Engine::Status::RUNTIME_ERROR;
+            }
+            switches++;
+            task.drain();
+#ifdef LEXTREE_TRACING
+            if (started >= 0 && Trace::on())
+            {
+                Trace::span("slice", "scheduler", started, task.name);
+                Trace::track_slice(task.track, "slice", started);
+                if (finished)
+                    Trace::close_track(task.track, task.name);
+            }
+#endif
+
+            if (finished)
+            {
+                task.buffer.engine = nullptr;
+                task.engine.reset();
+            }
+            else
+                ready.push_back(&task);
+        }
+    }
+
+    Engine::Status Scheduler::status(size_t task) const
+    {
+        return tasks[task]->status;
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "../Engine.h"
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lex
+{
+    /*
+     * Runs many scripts on the calling thread by interleaving them: every task in turn gets a slice of `slice` loop
+     * iterations (Engine::start/resume), so long-running scripts share the thread fairly and none needs a thread
+     * of its own. A task's output is buffered and handed to its stream after each slice. A task that fills its
+     * buffer ends its slice early, at its next loop iteration.
+     */
+    class Scheduler
+    {
+    public:
+        static constexpr uint64_t DEFAULT_SLICE = 1000;
+        static constexpr size_t DEFAULT_OUTPUT_BUFFER = 64 * 1024;
+
+        explicit Scheduler(uint64_t slice = DEFAULT_SLICE, size_t output_buffer = DEFAULT_OUTPUT_BUFFER);
+        ~Scheduler();
+
+        Scheduler(const Scheduler &) = delete;
+        Scheduler &operator=(const Scheduler &) = delete;
+
+        // queues `program` on a fresh engine, forked from `prelude` when set. `out` and `err` must outlive run().
+        // Returns the task's index. `name` labels the task's track in a trace (Trace.h).
+        size_t add(const ProgramPtr &program, const EngineOptions &options, std::ostream &out, std::ostream &err,
+                   const Snapshot &prelude = nullptr, const std::string &name = "");
+
+        // until every task has finished
+        void run();
+
+        Engine::Status status(size_t task) const;
+        uint64_t slices() const { return switches; } // slices run so far, over all tasks
+
+    private:
+        struct Task;
+
+        uint64_t slice;
+        size_t output_buffer;
+        std::vector<std::unique_ptr<Task>> tasks;
+        uint64_t switches = 0;
+    };
+}
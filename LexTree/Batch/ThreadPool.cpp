@@ -0,0 +1,99 @@
+#include "ThreadPool.h"
+#include "../Instrumentation/Trace.h"
+
+namespace lex
+{
+    ThreadPool::ThreadPool(size_t threads)
+    {
+        if (threads == 0)
+            threads = 1;
+        for (size_t i = 0; i < threads; i++)
+            queues.push_back(std::make_unique<Queue>());
+        for (size_t i = 0; i < threads; i++)
+            workers.emplace_back(&ThreadPool::work, this, i);
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &worker : workers)
+            worker.join();
+    }
+
+    void ThreadPool::submit(std::function<void()> task)
+    {
+        // counted before it is published: a worker that takes it right away never decrements below zero
+        size_t target;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            target = next_queue++ % queues.size();
+            queued++;
+            pending++;
+        }
+        {
+            std::lock_guard<std::mutex> lock(queues[target]->mutex);
+            queues[target]->tasks.push_back(std::move(task));
+        }
+        wake.notify_one();
+    }
+
+    void ThreadPool::wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this] { return pending == 0; });
+    }
+
+    bool ThreadPool::take(size_t self, std::function<void()> &task)
+    {
+        // own deque first (front), then steal from the others (back)
+        for (size_t i = 0; i < queues.size(); i++)
+        {
+            Queue &queue = *queues[(self + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty())
+                continue;
+            if (i == 0)
+            {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+            else
+            {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void ThreadPool::work(size_t self)
+    {
+        LEX_TRACE_THREAD("worker " + std::to_string(self));
+        while (true)
+        {
+            std::function<void()> task;
+            if (take(self, task))
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    queued--;
+                }
+                task();
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--pending == 0)
+                    idle.notify_all();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || queued > 0; });
+            if (stopping && queued == 0)
+                return;
+        }
+    }
+}
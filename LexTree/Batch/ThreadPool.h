@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lex
+{
+    /*
+     * Fixed set of worker threads, each with its own task deque. A worker takes tasks from the front of its own
+     * deque and, when that is empty, steals from the back of the others, so uneven script lengths do not leave
+     * threads idle. Tasks must not throw.
+     */
+    class ThreadPool
+    {
+    public:
+        explicit ThreadPool(size_t threads = std::thread::hardware_concurrency());
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        void submit(std::function<void()> task);
+        void wait(); // until every submitted task has finished
+
+        size_t size() const { return workers.size(); }
+
+    private:
+        struct Queue
+        {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        std::vector<std::unique_ptr<Queue>> queues;
+        std::vector<std::thread> workers;
+
+        std::mutex mutex; // guards the counters below
+        std::condition_variable wake;
+        std::condition_variable idle;
+        size_t queued = 0;  // sitting in a deque
+        size_t pending = 0; // submitted and not finished
+        size_t next_queue = 0;
+        bool stopping = false;
+
+        bool take(size_t self, std::function<void()> &task);
+        void work(size_t self);
+    };
+}
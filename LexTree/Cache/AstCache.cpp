@@ -0,0 +1,829 @@
+#include "AstCache.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string_view>
+#include <unordered_map>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LEXTREE_HAS_MMAP 1
+#endif
+
+namespace lex
+{
+    namespace
+    {
+        enum class NodeKind : uint8_t
+        {
+            LITERAL, VARIABLE, GROUPING, UNARY, BINARY, LOGICAL, TERNARY, ASSIGN,
+            EXPRESSION_STMT, PRINT_STMT, VARIABLE_STMT, BLOCK_STMT, IF_STMT, WHILE_STMT, FOR_STMT,
+        };
+
+        enum class LiteralKind : uint8_t
+        {
+            NIL, STRING, NUMBER, BOOLEAN, INTEGER, // INTEGER: a whole number in [0, 2^53), stored as a varint
+        };
+
+        struct CacheHeader
+        {
+            char magic[4];
+            uint32_t version;
+            uint64_t source_size;  // the source itself follows the header and is compared byte for byte
+            uint64_t payload_hash; // everything after the source, catches a damaged file
+            uint32_t string_count;
+            uint32_t node_count;
+            uint32_t root_count;
+            uint32_t passes; // PASS_* bits, what ran on the stored program before it was written
+            uint64_t intern_nodes_before;
+            uint64_t intern_nodes_after;
+            uint64_t common_subexpressions;
+        };
+
+        /*
+         * Strings are a varint length and the bytes. A node is its kind byte followed by its operands, all varints
+         * except the operator token type (one byte) and non-integer numbers (8 bytes):
+         *   Literal         literal kind, line, then the string index, bool, integer or number bits
+         *   Variable        line, name           Assign, VariableStmt  line, name, value/initializer
+         *   Grouping        expression           Unary                 type, line, right
+         *   Binary/Logical  type, line, left, right                    Ternary  condition, then, else
+         *   Expression/Print statements          expression
+         *   Block           count, statements    If                    condition, then, else
+         *   While           condition, body      For                   initializer, condition, increment, body
+         * Lines are stored as the zigzag difference to the previous line written. A node reference is the distance
+         * back from the node that uses it (1 is the node right before it), 0 is nullptr; the roots at the end count
+         * back from one past the last node. Operator lexemes are not stored, they are the fixed spelling of the type.
+         */
+        static_assert(sizeof(CacheHeader) == 64, "CacheHeader layout is part of the file format");
+
+        constexpr char MAGIC[4] = {'L', 'E', 'X', 'C'};
+        constexpr uint32_t PASS_OPTIMIZE = 1;
+        constexpr uint32_t PASS_INTERN = 2;
+
+        uint32_t passes_of(bool optimized, bool interned)
+        {
+            return (optimized ? PASS_OPTIMIZE : 0) | (interned ? PASS_INTERN : 0);
+        }
+
+        uint64_t fnv1a(const char *data, size_t size)
+        {
+            uint64_t hash = 14695981039346656037ull;
+            for (size_t i = 0; i < size; i++)
+            {
+                hash ^= static_cast<unsigned char>(data[i]);
+                hash *= 1099511628211ull;
+            }
+            return hash;
+        }
+
+        // 7 bits per byte, low bits first, the high bit set on every byte but the last
+        void append_varint(std::string &out, uint64_t value)
+        {
+            while (value >= 0x80)
+            {
+                out.push_back(static_cast<char>(value | 0x80));
+                value >>= 7;
+            }
+            out.push_back(static_cast<char>(value));
+        }
+
+        // spelling of the operator tokens the Parser puts in Unary/Binary/Logical nodes
+        const char *operator_spelling(TokenType type)
+        {
+            switch (type)
+            {
+            case TokenType::COMMA: return ",";
+            case TokenType::MINUS: return "-";
+            case TokenType::PLUS: return "+";
+            case TokenType::SLASH: return "/";
+            case TokenType::STAR: return "*";
+            case TokenType::BANG: return "!";
+            case TokenType::BANG_EQUAL: return "!=";
+            case TokenType::EQUAL_EQUAL: return "==";
+            case TokenType::GREATER: return ">";
+            case TokenType::GREATER_EQUAL: return ">=";
+            case TokenType::LESS: return "<";
+            case TokenType::LESS_EQUAL: return "<=";
+            case TokenType::AND: return "and";
+            case TokenType::OR: return "or";
+            default: return nullptr;
+            }
+        }
+
+        class Serializer
+        {
+        public:
+            std::vector<std::string> strings;
+            std::string nodes;       // the encoded node stream
+            uint32_t node_count = 0;
+            bool supported = true; // false when a node cannot be written (a token the format does not know)
+
+            uint32_t add(const Expr *expr)
+            {
+                if (expr == nullptr)
+                    return 0;
+                auto it = indices.find(expr);
+                if (it != indices.end())
+                    return it->second;
+
+                if (auto literal = dynamic_cast<const Literal *>(expr))
+                {
+                    begin(NodeKind::LITERAL);
+                    if (std::holds_alternative<std::string>(literal->value))
+                    {
+                        literal_header(LiteralKind::STRING, literal->line);
+                        varint(string(std::get<std::string>(literal->value)));
+                    }
+                    else if (std::holds_alternative<double>(literal->value))
+                    {
+                        double number = std::get<double>(literal->value);
+                        if (number >= 0 && number < 9007199254740992.0 && number == static_cast<uint64_t>(number) &&
+                            !std::signbit(number))
+                        {
+                            literal_header(LiteralKind::INTEGER, literal->line);
+                            varint(static_cast<uint64_t>(number));
+                        }
+                        else
+                        {
+                            literal_header(LiteralKind::NUMBER, literal->line);
+                            nodes.append(reinterpret_cast<const char *>(&number), sizeof number);
+                        }
+                    }
+                    else if (std::holds_alternative<bool>(literal->value))
+                    {
+                        literal_header(LiteralKind::BOOLEAN, literal->line);
+                        varint(std::get<bool>(literal->value));
+                    }
+                    else
+                        literal_header(LiteralKind::NIL, literal->line);
+                }
+                else if (auto variable = dynamic_cast<const Variable *>(expr))
+                {
+                    begin(NodeKind::VARIABLE);
+                    name(variable->name);
+                }
+                else if (auto grouping = dynamic_cast<const Grouping *>(expr))
+                {
+                    uint32_t expression = add(grouping->expression.get());
+                    begin(NodeKind::GROUPING);
+                    reference(expression);
+                }
+                else if (auto unary = dynamic_cast<const Unary *>(expr))
+                {
+                    uint32_t right = add(unary->right.get());
+                    begin(NodeKind::UNARY);
+                    operator_token(unary->operator_token);
+                    reference(right);
+                }
+                else if (auto binary = dynamic_cast<const Binary *>(expr))
+                {
+                    uint32_t left = add(binary->left.get()), right = add(binary->right.get());
+                    begin(NodeKind::BINARY);
+                    operator_token(binary->operator_token);
+                    reference(left);
+                    reference(right);
+                }
+                else if (auto logical = dynamic_cast<const Logical *>(expr))
+                {
+                    uint32_t left = add(logical->left.get()), right = add(logical->right.get());
+                    begin(NodeKind::LOGICAL);
+                    operator_token(logical->operator_token);
+                    reference(left);
+                    reference(right);
+                }
+                else if (auto ternary = dynamic_cast<const Ternary *>(expr))
+                {
+                    uint32_t condition = add(ternary->condition.get());
+                    uint32_t then_branch = add(ternary->then_branch.get());
+                    uint32_t else_branch = add(ternary->else_branch.get());
+                    begin(NodeKind::TERNARY);
+                    reference(condition);
+                    reference(then_branch);
+                    reference(else_branch);
+                }
+                else if (auto assign = dynamic_cast<const Assign *>(expr))
+                {
+                    uint32_t value = add(assign->value.get());
+                    begin(NodeKind::ASSIGN);
+                    name(assign->name);
+                    reference(value);
+                }
+                else
+                {
+                    supported = false;
+                    begin(NodeKind::LITERAL);
+                    literal_header(LiteralKind::NIL, 0);
+                }
+                return indices[expr] = ++node_count;
+            }
+
+            uint32_t add(const Stmt *stmt)
+            {
+                if (stmt == nullptr)
+                    return 0;
+                auto it = indices.find(stmt);
+                if (it != indices.end())
+                    return it->second;
+
+                if (auto expression = dynamic_cast<const ExpressionStmt *>(stmt))
+                {
+                    uint32_t child = add(expression->expression.get());
+                    begin(NodeKind::EXPRESSION_STMT);
+                    reference(child);
+                }
+                else if (auto print = dynamic_cast<const PrintStmt *>(stmt))
+                {
+                    uint32_t child = add(print->expression.get());
+                    begin(NodeKind::PRINT_STMT);
+                    reference(child);
+                }
+                else if (auto variable = dynamic_cast<const VariableStmt *>(stmt))
+                {
+                    uint32_t initializer = add(variable->initializer.get());
+                    begin(NodeKind::VARIABLE_STMT);
+                    name(variable->name);
+                    reference(initializer);
+                }
+                else if (auto block = dynamic_cast<const BlockStmt *>(stmt))
+                {
+                    std::vector<uint32_t> items = add(block->statements);
+                    begin(NodeKind::BLOCK_STMT);
+                    varint(items.size());
+                    for (uint32_t item : items)
+                        reference(item);
+                }
+                else if (auto if_stmt = dynamic_cast<const IfStmt *>(stmt))
+                {
+                    uint32_t condition = add(if_stmt->condition.get());
+                    uint32_t then_branch = add(if_stmt->then_branch.get());
+                    uint32_t else_branch = add(if_stmt->else_branch.get());
+                    begin(NodeKind::IF_STMT);
+                    reference(condition);
+                    reference(then_branch);
+                    reference(else_branch);
+                }
+                else if (auto while_stmt = dynamic_cast<const WhileStmt *>(stmt))
+                {
+                    uint32_t condition = add(while_stmt->condition.get()), body = add(while_stmt->body.get());
+                    begin(NodeKind::WHILE_STMT);
+                    reference(condition);
+                    reference(body);
+                }
+                else if (auto for_stmt = dynamic_cast<const ForStmt *>(stmt))
+                {
+                    uint32_t parts[4] = {add(for_stmt->initializer.get()), add(for_stmt->condition.get()),
+                                         add(for_stmt->increment.get()), add(for_stmt->body.get())};
+                    begin(NodeKind::FOR_STMT);
+                    for (uint32_t part : parts)
+                        reference(part);
+                }
+                else
+                {
+                    supported = false;
+                    begin(NodeKind::BLOCK_STMT);
+                    varint(0);
+                }
+                return indices[stmt] = ++node_count;
+            }
+
+            std::vector<uint32_t> add(const std::vector<StmtPtr> &statements)
+            {
+                std::vector<uint32_t> items;
+                items.reserve(statements.size());
+                for (const auto &statement : statements)
+                    items.push_back(add(statement.get()));
+                return items;
+            }
+
+            // the roots follow the last node, so they count back from one past it
+            void roots(const std::vector<uint32_t> &items)
+            {
+                for (uint32_t item : items)
+                    reference(item);
+            }
+
+        private:
+            std::unordered_map<const void *, uint32_t> indices;
+            std::unordered_map<std::string, uint32_t> string_indices;
+            int last_line = 0;
+
+            void varint(uint64_t value)
+            {
+                append_varint(nodes, value);
+            }
+
+            void line(int at)
+            {
+                int64_t delta = int64_t(at) - last_line;
+                last_line = at;
+                varint(delta < 0 ? (uint64_t(-delta) << 1) - 1 : uint64_t(delta) << 1);
+            }
+
+            void begin(NodeKind kind)
+            {
+                nodes.push_back(static_cast<char>(kind));
+            }
+
+            // `operand` is index + 1 of a node written before this one (node_count + 1 is this node)
+            void reference(uint32_t operand)
+            {
+                varint(operand == 0 ? 0 : node_count + 1 - operand);
+            }
+
+            void literal_header(LiteralKind kind, int at)
+            {
+                nodes.push_back(static_cast<char>(kind));
+                line(at);
+            }
+
+            uint32_t string(const std::string &text)
+            {
+                auto [it, inserted] = string_indices.try_emplace(text, static_cast<uint32_t>(strings.size()));
+                if (inserted)
+                    strings.push_back(text);
+                return it->second;
+            }
+
+            void name(const Token &token)
+            {
+                if (token.type != TokenType::IDENTIFIER)
+                    supported = false;
+                line(token.line);
+                varint(string(token.lexeme));
+            }
+
+            void operator_token(const Token &token)
+            {
+                const char *spelling = operator_spelling(token.type);
+                if (spelling == nullptr || token.lexeme != spelling)
+                    supported = false;
+                nodes.push_back(static_cast<char>(token.type));
+                line(token.line);
+            }
+        };
+
+        // the cache file, mapped when the platform allows it
+        class MappedFile
+        {
+        public:
+            explicit MappedFile(const std::string &path)
+            {
+#ifdef LEXTREE_HAS_MMAP
+                int fd = ::open(path.c_str(), O_RDONLY);
+                if (fd < 0)
+                    return;
+                struct stat info;
+                if (::fstat(fd, &info) == 0 && info.st_size > 0)
+                {
+                    void *mapped = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (mapped != MAP_FAILED)
+                    {
+                        bytes = static_cast<const char *>(mapped);
+                        length = static_cast<size_t>(info.st_size);
+                    }
+                }
+                ::close(fd);
+#else
+                std::ifstream file(path, std::ios::binary);
+                if (!file)
+                    return;
+                buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+                bytes = buffer.data();
+                length = buffer.size();
+#endif
+            }
+
+            ~MappedFile()
+            {
+#ifdef LEXTREE_HAS_MMAP
+                if (bytes)
+                    ::munmap(const_cast<char *>(bytes), length);
+#endif
+            }
+
+            MappedFile(const MappedFile &) = delete;
+            MappedFile &operator=(const MappedFile &) = delete;
+
+            const char *data() const { return bytes; }
+            size_t size() const { return length; }
+
+        private:
+            const char *bytes = nullptr;
+            size_t length = 0;
+#ifndef LEXTREE_HAS_MMAP
+            std::string buffer;
+#endif
+        };
+
+        // rebuilds the AST, every operand is checked so a bad file is a cache miss and never a crash
+        class Deserializer
+        {
+        public:
+            bool valid = true;
+
+            Deserializer(const char *data, size_t size, uint32_t node_count)
+                : at(data), end(data + size), exprs(node_count), stmts(node_count)
+            {
+            }
+
+            void read_strings(uint32_t count)
+            {
+                strings.reserve(count);
+                for (uint32_t i = 0; i < count && valid; i++)
+                {
+                    uint64_t length = varint();
+                    if (length > uint64_t(end - at))
+                    {
+                        valid = false;
+                        return;
+                    }
+                    strings.emplace_back(at, static_cast<size_t>(length));
+                    at += length;
+                }
+            }
+
+            void build(uint32_t index)
+            {
+                current = index;
+                switch (static_cast<NodeKind>(byte()))
+                {
+                case NodeKind::LITERAL:
+                    exprs[index] = literal();
+                    break;
+                case NodeKind::VARIABLE:
+                    exprs[index] = make_Variable(name());
+                    break;
+                case NodeKind::GROUPING:
+                    exprs[index] = make_Grouping(expr(true));
+                    break;
+                case NodeKind::UNARY:
+                {
+                    Token token = operator_token();
+                    exprs[index] = make_Unary(std::move(token), expr(true));
+                    break;
+                }
+                case NodeKind::BINARY:
+                {
+                    Token token = operator_token();
+                    ExprPtr left = expr(true);
+                    exprs[index] = make_Binary(std::move(left), std::move(token), expr(true));
+                    break;
+                }
+                case NodeKind::LOGICAL:
+                {
+                    Token token = operator_token();
+                    ExprPtr left = expr(true);
+                    exprs[index] = make_Logical(std::move(left), std::move(token), expr(true));
+                    break;
+                }
+                case NodeKind::TERNARY:
+                {
+                    ExprPtr condition = expr(true);
+                    ExprPtr then_branch = expr(true);
+                    exprs[index] = make_Ternary(std::move(condition), std::move(then_branch), expr(true));
+                    break;
+                }
+                case NodeKind::ASSIGN:
+                {
+                    Token token = name();
+                    exprs[index] = make_Assign(std::move(token), expr(true));
+                    break;
+                }
+                case NodeKind::EXPRESSION_STMT:
+                    stmts[index] = make_ExpressionStmt(expr(true));
+                    break;
+                case NodeKind::PRINT_STMT:
+                    stmts[index] = make_PrintStmt(expr(true));
+                    break;
+                case NodeKind::VARIABLE_STMT:
+                {
+                    Token token = name();
+                    stmts[index] = make_VariableStmt(std::move(token), expr(false));
+                    break;
+                }
+                case NodeKind::BLOCK_STMT:
+                    stmts[index] = make_BlockStmt(statements());
+                    break;
+                case NodeKind::IF_STMT:
+                {
+                    ExprPtr condition = expr(true);
+                    StmtPtr then_branch = stmt(true);
+                    stmts[index] = make_IfStmt(std::move(condition), std::move(then_branch), stmt(false));
+                    break;
+                }
+                case NodeKind::WHILE_STMT:
+                {
+                    ExprPtr condition = expr(true);
+                    stmts[index] = make_WhileStmt(std::move(condition), stmt(true));
+                    break;
+                }
+                case NodeKind::FOR_STMT:
+                {
+                    StmtPtr initializer = stmt(false);
+                    ExprPtr condition = expr(false);
+                    ExprPtr increment = expr(false);
+                    stmts[index] = make_ForStmt(std::move(initializer), std::move(condition), std::move(increment),
+                                                stmt(true));
+                    break;
+                }
+                default:
+                    valid = false;
+                }
+            }
+
+            // the roots, read once every node is built; the whole input has to be used up
+            std::vector<StmtPtr> roots(uint32_t count)
+            {
+                current = static_cast<uint32_t>(stmts.size());
+                std::vector<StmtPtr> result = statements(count);
+                if (at != end)
+                    valid = false;
+                return result;
+            }
+
+        private:
+            const char *at;
+            const char *end;
+            std::vector<std::string_view> strings;
+            std::vector<ExprPtr> exprs;
+            std::vector<StmtPtr> stmts;
+            uint32_t current = 0;
+            int last_line = 0;
+
+            uint8_t byte()
+            {
+                if (at == end)
+                {
+                    valid = false;
+                    return 0xff;
+                }
+                return static_cast<uint8_t>(*at++);
+            }
+
+            uint64_t varint()
+            {
+                uint64_t value = 0;
+                for (int shift = 0; shift < 64; shift += 7)
+                {
+                    uint8_t next = byte();
+                    value |= uint64_t(next & 0x7f) << shift;
+                    if ((next & 0x80) == 0)
+                        return value;
+                }
+                valid = false;
+                return 0;
+            }
+
+            int line()
+            {
+                uint64_t zigzag = varint();
+                int64_t delta = zigzag & 1 ? -int64_t((zigzag + 1) >> 1) : int64_t(zigzag >> 1);
+                last_line = static_cast<int>(last_line + delta);
+                return last_line;
+            }
+
+            // operands may only point backwards, which also rules out cycles; returns index + 1, 0 for none
+            uint32_t operand(bool required)
+            {
+                uint64_t distance = varint();
+                if (distance == 0 || distance > current)
+                {
+                    if (distance != 0 || required)
+                        valid = false;
+                    return 0;
+                }
+                return static_cast<uint32_t>(current + 1 - distance);
+            }
+
+            ExprPtr expr(bool required)
+            {
+                uint32_t index = operand(required);
+                if (index == 0)
+                    return nullptr;
+                if (exprs[index - 1] == nullptr)
+                    valid = false;
+                return exprs[index - 1];
+            }
+
+            StmtPtr stmt(bool required)
+            {
+                uint32_t index = operand(required);
+                if (index == 0)
+                    return nullptr;
+                if (stmts[index - 1] == nullptr)
+                    valid = false;
+                return stmts[index - 1];
+            }
+
+            std::vector<StmtPtr> statements(uint64_t count)
+            {
+                std::vector<StmtPtr> result;
+                if (count > uint64_t(end - at)) // every reference takes at least one byte
+                {
+                    valid = false;
+                    return result;
+                }
+                result.reserve(static_cast<size_t>(count));
+                for (uint64_t i = 0; i < count && valid; i++)
+                    result.push_back(stmt(true));
+                return result;
+            }
+
+            std::vector<StmtPtr> statements()
+            {
+                return statements(varint());
+            }
+
+            std::string string()
+            {
+                uint64_t index = varint();
+                if (index >= strings.size())
+                {
+                    valid = false;
+                    return {};
+                }
+                return std::string(strings[index]);
+            }
+
+            ExprPtr literal()
+            {
+                auto kind = static_cast<LiteralKind>(byte());
+                int at_line = line();
+                switch (kind)
+                {
+                case LiteralKind::STRING:
+                    return make_Literal(string(), at_line);
+                case LiteralKind::NUMBER:
+                {
+                    double number = 0;
+                    if (uint64_t(end - at) < sizeof number)
+                    {
+                        valid = false;
+                        return nullptr;
+                    }
+                    std::memcpy(&number, at, sizeof number);
+                    at += sizeof number;
+                    return make_Literal(number, at_line);
+                }
+                case LiteralKind::INTEGER:
+                    return make_Literal(static_cast<double>(varint()), at_line);
+                case LiteralKind::BOOLEAN:
+                    return make_Literal(varint() != 0, at_line);
+                case LiteralKind::NIL:
+                    return make_Literal(std::monostate{}, at_line);
+                }
+                valid = false;
+                return nullptr;
+            }
+
+            Token name()
+            {
+                int at_line = line();
+                return Token(TokenType::IDENTIFIER, string(), std::monostate{}, at_line);
+            }
+
+            Token operator_token()
+            {
+                auto type = static_cast<TokenType>(byte());
+                const char *spelling = operator_spelling(type);
+                if (spelling == nullptr)
+                {
+                    valid = false;
+                    spelling = "";
+                }
+                return Token(type, spelling, std::monostate{}, line());
+            }
+        };
+    }
+
+    uint64_t AstCache::hash(const std::string &source)
+    {
+        return fnv1a(source.data(), source.size());
+    }
+
+    std::string AstCache::path_for(const std::string &script, const std::string &source)
+    {
+        const char *directory = std::getenv("LEXTREE_CACHE_DIR");
+        if (directory && *directory)
+        {
+            char name[32];
+            std::snprintf(name, sizeof name, "%016llx.lexc", static_cast<unsigned long long>(hash(source)));
+            return std::string(directory) + "/" + name;
+        }
+
+        size_t slash = script.find_last_of("/\\");
+        size_t dot = script.find_last_of('.');
+        if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+            return script.substr(0, dot) + ".lexc";
+        return script + ".lexc";
+    }
+
+    ProgramPtr AstCache::load(const std::string &path, const std::string &source, bool optimize, bool intern)
+    {
+        MappedFile file(path);
+        if (file.data() == nullptr || file.size() < sizeof(CacheHeader))
+            return nullptr;
+
+        CacheHeader header;
+        std::memcpy(&header, file.data(), sizeof header);
+        if (std::memcmp(header.magic, MAGIC, sizeof MAGIC) != 0 || header.version != VERSION ||
+            header.passes != passes_of(optimize, intern) || header.source_size != source.size() ||
+            file.size() - sizeof(CacheHeader) < header.source_size)
+            return nullptr;
+
+        // the cache belongs to this exact source, a hash match alone is not enough
+        const char *stored_source = file.data() + sizeof(CacheHeader);
+        if (std::memcmp(stored_source, source.data(), source.size()) != 0)
+            return nullptr;
+
+        const char *payload = stored_source + source.size();
+        size_t payload_size = file.size() - sizeof(CacheHeader) - source.size();
+        if (fnv1a(payload, payload_size) != header.payload_hash)
+            return nullptr;
+        if (header.node_count > payload_size || header.string_count > payload_size) // one byte each at least
+            return nullptr;
+
+        Deserializer deserializer(payload, payload_size, header.node_count);
+        deserializer.read_strings(header.string_count);
+        for (uint32_t i = 0; i < header.node_count && deserializer.valid; i++)
+            deserializer.build(i);
+        if (!deserializer.valid)
+            return nullptr;
+
+        std::vector<StmtPtr> statements = deserializer.roots(header.root_count);
+        if (!deserializer.valid)
+            return nullptr;
+
+        InternStats interned;
+        interned.nodes_before = static_cast<size_t>(header.intern_nodes_before);
+        interned.nodes_after = static_cast<size_t>(header.intern_nodes_after);
+        interned.common_subexpressions = static_cast<size_t>(header.common_subexpressions);
+        return std::make_shared<const Program>(std::move(statements), std::vector<std::pair<int, std::string>>{},
+                                               optimize, intern, interned);
+    }
+
+    bool AstCache::store(const std::string &path, const std::string &source, const Program &program)
+    {
+        if (!program.errors.empty())
+            return false;
+
+        Serializer serializer;
+        std::vector<uint32_t> roots = serializer.add(program.statements);
+        serializer.roots(roots);
+        if (!serializer.supported)
+            return false;
+
+        CacheHeader header{};
+        std::memcpy(header.magic, MAGIC, sizeof MAGIC);
+        header.version = VERSION;
+        header.source_size = source.size();
+        header.string_count = static_cast<uint32_t>(serializer.strings.size());
+        header.node_count = serializer.node_count;
+        header.root_count = static_cast<uint32_t>(roots.size());
+        header.passes = passes_of(program.optimized, program.interned);
+        header.intern_nodes_before = program.intern_stats.nodes_before;
+        header.intern_nodes_after = program.intern_stats.nodes_after;
+        header.common_subexpressions = program.intern_stats.common_subexpressions;
+
+        // the payload is assembled in memory first, its hash goes into the header
+        std::string payload;
+        for (const auto &text : serializer.strings)
+        {
+            append_varint(payload, text.size());
+            payload += text;
+        }
+        payload += serializer.nodes;
+        header.payload_hash = fnv1a(payload.data(), payload.size());
+
+        // written under a temporary name and renamed, a concurrent reader never sees half a file
+        std::string temporary = path + ".tmp" + std::to_string(reinterpret_cast<uintptr_t>(&serializer));
+#ifdef LEXTREE_HAS_MMAP
+        temporary += "." + std::to_string(::getpid());
+#endif
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            if (!out)
+                return false;
+            out.write(reinterpret_cast<const char *>(&header), sizeof header);
+            out.write(source.data(), static_cast<std::streamsize>(source.size()));
+            out.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+            if (!out)
+            {
+                out.close();
+                std::remove(temporary.c_str());
+                return false;
+            }
+        }
+        if (std::rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            std::remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+}
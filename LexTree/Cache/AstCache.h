@@ -0,0 +1,38 @@
+#pragma once
+
+#include "../Program.h"
+#include <cstdint>
+#include <string>
+
+namespace lex
+{
+    /*
+     * `.lexc` files: the compiled program of a script (after the Optimizer and, with `--intern`, the Interner) in a
+     * compact binary form, so a script that did not change skips the Lexer, the Parser and those passes
+     * (`lextree --cache script.lex`).
+     *
+     * Layout (native byte order):
+     *     CacheHeader                                                   -- passes that ran, intern stats
+     *     char source[source_size]                                      -- the script the cache was made from
+     *     string_count times: varint length, bytes                      -- lexemes and string literals
+     *     node_count nodes: kind byte, operands (mostly varints)        -- children before parents
+     *     root_count varint node references                             -- the top-level statements
+     * The nodes are not usable in place: loading reads the file once, front to back, and allocates one AST node
+     * per encoded node. A cache whose magic, version, passes or stored source does not match, or that fails
+     * validation, is ignored and rewritten.
+     */
+    class AstCache
+    {
+    public:
+        // 2: literals keep their line, 3: source stored, varint encoding, 4: optimized/interned program stored
+        static constexpr uint32_t VERSION = 4;
+
+        // where the cache of `script` lives: next to it (`script.lexc`) or `$LEXTREE_CACHE_DIR/<source hash>.lexc`
+        static std::string path_for(const std::string &script, const std::string &source);
+        static uint64_t hash(const std::string &source); // FNV-1a
+
+        // the program stored for `source` when it went through the same passes, nullptr otherwise
+        static ProgramPtr load(const std::string &path, const std::string &source, bool optimize, bool intern);
+        static bool store(const std::string &path, const std::string &source, const Program &program);
+    };
+}
@@ -0,0 +1,88 @@
+#include "ProgramCache.h"
+#include "AstCache.h"
+#include "../Engine.h"
+
+namespace lex
+{
+    ProgramPtr ProgramCache::get(const std::string &source, const EngineOptions &options, const std::string &path)
+    {
+        uint64_t hash = AstCache::hash(source);
+        std::promise<ProgramPtr> promise;
+        std::shared_future<ProgramPtr> existing;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::vector<Recency::iterator> &bucket = entries[hash];
+            for (Recency::iterator entry : bucket)
+            {
+                if (entry->optimize == options.optimize && entry->intern == options.intern && entry->source == source)
+                {
+                    existing = entry->program;
+                    recency.splice(recency.begin(), recency, entry);
+                    break;
+                }
+            }
+            if (existing.valid())
+                hit_count++;
+            else
+            {
+                miss_count++;
+                recency.push_front(Entry{hash, source, options.optimize, options.intern, promise.get_future().share()});
+                bucket.push_back(recency.begin());
+                if (recency.size() > capacity)
+                    evict_oldest();
+            }
+        }
+        if (existing.valid())
+            return existing.get();
+
+        // compiled outside the lock, threads asking for the same source meanwhile wait on the future
+        ProgramPtr program;
+        try
+        {
+            program = Program::compile(source, options, path);
+        }
+        catch (...)
+        {
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+        promise.set_value(program);
+        return program;
+    }
+
+    void ProgramCache::evict_oldest()
+    {
+        // a program still compiling can go too, its waiters hold the future
+        Recency::iterator oldest = std::prev(recency.end());
+        auto bucket = entries.find(oldest->hash);
+        std::erase(bucket->second, oldest);
+        if (bucket->second.empty())
+            entries.erase(bucket);
+        recency.erase(oldest);
+        eviction_count++;
+    }
+
+    size_t ProgramCache::hits() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return hit_count;
+    }
+
+    size_t ProgramCache::misses() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return miss_count;
+    }
+
+    size_t ProgramCache::evictions() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return eviction_count;
+    }
+
+    size_t ProgramCache::size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return recency.size();
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "../Program.h"
+#include <cstdint>
+#include <future>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace lex
+{
+    /*
+     * Compiled Programs shared by every thread of a process, keyed by source hash (the full text is compared too).
+     * The first thread asking for a source compiles it, threads asking for the same source meanwhile wait for
+     * that result instead of compiling it again. At most `capacity` programs are kept, the least recently used one
+     * goes first; whoever still holds its ProgramPtr can keep running it.
+     */
+    class ProgramCache
+    {
+    public:
+        static constexpr size_t DEFAULT_CAPACITY = 1024;
+
+        explicit ProgramCache(size_t capacity = DEFAULT_CAPACITY) : capacity(capacity == 0 ? 1 : capacity) {}
+
+        // the program for `source` as Program::compile would build it with `options`
+        ProgramPtr get(const std::string &source, const EngineOptions &options, const std::string &path = "");
+
+        size_t hits() const;
+        size_t misses() const;
+        size_t evictions() const;
+        size_t size() const;
+
+    private:
+        struct Entry
+        {
+            uint64_t hash;
+            std::string source;
+            bool optimize;
+            bool intern;
+            std::shared_future<ProgramPtr> program;
+        };
+        using Recency = std::list<Entry>; // most recently used first
+
+        const size_t capacity;
+        mutable std::mutex mutex;
+        Recency recency;
+        std::unordered_map<uint64_t, std::vector<Recency::iterator>> entries;
+        size_t hit_count = 0;
+        size_t miss_count = 0;
+        size_t eviction_count = 0;
+
+        void evict_oldest();
+    };
+}
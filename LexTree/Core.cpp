@@ -0,0 +1,16 @@
+#include "Core.h"
+#include "Lexer/Lexer.h"
+#include "Parser/parser.h"
+
+namespace lex
+{
+    std::vector<Token> tokenize(const std::string &source, Diagnostics &diagnostics)
+    {
+        return Lexer(source, diagnostics).scan_tokens();
+    }
+
+    std::vector<StmtPtr> parse(const std::string &source, Diagnostics &diagnostics)
+    {
+        return Parser(tokenize(source, diagnostics), diagnostics).parse();
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+/*
+ * Public header of lextree_core, the library the lextree command line tool and lextree_bench are built on. Link
+ * lextree_core and include this to run Lex in-process:
+ *
+ *     std::string source = "print 1 + 2;";
+ *     std::ostringstream out;
+ *     lex::Diagnostics errors(out);                     // or a subclass that collects them
+ *     lex::Engine engine({}, out, errors);
+ *     lex::ProgramCache cache;                          // one per process, shared by every engine
+ *     lex::ProgramPtr program = cache.get(source, engine.options);
+ *     if (engine.run(program) != lex::Engine::Status::OK) ...
+ *
+ * What this header includes is the stable surface: Engine and EngineOptions, Program and ProgramCache, Snapshot,
+ * Value and Memory, Diagnostics and RuntimeError, the AST (Expr.h, Stmt.h, Token.h) and the front end below. It does
+ * not pull in the Lexer, Parser, Interpreter, VM or instrumentation headers; those and the other headers under
+ * LexTree/ are internals that change with the implementation. LEXTREE_CORE_API_VERSION goes up when something here
+ * changes incompatibly.
+ */
+
+#define LEXTREE_CORE_API_VERSION 1
+
+#include "Engine.h"
+#include "Program.h"
+#include "Cache/ProgramCache.h"
+#include "Error_Handling/Diagnostics.h"
+#include "Lexer/Token.h"
+#include "Parser/Stmt.h"
+#include <string>
+#include <vector>
+
+namespace lex
+{
+    // the tokens of `source`, lexical errors go to `diagnostics`
+    std::vector<Token> tokenize(const std::string &source, Diagnostics &diagnostics);
+
+    // the statements of `source` as parsed, not optimized, errors go to `diagnostics`. Program::build makes it
+    // runnable.
+    std::vector<StmtPtr> parse(const std::string &source, Diagnostics &diagnostics);
+}
@@ -0,0 +1,366 @@
+#include "Engine.h"
+#include "Lexer/Lexer.h"
+#include "Parser/parser.h"
+#include "Parser/ASTPrinter.h"
+#include "Interpreter/Interpreter.h"
+#include "VM/VM.h"
+#include "VM/Compiler.h"
+#include "Transpiler/CppEmitter.h"
+#include "Instrumentation/Stats.h"
+
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <sstream>
+
+namespace lex
+{
+    namespace
+    {
+        std::mutex reports_mutex;
+        std::set<std::string> reports_started;
+
+        // engines of a batch all write to the same report files: the first write of the process replaces a file,
+        // the others append (profile stacks add up in flame graph tools, lcov merges records of the same file)
+        bool write_report(const std::string &path, const std::string &text)
+        {
+            std::lock_guard<std::mutex> lock(reports_mutex);
+            bool started = reports_started.count(path) != 0;
+            std::ofstream file(path, started ? std::ios::app : std::ios::trunc);
+            if (!(file << text))
+                return false;
+            reports_started.insert(path);
+            return true;
+        }
+    }
+
+    Engine::Engine(Options options, std::ostream &out, std::ostream &err)
+        : options(options), out(out), owned_sink(std::make_unique<Diagnostics>(err)), sink(*owned_sink),
+          interpreter(std::make_unique<Interpreter>(sink, out)), vm(std::make_unique<VM>(sink, out)),
+          chunk(std::make_unique<Chunk>()), stats(std::make_unique<Stats>())
+    {
+    }
+
+    Engine::Engine(Options options, std::ostream &out, Diagnostics &diagnostics)
+        : options(options), out(out), sink(diagnostics), interpreter(std::make_unique<Interpreter>(sink, out)),
+          vm(std::make_unique<VM>(sink, out)), chunk(std::make_unique<Chunk>()), stats(std::make_unique<Stats>())
+    {
+    }
+
+    Engine::~Engine() = default;
+
+    const Memory &Engine::memory() const
+    {
+        return options.use_vm ? vm->memory : interpreter->memory;
+    }
+
+    Engine::Status Engine::status() const
+    {
+        if (sink.had_error)
+            return Status::COMPILE_ERROR;
+        if (sink.had_runtime_error)
+            return Status::RUNTIME_ERROR;
+        return Status::OK;
+    }
+
+    Snapshot Engine::snapshot() const
+    {
+        return options.use_vm ? vm->snapshot() : interpreter->snapshot();
+    }
+
+    void Engine::interrupt()
+    {
+        interpreter->budget.interrupt();
+        vm->budget.interrupt();
+    }
+
+    void Engine::clear_interrupts()
+    {
+        interpreter->budget.clear_interrupt();
+        vm->budget.clear_interrupt();
+    }
+
+    void Engine::start(const ProgramPtr &program)
+    {
+        sink.reset();
+        running = false;
+        for (const auto &[line, message] : program->errors)
+            sink.error(line, message);
+        if (!program->errors.empty())
+            return;
+
+        vm->memory.set_limit(options.memory_limit);
+        vm->memory.reset_peak();
+        vm->budget.reset(options.step_limit, options.time_limit_ms);
+        vm->start(compile(program));
+        running = true;
+    }
+
+    bool Engine::resume(uint64_t steps)
+    {
+        if (!running)
+            return true;
+        try
+        {
+            if (!vm->resume(steps))
+                return false;
+        }
+        catch (const Interrupted &interrupted)
+        {
+            sink.interrupted(interrupted.what());
+        }
+        running = false;
+        clear_interrupts();
+        return true;
+    }
+
+    void Engine::pause()
+    {
+        vm->budget.end_slice();
+    }
+
+    const Chunk &Engine::compile(const ProgramPtr &program)
+    {
+        if (compiled_program != program)
+        {
+            Compiler compiler;
+            *chunk = compiler.compile(program->statements);
+            compiled_program = program;
+        }
+        return *chunk;
+    }
+
+    void Engine::fork(const Snapshot &snapshot)
+    {
+        interpreter->fork(snapshot);
+        vm->fork(snapshot);
+    }
+
+    Engine::Status Engine::run(const std::string &source)
+    {
+        set_source("script", source);
+        return run(Program::compile(source, options, "", collecting()));
+    }
+
+    Engine::Status Engine::run_file(const std::string &path)
+    {
+        sink.reset();
+        std::stringstream buffer;
+        {
+            PhaseTimer timer(collecting() ? &stats->read : nullptr);
+            LEX_TRACE_SPAN("read", "engine");
+            std::ifstream file(path);
+            if (!file.is_open())
+            {
+                sink.note("Could not open file: " + path);
+                *stats = Stats{};
+                return Status::IO_ERROR;
+            }
+            buffer << file.rdbuf();
+        }
+        set_source(path, buffer.str());
+        return run(Program::compile(buffer.str(), options, path, collecting()));
+    }
+
+    Engine::Status Engine::run(const ProgramPtr &program)
+    {
+        sink.reset();
+        interpreter->set_stats(collecting());
+        std::optional<Coverage> coverage;
+        if (covering() && !options.use_vm)
+        {
+            coverage.emplace(*program);
+            interpreter->set_coverage(&*coverage);
+        }
+        std::optional<Profiler> profiler;
+        if (!options.profile.empty() && !options.use_vm)
+        {
+            profiler.emplace(options.profile_every);
+            interpreter->set_profiler(&*profiler);
+            profiler->start();
+        }
+        {
+            PhaseTimer timer(collecting() ? &stats->execute : nullptr);
+            LEX_TRACE_SPAN("execute", "engine", "vm", options.use_vm);
+            execute(program);
+        }
+        if (profiler)
+        {
+            profiler->stop();
+            interpreter->set_profiler(nullptr);
+            report_profile(*profiler);
+        }
+        else if (!options.profile.empty())
+        {
+            sink.note("[profile] only the tree-walker can be profiled, run without --vm");
+        }
+        if (coverage)
+        {
+            interpreter->set_coverage(nullptr);
+            report_coverage(*coverage);
+        }
+        else if (covering())
+        {
+            sink.note("[coverage] only the tree-walker counts coverage, run without --vm");
+        }
+        source_name.clear();
+        source_text.clear();
+        report_stats();
+        return status();
+    }
+
+    void Engine::set_source(const std::string &name, const std::string &source)
+    {
+        if (!reporting())
+            return;
+        source_name = name;
+        source_text = source;
+    }
+
+    void Engine::report_profile(const Profiler &profiler)
+    {
+        std::string root = source_name.empty() ? "program" : source_name;
+        std::string note = "[profile] " + std::to_string(profiler.samples()) + " samples (" + profiler.describe() + ")";
+        if (write_report(options.profile, profiler.folded(root)))
+            note += ", folded stacks in " + options.profile;
+        else
+            note += ", could not write " + options.profile;
+        sink.note(note);
+        if (profiler.samples() == 0)
+            return;
+        for (const std::string &line : profiler.hot_lines(source_text))
+            sink.note(line);
+    }
+
+    void Engine::report_coverage(const Coverage &coverage)
+    {
+        std::string name = source_name.empty() ? "program" : source_name;
+        std::string note = coverage.summary();
+        if (!options.coverage.empty())
+            note += write_report(options.coverage, coverage.lcov(name)) ? ", lcov in " + options.coverage
+                                                                        : ", could not write " + options.coverage;
+        if (!options.annotate.empty())
+        {
+            std::string listing = "==> " + name + " <==\n" + coverage.annotate(source_text);
+            note += write_report(options.annotate, listing) ? ", listing in " + options.annotate
+                                                            : ", could not write " + options.annotate;
+        }
+        sink.note(note);
+    }
+
+    void Engine::report_stats()
+    {
+        if (!options.stats)
+            return;
+        for (const std::string &line : stats->report())
+            sink.note(line);
+        *stats = Stats{};
+    }
+
+    std::vector<StmtPtr> Engine::parse(const std::string &source)
+    {
+        Lexer lexer = Lexer(source, sink);
+        std::vector<Token> tokens = lexer.scan_tokens();
+        Parser parser = Parser(tokens, sink);
+        return parser.parse();
+    }
+
+    void Engine::execute(std::vector<StmtPtr> statements)
+    {
+        execute(Program::build(std::move(statements), options));
+    }
+
+    void Engine::execute(const ProgramPtr &program)
+    {
+        for (const auto &[line, message] : program->errors)
+            sink.error(line, message);
+        if (!program->errors.empty())
+            return;
+
+        const std::vector<StmtPtr> &statements = program->statements;
+        // the counted loop path skips the condition, coverage has to see every evaluation
+        interpreter->set_loop_specialization(program->optimized && !covering());
+        interpreter->memory.set_limit(options.memory_limit);
+        vm->memory.set_limit(options.memory_limit);
+        interpreter->memory.reset_peak();
+        vm->memory.reset_peak();
+        if (program->interned && options.intern_stats)
+            sink.note("[intern] expression nodes: " + std::to_string(program->intern_stats.nodes_before) + " -> " +
+                      std::to_string(program->intern_stats.nodes_after) +
+                      ", common subexpressions: " + std::to_string(program->intern_stats.common_subexpressions));
+
+        if (options.dump_optimized_ast)
+        {
+            ASTPrinter printer;
+            out << printer.print(statements);
+            return;
+        }
+
+        if (options.emit_cpp)
+        {
+            CppEmitter emitter;
+            out << emitter.emit(statements);
+            return;
+        }
+
+        if (options.use_vm)
+        {
+            compile(program);
+            if (options.vm_dump)
+                out << disassemble(*chunk);
+
+            uint64_t before = vm->instruction_count();
+            auto start = std::chrono::steady_clock::now();
+            vm->budget.reset(options.step_limit, options.time_limit_ms);
+            try
+            {
+                vm->run(*chunk);
+            }
+            catch (const Interrupted &interrupted)
+            {
+                sink.interrupted(interrupted.what());
+            }
+            clear_interrupts();
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            if (options.stats)
+                stats->vm_instructions = vm->instruction_count() - before;
+
+            if (options.vm_stats)
+            {
+                std::ostringstream stats;
+                stats << "[vm] instructions: " << vm->instruction_count() - before
+                      << ", code size: " << chunk->code.size()
+                      << ", registers: " << chunk->register_count
+                      << ", time: " << elapsed.count() << " ms";
+                sink.note(stats.str());
+            }
+            report_memory();
+            return;
+        }
+
+        interpreter->budget.reset(options.step_limit, options.time_limit_ms);
+        try
+        {
+            interpreter->interpret(program);
+        }
+        catch (const Interrupted &interrupted)
+        {
+            sink.interrupted(interrupted.what());
+        }
+        clear_interrupts();
+        report_memory();
+    }
+
+    void Engine::report_memory()
+    {
+        if (!options.memory_stats)
+            return;
+        const Memory &account = memory();
+        std::string note = "[memory] current: " + std::to_string(account.current()) +
+                           " bytes, peak: " + std::to_string(account.peak()) + " bytes";
+        if (account.limit() != 0)
+            note += ", limit: " + std::to_string(account.limit()) + " bytes";
+        sink.note(note);
+    }
+}
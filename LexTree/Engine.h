@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Error_Handling/Diagnostics.h"
+#include "Interpreter/Memory.h"
+#include "Interpreter/Value.h"
+#include "Program.h"
+
+namespace lex
+{
+    // the backends and instrumentation stay behind pointers, so including Engine.h does not pull them in
+    class Interpreter;
+    class VM;
+    struct Chunk;
+    struct Stats;
+    class Profiler;
+    class Coverage;
+
+    // switches of an Engine, the command line sets them through LexTree::options
+    struct EngineOptions
+    {
+        bool use_vm = false;   // execute on the register VM instead of the tree-walker
+        bool vm_stats = false; // report instruction count and wall time of the VM
+        bool vm_dump = false;  // print the compiled VM code before running it
+        bool emit_cpp = false; // translate the script to C++ on stdout instead of running it
+        bool optimize = true;  // run the Optimizer over the parsed program
+        bool dump_optimized_ast = false; // print the AST after optimization instead of running it
+        bool intern = false;       // share identical expressions and reuse common subexpressions (Interner)
+        bool intern_stats = false; // report what the Interner did
+        bool cache = false;        // load/store the compiled program in a .lexc file (AstCache)
+        size_t memory_limit = 0;   // bytes a run may hold in variables and the strings it builds (Memory), 0: no limit
+        bool memory_stats = false; // report current and peak memory after each run
+        bool stats = false;        // report time, allocations and counters of every phase of a run (Stats)
+        uint64_t step_limit = 0;    // loop iterations a run may take (see Budget), 0: no limit
+        uint64_t time_limit_ms = 0; // wall clock a run may take, checked at loop iterations, 0: no limit
+        std::string profile;        // sample the tree-walker (Profiler), write folded stacks to this file
+        uint64_t profile_every = 0; // sample every N statements instead of on the CPU-time timer
+        std::string coverage;       // count every node and branch the tree-walker runs (Coverage), lcov file
+        std::string annotate;       // the same counts as an annotated source listing
+    };
+
+    /*
+     * One independent Lex runtime: its own global environment, interpreter/VM state, diagnostics sink and output
+     * stream. Nothing is shared between engines, so separate engines can run on separate threads.
+     * Globals persist across run() calls on the same engine (that is how the REPL works).
+     *
+     *     std::ostringstream out;
+     *     lex::Engine engine({}, out);
+     *     if (engine.run("print 1 + 2;") == lex::Engine::Status::OK) ...
+     */
+    class Engine
+    {
+    public:
+        using Options = EngineOptions;
+
+        // values are the exit codes of the command line tool
+        enum class Status
+        {
+            OK = 0,
+            COMPILE_ERROR = 65,
+            RUNTIME_ERROR = 70,
+            IO_ERROR = 74,
+        };
+
+        // program output goes to `out`, errors and statistics to `err`
+        explicit Engine(Options options = {}, std::ostream &out = std::cout, std::ostream &err = std::cerr);
+        // errors go to a caller provided sink, which must outlive the engine
+        Engine(Options options, std::ostream &out, Diagnostics &diagnostics);
+
+        ~Engine();
+
+        Engine(const Engine &) = delete;
+        Engine &operator=(const Engine &) = delete;
+
+        Options options;
+
+        Status run(const std::string &source);
+        Status run_file(const std::string &path); // honours options.cache
+        // run a compiled program, which may be shared with other engines (see ProgramCache)
+        Status run(const ProgramPtr &program);
+        // where the program the next run() runs came from, for profile and coverage reports (run(source) and
+        // run_file() know)
+        void set_source(const std::string &name, const std::string &source);
+
+        // front end only, errors are reported to the diagnostics sink
+        std::vector<StmtPtr> parse(const std::string &source);
+
+        // optimize and run a parsed program on the selected backend
+        void execute(std::vector<StmtPtr> statements);
+
+        Diagnostics &diagnostics() { return sink; }
+
+        // memory account of the backend options.use_vm selects: variables held now, peak of the last run
+        const Memory &memory() const;
+
+        // time slicing, e.g. a scheduler interleaving many engines on one thread: start() a program, then call
+        // resume() until it returns true, each call runs at most `steps` loop iterations. Always runs on the VM,
+        // the tree-walker cannot suspend. status() is the outcome once resume() returned true.
+        void start(const ProgramPtr &program);
+        bool resume(uint64_t steps);
+        // ends the current slice at the next loop iteration, e.g. from the output stream when its buffer is full
+        void pause();
+
+        // stop the current run within a few loop iterations (it ends with a runtime error), callable from any
+        // thread. Between runs it applies to the next one.
+        void interrupt();
+
+        // the global variables after what ran so far (e.g. a prelude), shareable between engines and threads
+        Snapshot snapshot() const;
+        // start over from a snapshot: globals are shared with it and copied only when a run writes them
+        void fork(const Snapshot &snapshot);
+
+        // outcome of everything reported to the sink since the last run
+        Status status() const;
+
+    private:
+        std::ostream &out;
+        std::unique_ptr<Diagnostics> owned_sink;
+        Diagnostics &sink;
+        std::unique_ptr<Interpreter> interpreter;
+        std::unique_ptr<VM> vm;
+        // VM code of the last program run on this engine, reused when the same program runs again
+        ProgramPtr compiled_program;
+        std::unique_ptr<Chunk> chunk;
+
+        bool running = false;         // between start() and the resume() that finished
+        std::unique_ptr<Stats> stats; // of the run in progress, with options.stats
+        // name and text of the script being run, for profile and coverage reports (only kept with one of them on)
+        std::string source_name;
+        std::string source_text;
+
+        void execute(const ProgramPtr &program);
+        const Chunk &compile(const ProgramPtr &program);
+        void clear_interrupts();
+        void report_memory();
+        Stats *collecting() { return options.stats ? stats.get() : nullptr; }
+        void report_stats();
+        bool reporting() const { return !options.profile.empty() || covering(); }
+        bool covering() const { return !options.coverage.empty() || !options.annotate.empty(); }
+        void report_profile(const Profiler &profiler);
+        void report_coverage(const Coverage &coverage);
+    };
+}
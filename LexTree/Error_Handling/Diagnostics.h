@@ -0,0 +1,70 @@
+#pragma once
+
+#include "RunTimeError.h"
+#include <iostream>
+#include <string>
+
+namespace lex
+{
+    /*
+     * Where the Lexer, Parser and both backends report problems. The default writes the usual
+     * "[line N] Error: ..." / "<message>\n[line N]" text to a stream, override the report_* methods
+     * to collect them somewhere else. One sink per Engine, it is not shared between threads.
+     */
+    class Diagnostics
+    {
+    public:
+        explicit Diagnostics(std::ostream &out = std::cerr) : out(out) {}
+        virtual ~Diagnostics() = default;
+
+        bool had_error = false;         // syntax error, the program was not run
+        bool had_runtime_error = false;
+
+        // syntax errors from the Lexer and Parser
+        void error(int line, const std::string &message)
+        {
+            had_error = true;
+            report_error(line, message);
+        }
+
+        void runtime_error(const RuntimeError &error)
+        {
+            had_runtime_error = true;
+            report_runtime_error(error);
+        }
+
+        // the run was stopped from outside (Engine::interrupt), counts as a runtime error but has no line
+        void interrupted(const std::string &message)
+        {
+            had_runtime_error = true;
+            report_note(message);
+        }
+
+        // informational output (statistics, I/O problems)
+        void note(const std::string &message) { report_note(message); }
+
+        void reset()
+        {
+            had_error = false;
+            had_runtime_error = false;
+        }
+
+    protected:
+        std::ostream &out;
+
+        virtual void report_error(int line, const std::string &message)
+        {
+            out << "[line " << line << "] Error: " << message << std::endl;
+        }
+
+        virtual void report_runtime_error(const RuntimeError &error)
+        {
+            out << error.what() << "\n[line " << error.token.line << "]" << std::endl;
+        }
+
+        virtual void report_note(const std::string &message)
+        {
+            out << message << std::endl;
+        }
+    };
+}
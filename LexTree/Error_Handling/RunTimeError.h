@@ -16,4 +16,11 @@ namespace lex
         RuntimeError(const Token &token, const std::string &message)
             : std::runtime_error(message), token(token) {}
     };
+
+    // thrown at a safe point (loop back-edge) after Engine::interrupt, ends the whole run instead of one statement
+    class Interrupted : public std::runtime_error
+    {
+    public:
+        explicit Interrupted(const std::string &message) : std::runtime_error(message) {}
+    };
 }
\ No newline at end of file
@@ -0,0 +1,31 @@
+#include "Allocations.h"
+#include <cstdlib>
+#include <new>
+
+// Replaces the global operator new and delete to count allocations and frees per thread. Two thread-local increments
+// on top of malloc and one on top of free, cheap enough to stay on all the time so --stats needs no special build.
+// Not part of lextree_core: a program embedding the library keeps its own allocator unless it links
+// lextree_allocations too, allocations() then stays zero.
+
+void *operator new(std::size_t size)
+{
+    lex::detail::counted.count++;
+    lex::detail::counted.bytes += size;
+    if (void *memory = std::malloc(size != 0 ? size : 1))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept
+{
+    if (memory)
+        lex::detail::counted.frees++;
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept
+{
+    if (memory)
+        lex::detail::counted.frees++;
+    std::free(memory);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+namespace lex
+{
+    // heap allocations made by a thread (every operator new, see Allocations.cpp) and the ones it freed
+    struct AllocationCount
+    {
+        uint64_t count = 0;
+        uint64_t bytes = 0;
+        uint64_t frees = 0; // operator delete of anything, also of memory another thread allocated
+
+        AllocationCount operator-(const AllocationCount &earlier) const
+        {
+            return {count - earlier.count, bytes - earlier.bytes, frees - earlier.frees};
+        }
+
+        // allocations still held, of the ones counted (negative when more was freed than allocated)
+        int64_t retained() const { return static_cast<int64_t>(count - frees); }
+    };
+
+    namespace detail
+    {
+        // bumped by the operator new and delete of Allocations.cpp, stays zero in a program that does not link it
+        inline thread_local AllocationCount counted;
+    }
+
+    // the calling thread's allocations so far
+    inline AllocationCount allocations()
+    {
+        return detail::counted;
+    }
+}
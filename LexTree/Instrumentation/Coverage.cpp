@@ -0,0 +1,220 @@
+#include "Coverage.h"
+#include "Lines.h"
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <sstream>
+
+namespace lex
+{
+    namespace
+    {
+        std::string percent(size_t part, size_t whole)
+        {
+            char text[32];
+            std::snprintf(text, sizeof(text), "%zu/%zu (%.1f%%)", part, whole, whole ? 100.0 * part / whole : 100.0);
+            return text;
+        }
+    }
+
+    Coverage::Coverage(const Program &program)
+        : optimized(program.optimized), described(program.nodes), hits(program.nodes), lines(program.nodes),
+          is_statement(program.nodes), branch_of(program.nodes, NONE)
+    {
+        for (const auto &statement : program.statements)
+            describe(statement.get());
+    }
+
+    void Coverage::describe(uint32_t id, int line, bool statement, const char *branch_kind)
+    {
+        described[id] = true;
+        lines[id] = line;
+        is_statement[id] = statement;
+        if (branch_kind)
+        {
+            branch_of[id] = static_cast<uint32_t>(taken.size());
+            taken.push_back({0, 0});
+            branch_nodes.push_back(id);
+            branch_kinds.push_back(branch_kind);
+        }
+    }
+
+    void Coverage::describe(const Stmt *stmt)
+    {
+        if (stmt == nullptr || stmt->id >= described.size() || described[stmt->id])
+            return;
+        const auto *if_stmt = dynamic_cast<const IfStmt *>(stmt);
+        describe(stmt->id, line_of(stmt), true, if_stmt ? "if" : nullptr);
+
+        if (auto expression = dynamic_cast<const ExpressionStmt *>(stmt))
+            describe(expression->expression.get());
+        else if (auto print = dynamic_cast<const PrintStmt *>(stmt))
+            describe(print->expression.get());
+        else if (auto variable = dynamic_cast<const VariableStmt *>(stmt))
+            describe(variable->initializer.get());
+        else if (auto block = dynamic_cast<const BlockStmt *>(stmt))
+        {
+            for (const auto &statement : block->statements)
+                describe(statement.get());
+        }
+        else if (if_stmt)
+        {
+            describe(if_stmt->condition.get());
+            describe(if_stmt->then_branch.get());
+            describe(if_stmt->else_branch.get());
+        }
+        else if (auto while_stmt = dynamic_cast<const WhileStmt *>(stmt))
+        {
+            describe(while_stmt->condition.get());
+            describe(while_stmt->body.get());
+        }
+        else if (auto for_stmt = dynamic_cast<const ForStmt *>(stmt))
+        {
+            describe(for_stmt->initializer.get());
+            describe(for_stmt->condition.get());
+            describe(for_stmt->increment.get());
+            describe(for_stmt->body.get());
+        }
+    }
+
+    void Coverage::describe(const Expr *expr)
+    {
+        if (expr == nullptr || expr->id >= described.size() || described[expr->id])
+            return;
+        const char *kind = nullptr;
+        if (dynamic_cast<const Ternary *>(expr))
+            kind = "ternary";
+        else if (auto logical = dynamic_cast<const Logical *>(expr))
+            kind = logical->operator_token.type == TokenType::OR ? "or" : "and";
+        describe(expr->id, line_of(expr), false, kind);
+
+        if (auto binary = dynamic_cast<const Binary *>(expr))
+        {
+            describe(binary->left.get());
+            describe(binary->right.get());
+        }
+        else if (auto logical = dynamic_cast<const Logical *>(expr))
+        {
+            describe(logical->left.get());
+            describe(logical->right.get());
+        }
+        else if (auto unary = dynamic_cast<const Unary *>(expr))
+            describe(unary->right.get());
+        else if (auto ternary = dynamic_cast<const Ternary *>(expr))
+        {
+            describe(ternary->condition.get());
+            describe(ternary->then_branch.get());
+            describe(ternary->else_branch.get());
+        }
+        else if (auto grouping = dynamic_cast<const Grouping *>(expr))
+            describe(grouping->expression.get());
+        else if (auto assign = dynamic_cast<const Assign *>(expr))
+            describe(assign->value.get());
+    }
+
+    std::vector<std::pair<int, uint64_t>> Coverage::line_counts() const
+    {
+        // several statements on a line (a loop and its body): the line ran as often as the busiest of them
+        std::map<int, uint64_t> per_line;
+        for (size_t id = 0; id < hits.size(); id++)
+        {
+            if (!is_statement[id] || lines[id] == 0)
+                continue;
+            uint64_t &count = per_line[lines[id]];
+            count = std::max(count, hits[id]);
+        }
+        return {per_line.begin(), per_line.end()};
+    }
+
+    std::string Coverage::lcov(const std::string &source_file) const
+    {
+        std::ostringstream out;
+        out << "TN:\nSF:" << source_file << "\n";
+
+        size_t found = 0, hit = 0;
+        for (size_t branch = 0; branch < taken.size(); branch++)
+        {
+            uint32_t node = branch_nodes[branch];
+            for (size_t way = 0; way < 2; way++)
+            {
+                // "-": the branch itself never ran, so neither way could be taken
+                out << "BRDA:" << lines[node] << "," << branch << "," << way << ",";
+                if (hits[node] == 0)
+                    out << "-";
+                else
+                    out << taken[branch][way];
+                out << "\n";
+                found++;
+                hit += taken[branch][way] != 0;
+            }
+        }
+        out << "BRF:" << found << "\nBRH:" << hit << "\n";
+
+        std::vector<std::pair<int, uint64_t>> counts = line_counts();
+        size_t covered = 0;
+        for (const auto &[line, count] : counts)
+        {
+            out << "DA:" << line << "," << count << "\n";
+            covered += count != 0;
+        }
+        out << "LF:" << counts.size() << "\nLH:" << covered << "\nend_of_record\n";
+        return out.str();
+    }
+
+    std::string Coverage::annotate(const std::string &source) const
+    {
+        std::map<int, uint64_t> per_line;
+        for (const auto &[line, count] : line_counts())
+            per_line[line] = count;
+
+        std::multimap<int, std::string> notes;
+        for (size_t branch = 0; branch < taken.size(); branch++)
+        {
+            uint32_t node = branch_nodes[branch];
+            std::string kind = branch_kinds[branch];
+            bool logical = kind == "and" || kind == "or";
+            std::string note = "branch " + kind + ": " + (logical ? "short-circuit " : "then ") +
+                               std::to_string(taken[branch][0]) + (logical ? ", right side " : ", else ") +
+                               std::to_string(taken[branch][1]);
+            notes.emplace(lines[node], note);
+        }
+
+        std::ostringstream out;
+        if (optimized)
+            out << "        -:    0: optimized: folded constants and removed code are not counted, "
+                   "--no-optimize counts them\n";
+        std::istringstream in(source);
+        int number = 0;
+        for (std::string text; std::getline(in, text);)
+        {
+            number++;
+            char prefix[40];
+            auto count = per_line.find(number);
+            if (count == per_line.end())
+                std::snprintf(prefix, sizeof(prefix), "%9s:%5d: ", "-", number);
+            else if (count->second == 0)
+                std::snprintf(prefix, sizeof(prefix), "%9s:%5d: ", "#####", number);
+            else
+                std::snprintf(prefix, sizeof(prefix), "%9llu:%5d: ", static_cast<unsigned long long>(count->second),
+                              number);
+            out << prefix << text << "\n";
+
+            auto [first, last] = notes.equal_range(number);
+            for (auto note = first; note != last; ++note)
+                out << std::string(17, ' ') << note->second << "\n";
+        }
+        return out.str();
+    }
+
+    std::string Coverage::summary() const
+    {
+        std::vector<std::pair<int, uint64_t>> counts = line_counts();
+        size_t covered = std::count_if(counts.begin(), counts.end(), [](const auto &line) { return line.second != 0; });
+        size_t ways = 0;
+        for (const auto &branch : taken)
+            ways += (branch[0] != 0) + (branch[1] != 0);
+        return "[coverage] lines: " + percent(covered, counts.size()) + ", branches: " +
+               percent(ways, 2 * taken.size()) + ", nodes: " + std::to_string(hits.size()) +
+               (optimized ? " (optimized: folded code is not counted)" : "");
+    }
+}
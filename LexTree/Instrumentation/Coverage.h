@@ -0,0 +1,85 @@
+#pragma once
+
+#include "../Parser/Expr.h"
+#include "../Parser/Stmt.h"
+#include "../Program.h"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lex
+{
+    /*
+     * Exact execution counts of the tree-walker (`--coverage`, `--annotate`): how often every statement and
+     * expression ran and which way every if, ?: and and/or went. The counters are arrays indexed by the node ids
+     * the Program gave out, so counting is an index and an increment. A node the Interner shares between several
+     * places has one counter for all of them. Counts are of the program as it runs: code the Optimizer folded or
+     * removed is not counted, the reports say so.
+     */
+    class Coverage
+    {
+    public:
+        explicit Coverage(const Program &program);
+
+        // `Node`: Stmt or Expr; nodes that are not part of the program (NO_NODE_ID) are not counted
+        template <typename Node>
+        void hit(const Node *node)
+        {
+            if (node->id < hits.size())
+                hits[node->id]++;
+        }
+
+        // `first`: then branch of an if or ?:, short-circuit of an and/or
+        template <typename Node>
+        void branch(const Node *node, bool first)
+        {
+            if (node->id < hits.size() && branch_of[node->id] != NONE)
+                taken[branch_of[node->id]][first ? 0 : 1]++;
+        }
+
+        size_t nodes() const { return hits.size(); }
+        // times a node ran, 0 for one that is not part of the program
+        template <typename Node>
+        uint64_t count(const Node *node) const
+        {
+            return node->id < hits.size() ? hits[node->id] : 0;
+        }
+        // times each way of a branch was taken, see branch()
+        template <typename Node>
+        std::array<uint64_t, 2> branches(const Node *node) const
+        {
+            if (node->id >= hits.size() || branch_of[node->id] == NONE)
+                return {0, 0};
+            return taken[branch_of[node->id]];
+        }
+
+        // lcov tracefile record of the script (`source_file` goes into SF:), for genhtml and coverage tools
+        std::string lcov(const std::string &source_file) const;
+        // the source with the count of every line in front of it, gcov style, and the branches under their line
+        std::string annotate(const std::string &source) const;
+        // "[coverage] lines: 12/14 (85.7%), branches: 3/6 (50.0%), nodes: 40", and when optimized a note that
+        // folded code is not counted
+        std::string summary() const;
+
+    private:
+        static constexpr uint32_t NONE = UINT32_MAX;
+
+        bool optimized;
+        std::vector<bool> described;        // by node id
+        std::vector<uint64_t> hits;         // by node id
+        std::vector<int> lines;             // by node id, 0 when no token tells
+        std::vector<bool> is_statement;     // by node id, lines are counted from statements
+        std::vector<uint32_t> branch_of;    // by node id, NONE for nodes that do not branch
+        std::vector<std::array<uint64_t, 2>> taken; // by branch
+        std::vector<uint32_t> branch_nodes; // by branch
+        std::vector<const char *> branch_kinds;
+
+        void describe(uint32_t id, int line, bool statement, const char *branch_kind);
+        void describe(const Stmt *stmt);
+        void describe(const Expr *expr);
+
+        // executions of every line that has a statement, in line order
+        std::vector<std::pair<int, uint64_t>> line_counts() const;
+    };
+}
@@ -0,0 +1,62 @@
+#include "Lines.h"
+
+namespace lex
+{
+    int line_of(const Expr *expr)
+    {
+        if (expr == nullptr)
+            return 0;
+        if (auto binary = dynamic_cast<const Binary *>(expr))
+        {
+            int left = line_of(binary->left.get());
+            return left != 0 ? left : binary->operator_token.line;
+        }
+        if (auto logical = dynamic_cast<const Logical *>(expr))
+        {
+            int left = line_of(logical->left.get());
+            return left != 0 ? left : logical->operator_token.line;
+        }
+        if (auto unary = dynamic_cast<const Unary *>(expr))
+            return unary->operator_token.line;
+        if (auto variable = dynamic_cast<const Variable *>(expr))
+            return variable->name.line;
+        if (auto assign = dynamic_cast<const Assign *>(expr))
+            return assign->name.line;
+        if (auto ternary = dynamic_cast<const Ternary *>(expr))
+        {
+            for (const Expr *part : {ternary->condition.get(), ternary->then_branch.get(), ternary->else_branch.get()})
+            {
+                if (int line = line_of(part))
+                    return line;
+            }
+            return 0;
+        }
+        if (auto grouping = dynamic_cast<const Grouping *>(expr))
+            return line_of(grouping->expression.get());
+        if (auto literal = dynamic_cast<const Literal *>(expr))
+            return literal->line;
+        return 0;
+    }
+
+    int line_of(const Stmt *stmt)
+    {
+        if (auto expression = dynamic_cast<const ExpressionStmt *>(stmt))
+            return line_of(expression->expression.get());
+        if (auto print = dynamic_cast<const PrintStmt *>(stmt))
+            return line_of(print->expression.get());
+        if (auto variable = dynamic_cast<const VariableStmt *>(stmt))
+            return variable->name.line;
+        if (auto block = dynamic_cast<const BlockStmt *>(stmt))
+            return block->statements.empty() ? 0 : line_of(block->statements.front().get());
+        if (auto if_stmt = dynamic_cast<const IfStmt *>(stmt))
+            return line_of(if_stmt->condition.get());
+        if (auto while_stmt = dynamic_cast<const WhileStmt *>(stmt))
+            return line_of(while_stmt->condition.get());
+        if (auto for_stmt = dynamic_cast<const ForStmt *>(stmt))
+        {
+            int line = for_stmt->initializer ? line_of(for_stmt->initializer.get()) : 0;
+            return line != 0 ? line : line_of(for_stmt->condition.get());
+        }
+        return 0;
+    }
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "../Parser/Expr.h"
+#include "../Parser/Stmt.h"
+
+namespace lex
+{
+    // line of the first token in a node's subtree, 0 when none is known (nodes the optimizer or the cache made up).
+    // Only literals keep a line of their own, the others walk down to the tokens they carry.
+    int line_of(const Expr *expr);
+    int line_of(const Stmt *stmt);
+}
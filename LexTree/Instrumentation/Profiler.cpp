@@ -0,0 +1,214 @@
+#include "Profiler.h"
+#include "Lines.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <sstream>
+
+#if defined(__linux__)
+#include <csignal>
+#include <ctime>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define LEXTREE_HAS_PROFILING_TIMER 1
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+#endif
+
+namespace lex
+{
+#ifdef LEXTREE_HAS_PROFILING_TIMER
+    // a CPU-time timer of the thread running the profiler, which sends SIGPROF to that thread only
+    struct Profiler::Timer
+    {
+        timer_t id;
+    };
+
+    namespace
+    {
+        // the handler is installed once for all profilers, each timer carries the tick counter it bumps
+        std::mutex timer_mutex;
+        int timer_users = 0;
+        struct sigaction previous_handler;
+
+        void on_tick(int, siginfo_t *info, void *)
+        {
+            if (info->si_code == SI_TIMER)
+                static_cast<std::atomic<uint64_t> *>(info->si_value.sival_ptr)->fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+#else
+    struct Profiler::Timer
+    {
+    };
+#endif
+
+    Profiler::Profiler(uint64_t every, uint64_t interval_us)
+        : every(every), interval_us(interval_us == 0 ? DEFAULT_INTERVAL_US : interval_us), countdown(every)
+    {
+    }
+
+    Profiler::~Profiler()
+    {
+        stop();
+    }
+
+    void Profiler::start()
+    {
+        if (running || every != 0)
+            return;
+        running = true;
+        seen_ticks = ticks.load(std::memory_order_relaxed);
+#ifdef LEXTREE_HAS_PROFILING_TIMER
+        {
+            std::lock_guard<std::mutex> lock(timer_mutex);
+            if (timer_users++ == 0)
+            {
+                struct sigaction handler = {};
+                handler.sa_sigaction = on_tick;
+                handler.sa_flags = SA_RESTART | SA_SIGINFO;
+                sigemptyset(&handler.sa_mask);
+                sigaction(SIGPROF, &handler, &previous_handler);
+            }
+        }
+
+        // each engine of a batch runs on its own thread and counts only the CPU time of that thread
+        sigevent event = {};
+        event.sigev_notify = SIGEV_THREAD_ID;
+        event.sigev_signo = SIGPROF;
+        event.sigev_value.sival_ptr = &ticks;
+        event.sigev_notify_thread_id = static_cast<pid_t>(syscall(SYS_gettid));
+        timer_t id;
+        if (timer_create(CLOCK_THREAD_CPUTIME_ID, &event, &id) != 0)
+            return;
+        timer = std::make_unique<Timer>(Timer{id});
+
+        itimerspec interval = {};
+        interval.it_interval.tv_sec = static_cast<time_t>(interval_us / 1000000);
+        interval.it_interval.tv_nsec = static_cast<long>(interval_us % 1000000) * 1000;
+        interval.it_value = interval.it_interval;
+        timer_settime(timer->id, 0, &interval, nullptr);
+#endif
+    }
+
+    void Profiler::stop()
+    {
+        if (!running)
+            return;
+        running = false;
+#ifdef LEXTREE_HAS_PROFILING_TIMER
+        // on the thread the timer signals, so a tick still pending is handled before `ticks` goes away
+        if (timer)
+            timer_delete(timer->id);
+        timer.reset();
+
+        std::lock_guard<std::mutex> lock(timer_mutex);
+        if (--timer_users == 0)
+            sigaction(SIGPROF, &previous_handler, nullptr);
+#endif
+    }
+
+    bool Profiler::timer_fired()
+    {
+        uint64_t now = ticks.load(std::memory_order_relaxed);
+        if (now == seen_ticks || !running)
+            return false;
+        // a statement that ran through several ticks (a long concatenation) gets all of them
+        weight = now - seen_ticks;
+        seen_ticks = now;
+        return true;
+    }
+
+    void Profiler::sample()
+    {
+        countdown = every;
+        frames.clear();
+        for (const Stmt *stmt : stack)
+            frames.push_back(frame_of(stmt));
+        stacks[frames] += weight;
+        total += weight;
+        weight = 1;
+    }
+
+    Profiler::Frame Profiler::frame_of(const Stmt *stmt)
+    {
+        const char *kind = "statement";
+        if (dynamic_cast<const ExpressionStmt *>(stmt))
+            kind = "expression";
+        else if (dynamic_cast<const PrintStmt *>(stmt))
+            kind = "print";
+        else if (dynamic_cast<const VariableStmt *>(stmt))
+            kind = "var";
+        else if (dynamic_cast<const BlockStmt *>(stmt))
+            kind = "block";
+        else if (dynamic_cast<const IfStmt *>(stmt))
+            kind = "if";
+        else if (dynamic_cast<const WhileStmt *>(stmt))
+            kind = "while";
+        else if (dynamic_cast<const ForStmt *>(stmt))
+            kind = "for";
+        return Frame{kind, line_of(stmt)};
+    }
+
+    std::string Profiler::folded(const std::string &root) const
+    {
+        std::ostringstream out;
+        for (const auto &[path, count] : stacks)
+        {
+            out << root;
+            for (const Frame &frame : path)
+            {
+                out << ';' << frame.kind;
+                if (frame.line != 0)
+                    out << ':' << frame.line;
+            }
+            out << ' ' << count << '\n';
+        }
+        return out.str();
+    }
+
+    std::vector<std::string> Profiler::hot_lines(const std::string &source, size_t limit) const
+    {
+        std::map<int, uint64_t> per_line;
+        for (const auto &[path, count] : stacks)
+        {
+            if (!path.empty())
+                per_line[path.back().line] += count;
+        }
+
+        std::vector<std::pair<int, uint64_t>> hottest(per_line.begin(), per_line.end());
+        std::stable_sort(hottest.begin(), hottest.end(),
+                         [](const auto &a, const auto &b) { return a.second > b.second; });
+        if (hottest.size() > limit)
+            hottest.resize(limit);
+
+        std::vector<std::string> text_of{""}; // 1-based
+        std::istringstream in(source);
+        for (std::string text; std::getline(in, text);)
+            text_of.push_back(text.substr(std::min(text.find_first_not_of(" \t"), text.size())));
+
+        std::vector<std::string> table{"  line  samples       %  source"};
+        for (const auto &[line, count] : hottest)
+        {
+            char row[64];
+            std::snprintf(row, sizeof(row), "%6d %8llu  %5.1f%%  ", line, static_cast<unsigned long long>(count),
+                          total ? 100.0 * count / total : 0.0);
+            std::string text = line > 0 && static_cast<size_t>(line) < text_of.size() ? text_of[line] : "";
+            table.push_back(row + text);
+        }
+        return table;
+    }
+
+    std::string Profiler::describe() const
+    {
+        if (every != 0)
+            return "every " + std::to_string(every) + " statements";
+#ifdef LEXTREE_HAS_PROFILING_TIMER
+        return "every " + std::to_string(interval_us) + " us of CPU time";
+#else
+        return "no timer on this platform, use --profile-every";
+#endif
+    }
+}
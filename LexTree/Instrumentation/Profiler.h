@@ -0,0 +1,89 @@
+#pragma once
+
+#include "../Parser/Stmt.h"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lex
+{
+    /*
+     * Sampling profiler of the tree-walker. The Interpreter keeps the statements being executed on a stack
+     * (enter/leave, only while a profiler is attached) and every so often the stack is recorded as a sample:
+     * on a CPU-time timer of the thread running it (SIGPROF, `every` == 0, Linux only) or every `every`
+     * statements. Samples are attributed to source lines through the tokens the nodes carry, resolved when the
+     * sample is taken (hoisted loop bodies are temporaries, their nodes do not outlive the loop).
+     *
+     * Between samples the cost is a push, a pop and two atomic loads per statement.
+     */
+    class Profiler
+    {
+    public:
+        static constexpr uint64_t DEFAULT_INTERVAL_US = 1000;
+
+        explicit Profiler(uint64_t every = 0, uint64_t interval_us = DEFAULT_INTERVAL_US);
+        ~Profiler();
+
+        Profiler(const Profiler &) = delete;
+        Profiler &operator=(const Profiler &) = delete;
+
+        // arm/disarm the timer, samples are only taken in between; both on the thread that runs the interpreter
+        void start();
+        void stop();
+
+        // ticks are charged to the stack that was running when they came, so it is checked before it changes
+        void enter(const Stmt *stmt)
+        {
+            if (every == 0 && timer_fired())
+                sample();
+            stack.push_back(stmt);
+            if (every != 0 && --countdown == 0)
+                sample();
+        }
+        void leave()
+        {
+            if (every == 0 && timer_fired())
+                sample();
+            stack.pop_back();
+        }
+
+        uint64_t samples() const { return total; }
+
+        // one "root;frame;frame count" line per distinct stack, for flamegraph.pl / speedscope / inferno
+        std::string folded(const std::string &root) const;
+        // samples per line of the innermost statement, hottest first, with the line's text when `source` is given
+        std::vector<std::string> hot_lines(const std::string &source, size_t limit = 10) const;
+        std::string describe() const; // how samples were taken
+
+    private:
+        uint64_t every;
+        uint64_t interval_us;
+        uint64_t countdown;
+        uint64_t seen_ticks = 0;
+        std::atomic<uint64_t> ticks{0}; // bumped by the SIGPROF handler
+        struct Timer;
+        std::unique_ptr<Timer> timer;
+        bool running = false;
+        uint64_t total = 0;
+        uint64_t weight = 1; // timer ticks the next sample stands for
+
+        // kind of statement and its line, 0 when no token tells
+        struct Frame
+        {
+            const char *kind;
+            int line;
+            auto operator<=>(const Frame &) const = default;
+        };
+
+        std::vector<const Stmt *> stack;
+        std::map<std::vector<Frame>, uint64_t> stacks;
+        std::vector<Frame> frames; // reused by sample()
+
+        bool timer_fired();
+        void sample();
+        static Frame frame_of(const Stmt *stmt);
+    };
+}
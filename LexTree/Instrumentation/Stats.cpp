@@ -0,0 +1,96 @@
+#include "Stats.h"
+#include "../Parser/Expr.h"
+#include <sstream>
+
+namespace lex
+{
+    namespace
+    {
+        size_t count(const Expr *expr)
+        {
+            if (expr == nullptr)
+                return 0;
+            if (auto binary = dynamic_cast<const Binary *>(expr))
+                return 1 + count(binary->left.get()) + count(binary->right.get());
+            if (auto logical = dynamic_cast<const Logical *>(expr))
+                return 1 + count(logical->left.get()) + count(logical->right.get());
+            if (auto ternary = dynamic_cast<const Ternary *>(expr))
+                return 1 + count(ternary->condition.get()) + count(ternary->then_branch.get()) +
+                       count(ternary->else_branch.get());
+            if (auto unary = dynamic_cast<const Unary *>(expr))
+                return 1 + count(unary->right.get());
+            if (auto grouping = dynamic_cast<const Grouping *>(expr))
+                return 1 + count(grouping->expression.get());
+            if (auto assign = dynamic_cast<const Assign *>(expr))
+                return 1 + count(assign->value.get());
+            return 1; // Literal, Variable
+        }
+
+        size_t count(const Stmt *stmt)
+        {
+            if (stmt == nullptr)
+                return 0;
+            if (auto expression = dynamic_cast<const ExpressionStmt *>(stmt))
+                return 1 + count(expression->expression.get());
+            if (auto print = dynamic_cast<const PrintStmt *>(stmt))
+                return 1 + count(print->expression.get());
+            if (auto variable = dynamic_cast<const VariableStmt *>(stmt))
+                return 1 + count(variable->initializer.get());
+            if (auto block = dynamic_cast<const BlockStmt *>(stmt))
+                return 1 + Stats::count_nodes(block->statements);
+            if (auto if_stmt = dynamic_cast<const IfStmt *>(stmt))
+                return 1 + count(if_stmt->condition.get()) + count(if_stmt->then_branch.get()) +
+                       count(if_stmt->else_branch.get());
+            if (auto while_stmt = dynamic_cast<const WhileStmt *>(stmt))
+                return 1 + count(while_stmt->condition.get()) + count(while_stmt->body.get());
+            if (auto for_stmt = dynamic_cast<const ForStmt *>(stmt))
+                return 1 + count(for_stmt->initializer.get()) + count(for_stmt->condition.get()) +
+                       count(for_stmt->increment.get()) + count(for_stmt->body.get());
+            return 1;
+        }
+
+        std::string phase_line(const char *name, const PhaseStats &phase)
+        {
+            std::ostringstream line;
+            line << "[stats] " << name << ": " << phase.milliseconds << " ms, " << phase.allocated.count
+                 << " allocations (" << phase.allocated.bytes << " bytes)";
+            return line.str();
+        }
+    }
+
+    size_t Stats::count_nodes(const std::vector<StmtPtr> &statements)
+    {
+        size_t nodes = 0;
+        for (const auto &statement : statements)
+            nodes += count(statement.get());
+        return nodes;
+    }
+
+    std::vector<std::string> Stats::report() const
+    {
+        std::vector<std::string> lines;
+        if (read.ran)
+            lines.push_back(phase_line("read", read));
+        if (cache.ran)
+            lines.push_back(phase_line("cache load", cache) + ", nodes: " + std::to_string(nodes));
+        if (lex.ran)
+            lines.push_back(phase_line("lex", lex) + ", tokens: " + std::to_string(tokens));
+        if (parse.ran)
+            lines.push_back(phase_line("parse", parse) + ", nodes: " + std::to_string(nodes));
+        if (optimize.ran)
+            lines.push_back(phase_line("optimize", optimize));
+        if (execute.ran)
+        {
+            std::ostringstream line;
+            line << phase_line("execute", execute);
+            if (vm_instructions > 0)
+                line << ", vm instructions: " << vm_instructions;
+            else
+                line << ", statements: " << statements << ", expressions: " << expressions
+                     << ", lookups: " << lookups << " (parent hops: " << lookup_hops << ")"
+                     << ", environments: " << environments;
+            lines.push_back(line.str());
+        }
+        return lines;
+    }
+}
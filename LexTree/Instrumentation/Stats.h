@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Allocations.h"
+#include "../Parser/Stmt.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lex
+{
+    // wall time and heap allocations of one phase of a run
+    struct PhaseStats
+    {
+        bool ran = false;
+        double milliseconds = 0;
+        AllocationCount allocated;
+    };
+
+    /*
+     * What `lextree --stats` reports: the phases of one run and what the tree-walker did. Filled only when an
+     * Engine runs with EngineOptions::stats, everything that counts is behind a null check of the Stats pointer.
+     */
+    struct Stats
+    {
+        PhaseStats read, cache, lex, parse, optimize, execute;
+        size_t tokens = 0;
+        size_t nodes = 0; // statements and expressions after parsing
+
+        // tree-walker only, the VM reports its instruction count instead
+        uint64_t statements = 0;   // executed
+        uint64_t expressions = 0;  // evaluated
+        uint64_t lookups = 0;      // variable reads and writes resolved through the scope chain
+        uint64_t lookup_hops = 0;  // parent scopes those lookups walked up
+        uint64_t environments = 0; // scopes created
+
+        uint64_t vm_instructions = 0;
+
+        // one line per phase that ran
+        std::vector<std::string> report() const;
+
+        static size_t count_nodes(const std::vector<StmtPtr> &statements);
+    };
+
+    // adds the time and allocations between construction and destruction to a phase, does nothing without one
+    class PhaseTimer
+    {
+    public:
+        explicit PhaseTimer(PhaseStats *phase) : phase(phase)
+        {
+            if (phase)
+            {
+                start = std::chrono::steady_clock::now();
+                before = allocations();
+            }
+        }
+
+        ~PhaseTimer()
+        {
+            if (!phase)
+                return;
+            phase->ran = true;
+            phase->milliseconds +=
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            AllocationCount made = allocations() - before;
+            phase->allocated.count += made.count;
+            phase->allocated.bytes += made.bytes;
+            phase->allocated.frees += made.frees;
+        }
+
+        PhaseTimer(const PhaseTimer &) = delete;
+        PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+    private:
+        PhaseStats *phase;
+        std::chrono::steady_clock::time_point start;
+        AllocationCount before;
+    };
+}
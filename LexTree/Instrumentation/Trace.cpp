@@ -0,0 +1,234 @@
+#include "Trace.h"
+#include "Lines.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace lex
+{
+    std::atomic<bool> Trace::recording{false};
+
+    namespace
+    {
+        struct Event
+        {
+            char phase; // 'X' span, 'b'/'e' start/end of something on a script's track
+            const char *name;
+            const char *category;
+            const char *arg_name;
+            int64_t arg;
+            double start;
+            double duration;
+            uint64_t track;
+            std::string label; // names a track, or is the span's "script" argument
+        };
+
+        // what one thread recorded, only that thread appends to it
+        struct ThreadLog
+        {
+            size_t tid = 0;
+            std::string name;
+            std::vector<Event> events;
+        };
+
+        std::mutex logs_mutex;
+        std::vector<std::unique_ptr<ThreadLog>> logs;
+        std::atomic<size_t> kept{0};
+        std::atomic<size_t> dropped{0};
+        std::atomic<uint64_t> next_track{1};
+        std::string output_path;
+        std::chrono::steady_clock::time_point origin;
+
+        ThreadLog &thread_log()
+        {
+            thread_local ThreadLog *mine = nullptr;
+            if (mine == nullptr)
+            {
+                std::lock_guard<std::mutex> lock(logs_mutex);
+                logs.push_back(std::make_unique<ThreadLog>());
+                mine = logs.back().get();
+                mine->tid = logs.size();
+            }
+            return *mine;
+        }
+
+        void record(Event event)
+        {
+            if (kept.fetch_add(1, std::memory_order_relaxed) >= Trace::MAX_EVENTS)
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            thread_log().events.push_back(std::move(event));
+        }
+
+        std::string quoted(const std::string &text)
+        {
+            std::string out = "\"";
+            for (char c : text)
+            {
+                if (c == '"' || c == '\\')
+                {
+                    out += '\\';
+                    out += c;
+                }
+                else if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                }
+                else
+                    out += c;
+            }
+            return out + "\"";
+        }
+
+        std::string microseconds(double value)
+        {
+            char text[32];
+            std::snprintf(text, sizeof(text), "%.3f", value);
+            return text;
+        }
+
+        void write_event(std::ostream &out, size_t tid, const Event &event)
+        {
+            std::string name = event.name ? event.name : event.label;
+            out << "{\"name\":" << quoted(name) << ",\"cat\":\"" << event.category << "\",\"ph\":\"" << event.phase
+                << "\",\"ts\":" << microseconds(event.start) << ",\"pid\":1,\"tid\":" << tid;
+            if (event.phase == 'X')
+                out << ",\"dur\":" << microseconds(event.duration);
+            else
+                out << ",\"id\":" << event.track;
+
+            if (event.arg_name)
+                out << ",\"args\":{\"" << event.arg_name << "\":" << event.arg << "}";
+            else if (event.phase == 'X' && !event.label.empty())
+                out << ",\"args\":{\"script\":" << quoted(event.label) << "}";
+            out << "}";
+        }
+    }
+
+    bool Trace::start(const std::string &path)
+    {
+#ifdef LEXTREE_TRACING
+        std::lock_guard<std::mutex> lock(logs_mutex);
+        if (!output_path.empty())
+            return true;
+        output_path = path;
+        origin = std::chrono::steady_clock::now();
+        std::atexit(&Trace::finish);
+        recording.store(true, std::memory_order_relaxed);
+        return true;
+#else
+        (void)path;
+        return false;
+#endif
+    }
+
+    // at exit, once the threads that recorded have finished (batch and server join theirs before returning)
+    void Trace::finish()
+    {
+        recording.store(false, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(logs_mutex);
+        std::ofstream out(output_path);
+        out << "{\"traceEvents\":[\n";
+        out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"lextree\"}}";
+        size_t written = 0;
+        for (const auto &log : logs)
+        {
+            std::string name = !log->name.empty() ? log->name : log->tid == 1 ? "main" : "thread " + std::to_string(log->tid);
+            out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << log->tid
+                << ",\"args\":{\"name\":" << quoted(name) << "}}";
+            for (const Event &event : log->events)
+            {
+                out << ",\n";
+                write_event(out, log->tid, event);
+            }
+            written += log->events.size();
+        }
+        out << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":" << dropped.load() << "}}\n";
+
+        if (!out)
+            std::cerr << "[trace] could not write " << output_path << std::endl;
+        else
+        {
+            std::cerr << "[trace] " << written << " events in " << output_path;
+            if (dropped.load() != 0)
+                std::cerr << ", " << dropped.load() << " dropped past " << MAX_EVENTS;
+            std::cerr << std::endl;
+        }
+    }
+
+    double Trace::now()
+    {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    void Trace::span(const char *name, const char *category, double start, const char *arg_name, int64_t arg)
+    {
+        record(Event{'X', name, category, arg_name, arg, start, now() - start, 0, {}});
+    }
+
+    void Trace::span(const char *name, const char *category, double start, const std::string &label)
+    {
+        record(Event{'X', name, category, nullptr, 0, start, now() - start, 0, label});
+    }
+
+    void Trace::name_thread(const std::string &name)
+    {
+        if (!on())
+            return;
+        thread_log().name = name;
+    }
+
+    uint64_t Trace::open_track(const std::string &name)
+    {
+        uint64_t track = next_track.fetch_add(1, std::memory_order_relaxed);
+        record(Event{'b', nullptr, "script", nullptr, 0, now(), 0, track, name});
+        return track;
+    }
+
+    void Trace::track_slice(uint64_t track, const char *name, double start)
+    {
+        record(Event{'b', name, "script", nullptr, 0, start, 0, track, {}});
+        record(Event{'e', name, "script", nullptr, 0, now(), 0, track, {}});
+    }
+
+    void Trace::close_track(uint64_t track, const std::string &name)
+    {
+        record(Event{'e', nullptr, "script", nullptr, 0, now(), 0, track, name});
+    }
+
+    TraceSpan::~TraceSpan()
+    {
+        if (start < 0 || !Trace::on())
+            return;
+        if (where)
+            Trace::span(name, category, start, "line", line_of(where));
+        else
+            Trace::span(name, category, start, arg_name, arg);
+    }
+
+    TraceScript::TraceScript(const std::string &name)
+    {
+        if (!Trace::on())
+            return;
+        label = name;
+        track = Trace::open_track(label);
+        start = Trace::now();
+    }
+
+    TraceScript::~TraceScript()
+    {
+        if (start < 0 || !Trace::on())
+            return;
+        Trace::span("script", "batch", start, label);
+        Trace::close_track(track, label);
+    }
+}
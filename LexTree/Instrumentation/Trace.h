@@ -0,0 +1,109 @@
+#pragma once
+
+#include "../Parser/Stmt.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace lex
+{
+    /*
+     * Chrome Trace Event output for `lextree --trace FILE`, to open in Perfetto (ui.perfetto.dev) or
+     * chrome://tracing. Spans are complete ("X") events on the track of the thread that ran them, scripts of a batch
+     * also get a track of their own (async events, one id per script).
+     *
+     * Process-wide: start() once, every thread records into its own buffer, the file is written when the process
+     * exits. The spans in the code are LEX_TRACE_* macros that compile to nothing unless LEXTREE_TRACING is defined
+     * (CMake option, on by default). Compiled in but not started, a span costs one relaxed load.
+     */
+    class Trace
+    {
+    public:
+        // events kept over all threads, later ones are dropped (a tight loop makes one block span per iteration)
+        static constexpr size_t MAX_EVENTS = 1'000'000;
+
+        // record from now on, written to `path` at exit. False when it was built without LEXTREE_TRACING.
+        static bool start(const std::string &path);
+        static bool on() { return recording.load(std::memory_order_relaxed); }
+
+        // microseconds since start()
+        static double now();
+
+        // a span of the calling thread, `arg` is shown with it when `arg_name` is set
+        static void span(const char *name, const char *category, double start, const char *arg_name = nullptr,
+                         int64_t arg = 0);
+        static void span(const char *name, const char *category, double start, const std::string &label);
+
+        // names the calling thread's track
+        static void name_thread(const std::string &name);
+
+        // a track of its own for a script: open it, add slices to it (e.g. each time a scheduler ran the script),
+        // close it
+        static uint64_t open_track(const std::string &name);
+        static void track_slice(uint64_t track, const char *name, double start);
+        static void close_track(uint64_t track, const std::string &name);
+
+    private:
+        static std::atomic<bool> recording;
+
+        static void finish(); // writes the file, at exit
+    };
+
+    // span from construction to destruction, nothing recorded when the trace is off
+    class TraceSpan
+    {
+    public:
+        TraceSpan(const char *name, const char *category, const char *arg_name = nullptr, int64_t arg = 0)
+            : name(name), category(category), arg_name(arg_name), arg(arg), start(Trace::on() ? Trace::now() : -1)
+        {
+        }
+
+        // statement spans show the statement's line, looked up only when recorded
+        TraceSpan(const char *name, const Stmt *where)
+            : name(name), category("interpreter"), where(where), start(Trace::on() ? Trace::now() : -1)
+        {
+        }
+
+        ~TraceSpan();
+
+        TraceSpan(const TraceSpan &) = delete;
+        TraceSpan &operator=(const TraceSpan &) = delete;
+
+    private:
+        const char *name;
+        const char *category;
+        const char *arg_name = nullptr;
+        int64_t arg = 0;
+        const Stmt *where = nullptr;
+        double start;
+    };
+
+    // a script on its own track and as a span on the thread's, `label` is its path
+    class TraceScript
+    {
+    public:
+        explicit TraceScript(const std::string &name);
+        ~TraceScript();
+
+        TraceScript(const TraceScript &) = delete;
+        TraceScript &operator=(const TraceScript &) = delete;
+
+    private:
+        std::string label;
+        uint64_t track = 0;
+        double start = -1;
+    };
+}
+
+#ifdef LEXTREE_TRACING
+#define LEX_TRACE_CONCAT_(a, b) a##b
+#define LEX_TRACE_CONCAT(a, b) LEX_TRACE_CONCAT_(a, b)
+// LEX_TRACE_SPAN("lex", "compile") or LEX_TRACE_SPAN("while", stmt), until the end of the scope
+#define LEX_TRACE_SPAN(...) ::lex::TraceSpan LEX_TRACE_CONCAT(trace_span_, __LINE__)(__VA_ARGS__)
+#define LEX_TRACE_SCRIPT(label) ::lex::TraceScript LEX_TRACE_CONCAT(trace_script_, __LINE__)(label)
+#define LEX_TRACE_THREAD(name) ::lex::Trace::name_thread(name)
+#else
+#define LEX_TRACE_SPAN(...) ((void)0)
+#define LEX_TRACE_SCRIPT(label) ((void)0)
+#define LEX_TRACE_THREAD(name) ((void)0)
+#endif
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "../Error_Handling/RunTimeError.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+namespace lex
+{
+    /*
+     * Execution limits of one backend, checked at loop back-edges (every iteration of a while/for, the VM's LOOP).
+     * Lex has no functions, so loops are the only way a script keeps running; a step is one iteration and
+     * straight-line code is bounded by its own length.
+     *
+     * tick() is an increment and a compare. Everything else (step limit, deadline, interrupt flag, end of a time
+     * slice) is looked at only when the counter reaches `next_check`, at most CHECK_INTERVAL steps apart.
+     */
+    class Budget
+    {
+    public:
+        static constexpr uint64_t CHECK_INTERVAL = 1024;
+        static constexpr uint64_t NONE = std::numeric_limits<uint64_t>::max();
+
+        // at the start of a run, 0 means no limit
+        void reset(uint64_t step_limit, uint64_t time_limit_ms)
+        {
+            used = 0;
+            limit = step_limit;
+            time_limit = time_limit_ms;
+            if (time_limit_ms != 0)
+                deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(time_limit_ms);
+            slice_end = NONE;
+            schedule();
+        }
+
+        // the next `steps` safe points make a slice, after which tick() asks the caller to suspend (0: no slice)
+        void set_slice(uint64_t steps)
+        {
+            slice_end = steps == 0 ? NONE : used + steps;
+            schedule();
+        }
+
+        // true when the current slice is used up and the caller should suspend, throws Interrupted when the run
+        // is over (limit reached or interrupt())
+        bool tick()
+        {
+            return ++used >= next_check && check();
+        }
+
+        // ends the current slice at the next safe point, no effect outside a slice. Same thread as tick().
+        void end_slice()
+        {
+            if (slice_end != NONE)
+            {
+                slice_end = used;
+                next_check = used;
+            }
+        }
+
+        // callable from any thread, seen within CHECK_INTERVAL steps
+        void interrupt() { interrupt_requested.store(true, std::memory_order_relaxed); }
+        void clear_interrupt() { interrupt_requested.store(false, std::memory_order_relaxed); }
+
+        uint64_t steps() const { return used; }
+
+    private:
+        uint64_t used = 0;
+        uint64_t limit = 0;
+        uint64_t time_limit = 0;
+        std::chrono::steady_clock::time_point deadline;
+        uint64_t slice_end = NONE;
+        uint64_t next_check = CHECK_INTERVAL;
+        std::atomic<bool> interrupt_requested{false};
+
+        void schedule()
+        {
+            // the step past the limit is the one that fails
+            uint64_t over_limit = limit != 0 && limit != NONE ? limit + 1 : NONE;
+            next_check = std::min({used + CHECK_INTERVAL, over_limit, slice_end});
+        }
+
+        bool check()
+        {
+            if (interrupt_requested.load(std::memory_order_relaxed))
+                throw Interrupted("Execution interrupted.");
+            if (limit != 0 && used > limit)
+                throw Interrupted("Step limit of " + std::to_string(limit) + " exceeded.");
+            if (time_limit != 0 && std::chrono::steady_clock::now() >= deadline)
+                throw Interrupted("Time limit of " + std::to_string(time_limit) + " ms exceeded.");
+            bool suspend = used >= slice_end;
+            schedule();
+            return suspend;
+        }
+    };
+}
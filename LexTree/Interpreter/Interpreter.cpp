@@ -1,10 +1,21 @@
 #include "Interpreter.h"
-#include "../LexTree.h"
+#include "../Optimizer/Optimizer.h"
 #include <iostream>
 #include <any>
 
 namespace lex
 {
+    namespace
+    {
+        // statement on the profiler's stack for as long as it runs, errors included
+        struct ProfiledFrame
+        {
+            Profiler &profiler;
+            ProfiledFrame(Profiler &profiler, const Stmt *stmt) : profiler(profiler) { profiler.enter(stmt); }
+            ~ProfiledFrame() { profiler.leave(); }
+        };
+    }
+
     // Convert value to string for printing
     std::string value_to_string(const Value &value)
     {
@@ -49,9 +60,31 @@ namespace lex
         throw RuntimeError(operator_token, "Operands must be numbers.");
     }
 
-    void Interpreter::interpret(const std::vector<StmtPtr> &statements)
+    // strings are the only values that grow while a script runs, the new one has to fit next to the variables
+    Value Interpreter::concatenated(const Token &operator_token, const std::string &left, const std::string &right)
     {
-        for (const auto &statement : statements)
+        // checked before allocating, so a concatenation over the limit never builds its result
+        size_t size = left.size() + right.size();
+        if (!memory.fits(size))
+            throw RuntimeError(operator_token, memory.exceeded());
+        memory.observe(size);
+
+        std::string text;
+        text.reserve(size);
+        text += left;
+        text += right;
+        return Value(std::move(text));
+    }
+
+    void Interpreter::interpret(const ProgramPtr &program)
+    {
+        if (program != planned_program)
+        {
+            loop_plans.clear();
+            planned_program = program;
+        }
+
+        for (const auto &statement : program->statements)
         {
             try
             {
@@ -59,18 +92,31 @@ namespace lex
             }
             catch (const RuntimeError &error)
             {
-                LexTree::runtimeError(error);
+                diagnostics.runtime_error(error);
             }
         }
     }
 
     void Interpreter::execute(const StmtPtr &stmt)
     {
+        if (stats)
+            stats->statements++;
+        if (coverage)
+            coverage->hit(stmt.get());
+        if (profiler)
+        {
+            ProfiledFrame frame(*profiler, stmt.get());
+            stmt->accept(this);
+            return;
+        }
         stmt->accept(this);
     }
 
     void Interpreter::executeBlock(const std::vector<StmtPtr> &statements, std::shared_ptr<Environment> environment)
     {
+        if (stats)
+            stats->environments++;
+        LEX_TRACE_SPAN("block", statements.empty() ? nullptr : statements.front().get());
         std::shared_ptr<Environment> previous = this->environment;
         try
         {
@@ -92,6 +138,10 @@ namespace lex
 
     Value Interpreter::evaluate(const ExprPtr &expression)
     {
+        if (stats)
+            stats->expressions++;
+        if (coverage)
+            coverage->hit(expression.get());
         return std::any_cast<Value>(expression->accept(this));
     }
 
@@ -104,7 +154,7 @@ namespace lex
     void Interpreter::visitPrintStmt(PrintStmt *stmt)
     {
         Value value = evaluate(stmt->expression);
-        std::cout << value_to_string(value) << std::endl;
+        out << value_to_string(value) << std::endl;
         return;
     }
 
@@ -116,7 +166,7 @@ namespace lex
             value = evaluate(stmt->initializer);
         }
 
-        environment->define(stmt->name.lexeme, value);
+        environment->define(stmt->name, value);
     }
 
     void Interpreter::visitBlockStmt(BlockStmt *stmt)
@@ -130,6 +180,8 @@ namespace lex
     void Interpreter::visitIfStmt(IfStmt *stmt)
     {
         const Value condition = evaluate(stmt->condition);
+        if (coverage)
+            coverage->branch(stmt, is_truthy(condition));
         if (is_truthy(condition))
         {
             execute(stmt->then_branch);
@@ -142,22 +194,33 @@ namespace lex
 
     void Interpreter::visitWhileStmt(WhileStmt *stmt)
     {
+        LEX_TRACE_SPAN("while", stmt);
+        const std::optional<CountedLoop> &plan = loop_plan(stmt);
+        if (plan && run_counted_loop(*plan))
+            return;
+
         while (is_truthy(evaluate(stmt->condition)))
         {
             execute(stmt->body);
+            budget.tick();
         }
     }
 
     void Interpreter::visitForStmt(ForStmt *stmt)
     {
+        LEX_TRACE_SPAN("for", stmt);
         // Execute the initializer
         if (stmt->initializer != nullptr)
         {
             execute(stmt->initializer);
         }
 
-        // Execute the loop
-        while (is_truthy(evaluate(stmt->condition)))
+        const std::optional<CountedLoop> &plan = loop_plan(stmt);
+        if (plan && run_counted_loop(*plan))
+            return;
+
+        // Execute the loop, a missing condition (`for (;;)`) is always true
+        while (stmt->condition == nullptr || is_truthy(evaluate(stmt->condition)))
         {
             execute(stmt->body);
 
@@ -166,7 +229,138 @@ namespace lex
             {
                 evaluate(stmt->increment);
             }
+            budget.tick();
+        }
+    }
+
+    template <typename LoopStmt>
+    const std::optional<CountedLoop> &Interpreter::loop_plan(LoopStmt *stmt)
+    {
+        static const std::optional<CountedLoop> none;
+        if (!specialize_loops)
+            return none;
+
+        auto it = loop_plans.find(stmt);
+        if (it == loop_plans.end())
+        {
+            it = loop_plans.emplace(stmt, analyze_counted_loop(*stmt)).first;
+            if (hoisted_depth > 0)
+                temporary_plans.push_back(stmt);
         }
+        return it->second;
+    }
+
+    // a hoisted body in use: loops first planned while it runs are forgotten when it goes
+    struct Interpreter::TemporaryPlans
+    {
+        Interpreter &interpreter;
+        const size_t mark;
+        const bool active;
+
+        TemporaryPlans(Interpreter &interpreter, bool active)
+            : interpreter(interpreter), mark(interpreter.temporary_plans.size()), active(active)
+        {
+            if (active)
+                interpreter.hoisted_depth++;
+        }
+
+        ~TemporaryPlans()
+        {
+            if (!active)
+                return;
+            interpreter.hoisted_depth--;
+            for (size_t i = mark; i < interpreter.temporary_plans.size(); i++)
+                interpreter.loop_plans.erase(interpreter.temporary_plans[i]);
+            interpreter.temporary_plans.resize(mark);
+        }
+    };
+
+    bool Interpreter::run_counted_loop(const CountedLoop &loop)
+    {
+        // anything unusual (undefined counter, non-number bound) is left to the generic path to report
+        if (stats)
+            count_lookup(loop.counter);
+        Value *slot = environment->find(loop.counter);
+        if (slot == nullptr || !std::holds_alternative<double>(*slot))
+            return false;
+        Value bound = evaluate(loop.bound);
+        if (!std::holds_alternative<double>(bound))
+            return false;
+
+        double counter = std::get<double>(*slot);
+        const double limit = std::get<double>(bound);
+        const double step = loop.step;
+
+        // hoisting rewrites the body, only worth it when the loop runs for a while
+        const std::vector<StmtPtr> *body = &loop.body;
+        std::vector<StmtPtr> hoisted;
+        if (!loop.invariants.empty() && (limit - counter) / step >= 8)
+        {
+            hoisted = hoist_invariants(loop);
+            body = &hoisted;
+        }
+        TemporaryPlans temporaries(*this, body == &hoisted);
+
+        auto keep_going = [&]()
+        {
+            switch (loop.comparison)
+            {
+            case TokenType::LESS:
+                return counter < limit;
+            case TokenType::LESS_EQUAL:
+                return counter <= limit;
+            case TokenType::GREATER:
+                return counter > limit;
+            default:
+                return counter >= limit;
+            }
+        };
+
+        while (keep_going())
+        {
+            if (loop.needs_scope)
+            {
+                executeBlock(*body, std::make_shared<Environment>(environment));
+            }
+            else
+            {
+                // no declarations, the per-iteration scope would be empty and unobservable
+                for (const auto &statement : *body)
+                    execute(statement);
+            }
+
+            counter += step;
+            *slot = counter; // the body may read the counter, keep the variable current
+            budget.tick();
+        }
+        return true;
+    }
+
+    std::vector<StmtPtr> Interpreter::hoist_invariants(const CountedLoop &loop)
+    {
+        // invariants are pure, evaluating one early is unobservable unless it fails,
+        // in which case it stays in the body and fails (or not) exactly where it used to
+        std::unordered_map<const Expr *, ExprPtr> values;
+        for (const auto &invariant : loop.invariants)
+        {
+            try
+            {
+                Value value = evaluate(invariant);
+                if (std::holds_alternative<double>(value))
+                    values[invariant.get()] = make_Literal(std::get<double>(value));
+                else if (std::holds_alternative<std::string>(value))
+                    values[invariant.get()] = make_Literal(std::get<std::string>(value));
+                else if (std::holds_alternative<bool>(value))
+                    values[invariant.get()] = make_Literal(std::get<bool>(value));
+            }
+            catch (const RuntimeError &)
+            {
+            }
+        }
+
+        Optimizer optimizer;
+        optimizer.substitute(std::move(values));
+        return optimizer.optimize(loop.body);
     }
 
     // Expressions returns the evaluated value
@@ -232,14 +426,14 @@ namespace lex
                 return Value(std::get<double>(left) + std::get<double>(right));
 
             if (std::holds_alternative<std::string>(left) && std::holds_alternative<std::string>(right))
-                return Value(std::get<std::string>(left) + std::get<std::string>(right));
+                return concatenated(expr->operator_token, std::get<std::string>(left), std::get<std::string>(right));
 
             // Allow string concatenation with other types
             if (std::holds_alternative<std::string>(left))
-                return Value(std::get<std::string>(left) + value_to_string(right));
+                return concatenated(expr->operator_token, std::get<std::string>(left), value_to_string(right));
 
             if (std::holds_alternative<std::string>(right))
-                return Value(value_to_string(left) + std::get<std::string>(right));
+                return concatenated(expr->operator_token, value_to_string(left), std::get<std::string>(right));
 
             throw RuntimeError(expr->operator_token,
                                "Operands must be two numbers or two strings.");
@@ -276,6 +470,8 @@ namespace lex
     std::any Interpreter::visitTernaryExpr(Ternary *expr)
     {
         Value condition = evaluate(expr->condition);
+        if (coverage)
+            coverage->branch(expr, is_truthy(condition));
         if (is_truthy(condition))
             return evaluate(expr->then_branch);
         return evaluate(expr->else_branch);
@@ -283,6 +479,8 @@ namespace lex
 
     std::any Interpreter::visitVariableExpr(Variable *expr)
     {
+        if (stats)
+            count_lookup(expr->name.lexeme);
         Value value = environment->get(expr->name); // this just retrieves the value from the environment
         if (std::holds_alternative<std::monostate>(value))
         {
@@ -294,13 +492,23 @@ namespace lex
     std::any Interpreter::visitAssignExpr(Assign *expr)
     {
         Value value = evaluate(expr->value);
+        if (stats)
+            count_lookup(expr->name.lexeme);
         environment->assign(expr->name, value);
         return value;
     }
 
+    void Interpreter::count_lookup(const std::string &name)
+    {
+        stats->lookups++;
+        stats->lookup_hops += environment->distance(name);
+    }
+
     std::any Interpreter::visitLogicalExpr(Logical *expr)
     {
         Value left = evaluate(expr->left);
+        if (coverage)
+            coverage->branch(expr, is_truthy(left) == (expr->operator_token.type == TokenType::OR));
 
         // Short-circuit evaluation
         if (expr->operator_token.type == TokenType::OR)
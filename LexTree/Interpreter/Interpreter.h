@@ -3,16 +3,58 @@
 #include "../Parser/Stmt.h"
 #include "../Parser/Environment.h"
 #include "../Error_Handling/RunTimeError.h"
+#include "../Error_Handling/Diagnostics.h"
+#include "../Optimizer/LoopAnalysis.h"
+#include "../Program.h"
 #include "Value.h"
+#include "Budget.h"
+#include "Memory.h"
+#include "../Instrumentation/Profiler.h"
+#include "../Instrumentation/Stats.h"
+#include "../Instrumentation/Trace.h"
+#include "../Instrumentation/Coverage.h"
+#include <iostream>
 #include <vector>
 #include <stdexcept>
+#include <optional>
+#include <unordered_map>
 
 namespace lex
 {
     class Interpreter : public ExprVisitor, public StmtVisitor
     {
     public:
-        void interpret(const std::vector<StmtPtr> &statements);
+        // `print` writes to `out`, runtime errors go to `diagnostics`
+        explicit Interpreter(Diagnostics &diagnostics, std::ostream &out = std::cout)
+            : diagnostics(diagnostics), out(out)
+        {
+        }
+
+        void interpret(const ProgramPtr &program);
+
+        // step/time limits and interrupts, ticked once per loop iteration; reset it before interpret()
+        Budget budget;
+
+        // what the variables and the string being built take, limit checked as they grow (set_limit() to cap)
+        Memory memory;
+
+        // count what runs into `stats` (statements, expressions, lookups, scopes), nullptr to stop
+        void set_stats(Stats *counters) { stats = counters; }
+
+        // keep the statements being run on `profiler`'s stack so it can sample them, nullptr to stop
+        void set_profiler(Profiler *sampler) { profiler = sampler; }
+
+        // count every node that runs and every branch taken into `counters`, nullptr to stop. Exact counts need
+        // the generic loop path, turn loop specialization off while it is set.
+        void set_coverage(Coverage *counters) { coverage = counters; }
+
+        // run counted loops on the specialized path (see LoopAnalysis.h), on by default
+        void set_loop_specialization(bool enabled) { specialize_loops = enabled; }
+
+        // global variables, to start other runs from this state
+        Snapshot snapshot() const { return globals->snapshot(); }
+        // replace the globals by a copy-on-write fork of a snapshot
+        void fork(Snapshot snapshot) { environment = globals = std::make_shared<Environment>(std::move(snapshot), &memory); }
 
         // Visit methods from ExprVisitor
         std::any visitBinaryExpr(Binary *expr) override;
@@ -34,13 +76,37 @@ namespace lex
         void visitForStmt(ForStmt *stmt) override;
 
     private:
-        std::shared_ptr<Environment> environment = std::make_shared<Environment>();
+        Diagnostics &diagnostics;
+        std::ostream &out;
+        std::shared_ptr<Environment> globals = std::make_shared<Environment>(&memory);
+        std::shared_ptr<Environment> environment = globals;
+        bool specialize_loops = true;
+        Stats *stats = nullptr;
+        Profiler *profiler = nullptr;
+        Coverage *coverage = nullptr;
+        // side table of the program being run: analysis result of every loop seen so far, keyed by node.
+        // Holding the program keeps the keys alive, running the same program again reuses the plans.
+        ProgramPtr planned_program;
+        std::unordered_map<const Stmt *, std::optional<CountedLoop>> loop_plans;
+        // plans of loops inside a hoisted body, which is a temporary: they are dropped with it, before another
+        // temporary node can get the same address
+        std::vector<const Stmt *> temporary_plans;
+        size_t hoisted_depth = 0;
+        struct TemporaryPlans;
 
         // Helper methods for evaluation
         void execute(const StmtPtr &stmt);
         void executeBlock(const std::vector<StmtPtr> &statements, std::shared_ptr<Environment> environment);
         Value evaluate(const ExprPtr &expr);
+        void count_lookup(const std::string &name);
         void check_number_operand(const Token &operator_token, const Value &operand);
         void check_number_operands(const Token &operator_token, const Value &left, const Value &right);
+        Value concatenated(const Token &operator_token, const std::string &left, const std::string &right);
+
+        // counted loop fast path, returns false (without running anything) when the loop has to take the generic path
+        template <typename LoopStmt>
+        const std::optional<CountedLoop> &loop_plan(LoopStmt *stmt);
+        bool run_counted_loop(const CountedLoop &loop);
+        std::vector<StmtPtr> hoist_invariants(const CountedLoop &loop);
     };
 }
\ No newline at end of file
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Value.h"
+#include <algorithm>
+#include <cstddef>
+#include <string>
+
+namespace lex
+{
+    /*
+     * Memory account of one backend. Environments charge every variable they hold (name, value and the map node
+     * around them) and the string a concatenation is about to build is checked against what is left, so a script
+     * cannot hold more than `limit` bytes in variables and strings. Snapshots a run was forked from are shared with
+     * other engines and not charged, a variable copied out of one is.
+     */
+    class Memory
+    {
+    public:
+        // std::map node of a variable: tree links and colour, key and value
+        static constexpr size_t ENTRY_OVERHEAD = 4 * sizeof(void *) + sizeof(std::string) + sizeof(Value);
+
+        static size_t footprint(const std::string &name, const Value &value)
+        {
+            size_t bytes = ENTRY_OVERHEAD + name.size();
+            if (const std::string *text = std::get_if<std::string>(&value))
+                bytes += text->size();
+            return bytes;
+        }
+
+        // 0 for no limit, applies from the next check on
+        void set_limit(size_t bytes) { max = bytes; }
+        size_t limit() const { return max; }
+
+        // whether `more` bytes on top of what is held stay within the limit
+        bool fits(size_t more) const { return max == 0 || (used <= max && more <= max - used); }
+
+        void add(size_t bytes)
+        {
+            used += bytes;
+            top = std::max(top, used);
+        }
+        void remove(size_t bytes) { used -= std::min(bytes, used); }
+
+        // a temporary of `bytes` exists next to what is held, for the peak
+        void observe(size_t bytes) { top = std::max(top, used + bytes); }
+
+        size_t current() const { return used; }
+        size_t peak() const { return top; }
+        void reset_peak() { top = used; }
+
+        std::string exceeded() const { return "Memory limit of " + std::to_string(max) + " bytes exceeded."; }
+
+    private:
+        size_t max = 0;
+        size_t used = 0;
+        size_t top = 0;
+    };
+}
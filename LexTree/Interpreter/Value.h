@@ -1,4 +1,6 @@
 #pragma once
+#include <map>
+#include <memory>
 #include <string>
 #include <variant>
 
@@ -46,4 +48,8 @@ namespace lex
 
     // Convert value to string for printing
     std::string value_to_string(const Value& value);
+
+    // frozen global variables (see Environment::snapshot), read-only so any number of environments on any number of
+    // threads can share one
+    using Snapshot = std::shared_ptr<const std::map<std::string, Value>>;
 }
\ No newline at end of file
@@ -1,102 +1,193 @@
 #include "LexTree.h"
-#include "Lexer/Lexer.h"
-#include "Parser/parser.h"
-#include "../utility/ASTPrinter.h"
-#include "Interpreter/Interpreter.h"
-
+#include "Batch/BatchRunner.h"
+#include "Repl/Repl.h"
+#include "Server/Server.h"
+#include "Server/Client.h"
+#include "Instrumentation/Trace.h"
+
+#include <csignal>
+#include <filesystem>
 #include <iostream>
-#include <fstream>
-#include <string>
 #include <sstream>
+#include <string>
 
 namespace lex
 {
-    bool LexTree::hadError = false;
-    bool LexTree::hadRuntimeError = false;
-    Interpreter LexTree::interpreter;
+    LexTree::Options LexTree::options;
+    std::string LexTree::prelude;
+    bool LexTree::repl_latency = false;
 
-    void LexTree::runFile(const std::string &path)
+    namespace
     {
-        std::ifstream file(path);
-        if (!file.is_open())
+        Server *active_server = nullptr;
+
+        void stop_server(int)
         {
-            std::cerr << "Could not open file: " << path << std::endl;
-            exit(74);
+            if (active_server)
+                active_server->stop();
         }
 
-        std::stringstream buffer;
-        buffer << file.rdbuf();
-        run(buffer.str());
+        // runs the prelude (if any) on `engine`, exits like runFile when it fails
+        void run_prelude(Engine &engine)
+        {
+            if (LexTree::prelude.empty())
+                return;
+            Engine::Status status = engine.run_file(LexTree::prelude);
+            if (status != Engine::Status::OK)
+                exit(static_cast<int>(status));
+        }
+    }
 
-        if (hadError)
-            exit(65);
-        if (hadRuntimeError)
-            exit(70);
+    void LexTree::runFile(const std::string &path)
+    {
+        Engine engine(options);
+        run_prelude(engine);
+        Engine::Status status;
+        {
+            LEX_TRACE_SPAN("run", "lextree"); // closed before exit()
+            status = engine.run_file(path);
+        }
+        if (status != Engine::Status::OK)
+            exit(static_cast<int>(status));
     }
 
     void LexTree::runPrompt()
     {
+        Engine engine(options);
+        run_prelude(engine);
+        Repl repl(engine);
+        repl.report_latency = repl_latency;
         std::string line;
 
         while (true)
         {
-            std::cout << "> ";
+            std::cout << repl.prompt();
             if (!std::getline(std::cin, line))
                 break;
-            if (line == "exit" || line == "quit" || line == ":q")
+            if (!repl.pending() && (line == "exit" || line == "quit" || line == ":q"))
             {
                 break;
             }
+            if (!repl.pending() && line == ":time")
+            {
+                repl.report_latency = !repl.report_latency;
+                continue;
+            }
 
-            run(line);
-            hadError = false;
-            hadRuntimeError = false;
+            repl.feed(line);
         }
+        repl.flush();
     }
 
-    void LexTree::run(const std::string &source)
+    int LexTree::runBatch(const std::string &target, size_t jobs, const std::string &output_dir, uint64_t slice)
     {
-        Lexer lexer = Lexer(source);
-        std::vector<Token> tokens = lexer.scan_tokens();
-        // for (const auto &token : tokens)
-        //     std::cout << token.lexeme << " ";
-        // std::cout << std::endl;
-        Parser parser = Parser(tokens);
-        std::vector<StmtPtr> statements = parser.parse();
-
-        if (hadError)
-            return;
-
-        // Print AST structure
-        // ASTPrinter printer;
-        // std::cout << printer.print(expression.get()) << std::endl;
-
-        // Interpret the expression
-        interpreter.interpret(statements);
-
-        // Only print the result if there was no runtime error
-        // if (!hadRuntimeError)
-        // {
-        //     std::cout << "Result: " << value_to_string(result) << std::endl;
-        // }
-    }
+        BatchRunner::Options batch;
+        batch.engine = options;
+        if (jobs > 0)
+            batch.jobs = jobs;
+        batch.output_dir = output_dir;
+        batch.slice = slice;
+
+        // executed once, every script forks from the resulting globals
+        if (!prelude.empty())
+        {
+            Engine engine(options);
+            Engine::Status status = engine.run_file(prelude);
+            if (status != Engine::Status::OK)
+                return static_cast<int>(status);
+            batch.prelude = engine.snapshot();
+        }
 
-    void LexTree::error(int line, const std::string &message)
-    {
-        report(line, "", message);
+        std::error_code error;
+        if (!output_dir.empty() && !std::filesystem::is_directory(output_dir, error))
+        {
+            std::cerr << "Not a directory: " << output_dir << std::endl;
+            return 74;
+        }
+
+        std::vector<std::string> scripts = BatchRunner::collect(target);
+        if (scripts.empty())
+        {
+            std::cerr << "No scripts found in: " << target << std::endl;
+            return 74;
+        }
+
+        BatchRunner runner(batch);
+        std::vector<BatchResult> results = runner.run(scripts);
+        for (const auto &result : results)
+        {
+            std::cout << result.output;
+            std::cerr << result.errors;
+        }
+        std::cout.flush();
+
+        const BatchRunner::Summary &summary = runner.summary();
+        std::cerr << "[batch] scripts: " << summary.scripts << ", threads: " << summary.threads
+                  << ", time: " << summary.seconds * 1000 << " ms"
+                  << ", throughput: " << (summary.seconds > 0 ? summary.scripts / summary.seconds : 0) << " scripts/s"
+                  << ", program cache hits: " << summary.cache_hits
+                  << ", compile errors: " << summary.compile_errors << ", runtime errors: " << summary.runtime_errors
+                  << ", io errors: " << summary.io_errors << std::endl;
+
+        if (summary.compile_errors > 0)
+            return 65;
+        if (summary.runtime_errors > 0)
+            return 70;
+        if (summary.io_errors > 0)
+            return 74;
+        return 0;
     }
 
-    void LexTree::runtimeError(const RuntimeError &error)
+    int LexTree::runServer(const std::string &socket_path, size_t jobs)
     {
-        std::cerr << error.what() << "\n[line " << error.token.line << "]" << std::endl;
-        hadRuntimeError = true;
+        Server::Options serve;
+        serve.engine = options;
+        if (jobs > 0)
+            serve.jobs = jobs;
+        if (!prelude.empty())
+        {
+            Engine engine(options);
+            Engine::Status status = engine.run_file(prelude);
+            if (status != Engine::Status::OK)
+                return static_cast<int>(status);
+            serve.prelude = engine.snapshot();
+        }
+
+        Server server(serve);
+        active_server = &server;
+        std::signal(SIGINT, stop_server);
+        std::signal(SIGTERM, stop_server);
+        std::cerr << "[serve] listening on " << socket_path << std::endl;
+        int code = server.serve(socket_path);
+        active_server = nullptr;
+        std::cerr << "[serve] requests: " << server.requests()
+                  << ", program cache hits: " << server.program_cache().hits() << std::endl;
+        return code;
     }
 
-    void LexTree::report(int line, const std::string &where,
-                         const std::string &message)
+    int LexTree::runClient(const std::string &socket_path, const std::string &script)
     {
-        std::cerr << "[line " << line << "] Error" << where
-                  << ": " << message << std::endl;
-        hadError = true;
+        Request request;
+        if (script == "-")
+        {
+            std::stringstream buffer;
+            buffer << std::cin.rdbuf();
+            request.source = buffer.str();
+            request.has_source = true;
+        }
+        else
+        {
+            // the server may run in another directory
+            std::error_code error;
+            std::filesystem::path path = std::filesystem::absolute(script, error);
+            request.path = error ? script : path.string();
+        }
+        if (options.time_limit_ms > 0)
+            request.time_limit_ms = options.time_limit_ms;
+        if (options.step_limit > 0)
+            request.step_limit = options.step_limit;
+        if (options.memory_limit > 0)
+            request.memory_limit = options.memory_limit;
+        return Client::run(socket_path, request);
     }
-} // namespace lexx
\ No newline at end of file
+} // namespace lex
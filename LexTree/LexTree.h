@@ -1,28 +1,38 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
-#include <vector>
-#include "Interpreter/Interpreter.h"
+#include "Engine.h"
 
 namespace lex
 {
+    // command line front end, each run gets its own Engine (see Engine.h for embedding)
     class LexTree {
     public:
-        static bool hadError;
-        static bool hadRuntimeError;
-        static Interpreter interpreter;
+        using Options = Engine::Options;
 
-        static void report(int line, const std::string &where,
-                           const std::string &message);
+        // command line switches, set by main before running anything
+        static Options options;
+        // script run before anything else (--prelude), its globals are visible to every script
+        static std::string prelude;
+        // the REPL reports compile and run time of every entry (--latency)
+        static bool repl_latency;
 
+        // runs a script and exits with 65/70/74 on compile/runtime/IO errors
         static void runFile(const std::string &path);
 
         static void runPrompt();
 
-        static void run(const std::string &source);
+        // runs every script of a directory or manifest on `jobs` threads (0: one per core), output in input order
+        // on stdout or in <output_dir>/<script>.out; returns the exit code. With a `slice` each thread interleaves
+        // its scripts in slices of that many loop iterations (Scheduler).
+        static int runBatch(const std::string &target, size_t jobs, const std::string &output_dir, uint64_t slice = 0);
 
-        static void error(int line, const std::string &message);
+        // serves scripts on a Unix domain socket until SIGINT/SIGTERM, the limits in `options` are the defaults
+        // per request
+        static int runServer(const std::string &socket_path, size_t jobs);
 
-        static void runtimeError(const RuntimeError& error);
+        // runs `script` (a path, or "-" for stdin) on a server and returns its exit code
+        static int runClient(const std::string &socket_path, const std::string &script);
     };
-} // namespace lex
\ No newline at end of file
+} // namespace lex
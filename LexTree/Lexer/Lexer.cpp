@@ -1,9 +1,8 @@
-#include "../LexTree.h"
 #include "Lexer.h"
 
 namespace lex
 {
-    Lexer::Lexer(const std::string &source) : source(source) {}
+    Lexer::Lexer(const std::string &source, Diagnostics &diagnostics) : source(source), diagnostics(diagnostics) {}
 
     bool Lexer::is_at_end() const
     {
@@ -121,7 +120,7 @@ namespace lex
             else if (is_alpha(c))
                 identifier();
             else
-                LexTree::error(line, "Unexpected character."); // still scanning continues
+                diagnostics.error(line, "Unexpected character."); // still scanning continues
             break;
         }
     }
@@ -181,7 +180,7 @@ namespace lex
 
         if (is_at_end())
         {
-            LexTree::error(line, "Unterminated string.");
+            diagnostics.error(line, "Unterminated string.");
             return;
         }
 
@@ -279,7 +278,7 @@ namespace lex
 
         if (nestLevel > 0)
         {
-            LexTree::error(line, "Unterminated block comment.");
+            diagnostics.error(line, "Unterminated block comment.");
         }
     }
 }
\ No newline at end of file
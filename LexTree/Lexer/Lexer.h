@@ -2,6 +2,7 @@
 
 #include "Token.h"
 #include "TokenType.h"
+#include "../Error_Handling/Diagnostics.h"
 #include<string>
 #include<vector>
 
@@ -11,6 +12,7 @@ namespace lex
     {
     private:
         std::string source;
+        Diagnostics &diagnostics;
         std::vector<Token> tokens;
 
         int start = 0;
@@ -36,7 +38,7 @@ namespace lex
 
 
     public:
-        explicit Lexer(const std::string & source);
+        Lexer(const std::string & source, Diagnostics &diagnostics);
 
         // scan all tokens from source
         std::vector<Token> scan_tokens();
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+
+namespace lex
+{
+    // what the Interner did to a program (Program::intern_stats, --intern-stats)
+    struct InternStats
+    {
+        size_t nodes_before = 0; // distinct expression nodes reachable from the program
+        size_t nodes_after = 0;
+        size_t common_subexpressions = 0;
+    };
+}
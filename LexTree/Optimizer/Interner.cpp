@@ -0,0 +1,618 @@
+#include "Interner.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+
+namespace lex
+{
+    namespace
+    {
+        // doubles by their bits so -0 and 0 stay apart (they print differently)
+        std::string literal_detail(const LiteralValue &literal)
+        {
+            if (std::holds_alternative<double>(literal))
+            {
+                double number = std::get<double>(literal);
+                uint64_t bits;
+                std::memcpy(&bits, &number, sizeof bits);
+                return "n" + std::to_string(bits);
+            }
+            if (std::holds_alternative<std::string>(literal))
+                return "s" + std::get<std::string>(literal);
+            if (std::holds_alternative<bool>(literal))
+                return std::get<bool>(literal) ? "t" : "f";
+            return "nil";
+        }
+
+        std::string token_detail(const Token &token)
+        {
+            return std::to_string(static_cast<int>(token.type)) + ":" + token.lexeme;
+        }
+
+        std::string with_line(const std::string &detail, const Token &token)
+        {
+            return detail + "@" + std::to_string(token.line);
+        }
+
+        Token temporary_token(const std::string &name)
+        {
+            return Token(TokenType::IDENTIFIER, name, std::monostate{}, 0);
+        }
+    }
+
+    bool Interner::NodeKey::operator==(const NodeKey &other) const
+    {
+        return detail == other.detail && children[0] == other.children[0] && children[1] == other.children[1] &&
+               children[2] == other.children[2];
+    }
+
+    size_t Interner::NodeKeyHash::operator()(const NodeKey &key) const
+    {
+        size_t hash = std::hash<std::string>{}(key.detail);
+        for (const Expr *child : key.children)
+            hash = hash * 31 + std::hash<const Expr *>{}(child);
+        return hash;
+    }
+
+    std::vector<StmtPtr> Interner::intern(const std::vector<StmtPtr> &statements)
+    {
+        std::unordered_set<const Expr *> seen;
+        for (const auto &statement : statements)
+            count_nodes(statement.get(), seen);
+        statistics.nodes_before = seen.size();
+
+        std::vector<StmtPtr> eliminated = eliminate(statements, true);
+
+        std::vector<StmtPtr> result;
+        result.reserve(temporaries.size() + eliminated.size());
+        for (const auto &name : temporaries)
+            result.push_back(make_VariableStmt(temporary_token(name), nullptr));
+        for (const auto &statement : eliminated)
+            result.push_back(intern(statement));
+
+        seen.clear();
+        for (const auto &statement : result)
+            count_nodes(statement.get(), seen);
+        statistics.nodes_after = seen.size();
+        statistics.common_subexpressions = temporaries.size();
+        return result;
+    }
+
+    // Common subexpressions
+
+    std::vector<StmtPtr> Interner::eliminate(const std::vector<StmtPtr> &statements, bool top_level)
+    {
+        std::vector<StmtPtr> result;
+        std::vector<StmtPtr> run;
+        result.reserve(statements.size());
+
+        for (const auto &statement : statements)
+        {
+            bool straight = dynamic_cast<const ExpressionStmt *>(statement.get()) ||
+                            dynamic_cast<const PrintStmt *>(statement.get()) ||
+                            dynamic_cast<const VariableStmt *>(statement.get());
+            if (straight)
+            {
+                run.push_back(statement);
+                // the interpreter carries on with the next top level statement after a runtime error,
+                // so a value computed by an earlier one may never have been stored
+                if (!top_level)
+                    continue;
+            }
+
+            eliminate_run(run);
+            result.insert(result.end(), run.begin(), run.end());
+            run.clear();
+            if (!straight)
+                result.push_back(eliminate_nested(statement));
+        }
+        eliminate_run(run);
+        result.insert(result.end(), run.begin(), run.end());
+        return result;
+    }
+
+    StmtPtr Interner::eliminate_nested(const StmtPtr &stmt)
+    {
+        if (stmt == nullptr)
+            return nullptr;
+        if (auto block = dynamic_cast<const BlockStmt *>(stmt.get()))
+            return make_BlockStmt(eliminate(block->statements, false));
+        if (auto if_stmt = dynamic_cast<const IfStmt *>(stmt.get()))
+            return make_IfStmt(if_stmt->condition, eliminate(std::vector<StmtPtr>{if_stmt->then_branch}, false)[0],
+                               if_stmt->else_branch ? eliminate(std::vector<StmtPtr>{if_stmt->else_branch}, false)[0]
+                                                    : nullptr);
+        if (auto while_stmt = dynamic_cast<const WhileStmt *>(stmt.get()))
+            return make_WhileStmt(while_stmt->condition, eliminate(std::vector<StmtPtr>{while_stmt->body}, false)[0]);
+        if (auto for_stmt = dynamic_cast<const ForStmt *>(stmt.get()))
+            return make_ForStmt(for_stmt->initializer, for_stmt->condition, for_stmt->increment,
+                                eliminate(std::vector<StmtPtr>{for_stmt->body}, false)[0]);
+        return stmt;
+    }
+
+    void Interner::eliminate_run(std::vector<StmtPtr> &run)
+    {
+        if (run.empty())
+            return;
+
+        versions.clear();
+        candidates.clear();
+        occurrences.clear();
+
+        // first walk, in evaluation order: find which occurrences can reuse an earlier value
+        occurrence = 0;
+        for (const auto &statement : run)
+        {
+            if (auto expression = dynamic_cast<const ExpressionStmt *>(statement.get()))
+                count(expression->expression, false);
+            else if (auto print = dynamic_cast<const PrintStmt *>(statement.get()))
+                count(print->expression, false);
+            else if (auto variable = dynamic_cast<const VariableStmt *>(statement.get()))
+            {
+                count(variable->initializer, false);
+                versions[variable->name.lexeme]++;
+            }
+        }
+
+        // number the temporaries in program order so the output is stable
+        std::vector<Candidate *> reused;
+        for (auto &[key, candidate] : candidates)
+        {
+            if (candidate.uses > 0)
+                reused.push_back(&candidate);
+        }
+        if (reused.empty())
+            return;
+        std::sort(reused.begin(), reused.end(),
+                  [](const Candidate *a, const Candidate *b) { return a->definition < b->definition; });
+        for (Candidate *candidate : reused)
+        {
+            candidate->temporary = "$cse" + std::to_string(temporaries.size());
+            temporaries.push_back(candidate->temporary);
+        }
+
+        // second walk visits the same occurrences in the same order and rewrites them
+        occurrence = 0;
+        for (auto &statement : run)
+        {
+            if (auto expression = dynamic_cast<const ExpressionStmt *>(statement.get()))
+                statement = make_ExpressionStmt(rewrite(expression->expression));
+            else if (auto print = dynamic_cast<const PrintStmt *>(statement.get()))
+                statement = make_PrintStmt(rewrite(print->expression));
+            else if (auto variable = dynamic_cast<const VariableStmt *>(statement.get()))
+                statement = make_VariableStmt(variable->name, rewrite(variable->initializer));
+        }
+    }
+
+    void Interner::count(const ExprPtr &expr, bool conditional, bool reusable)
+    {
+        if (expr == nullptr)
+            return;
+        const Expr *node = expr.get();
+
+        if (reusable && is_candidate(node))
+        {
+            size_t index = occurrence++;
+            std::string key = candidate_key(node);
+            auto it = candidates.find(key);
+            if (it != candidates.end() && it->second.unconditional)
+            {
+                it->second.uses++;
+                occurrences[index] = {key, true};
+                return; // replaced as a whole, nothing inside is evaluated any more
+            }
+            if (it == candidates.end() || !conditional)
+            {
+                candidates[key] = Candidate{index, !conditional, 0, std::string()};
+                occurrences[index] = {key, false};
+            }
+        }
+
+        if (auto binary = dynamic_cast<const Binary *>(node))
+        {
+            count(binary->left, conditional);
+            count(binary->right, conditional);
+        }
+        else if (auto logical = dynamic_cast<const Logical *>(node))
+        {
+            count(logical->left, conditional);
+            count(logical->right, true);
+        }
+        else if (auto ternary = dynamic_cast<const Ternary *>(node))
+        {
+            count(ternary->condition, conditional);
+            count(ternary->then_branch, true);
+            count(ternary->else_branch, true);
+        }
+        else if (auto unary = dynamic_cast<const Unary *>(node))
+            count(unary->right, conditional);
+        else if (auto grouping = dynamic_cast<const Grouping *>(node))
+            count(grouping->expression, conditional);
+        else if (auto assign = dynamic_cast<const Assign *>(node))
+        {
+            count(assign->value, conditional, !is_self_update(*assign));
+            versions[assign->name.lexeme]++; // also when it might not run, that only loses reuse
+        }
+    }
+
+    ExprPtr Interner::rewrite(const ExprPtr &expr, bool reusable)
+    {
+        if (expr == nullptr)
+            return nullptr;
+        const Expr *node = expr.get();
+
+        const Candidate *defined = nullptr;
+        if (reusable && is_candidate(node))
+        {
+            auto it = occurrences.find(occurrence++);
+            if (it != occurrences.end())
+            {
+                const Candidate &candidate = candidates.at(it->second.key);
+                if (it->second.use)
+                    return make_Variable(temporary_token(candidate.temporary));
+                if (candidate.uses > 0 && candidate.definition == it->first)
+                    defined = &candidate;
+            }
+        }
+
+        ExprPtr rewritten = expr;
+        if (auto binary = dynamic_cast<const Binary *>(node))
+        {
+            ExprPtr left = rewrite(binary->left);
+            ExprPtr right = rewrite(binary->right);
+            if (left != binary->left || right != binary->right)
+                rewritten = make_Binary(left, binary->operator_token, right);
+        }
+        else if (auto logical = dynamic_cast<const Logical *>(node))
+        {
+            ExprPtr left = rewrite(logical->left);
+            ExprPtr right = rewrite(logical->right);
+            if (left != logical->left || right != logical->right)
+                rewritten = make_Logical(left, logical->operator_token, right);
+        }
+        else if (auto ternary = dynamic_cast<const Ternary *>(node))
+        {
+            ExprPtr condition = rewrite(ternary->condition);
+            ExprPtr then_branch = rewrite(ternary->then_branch);
+            ExprPtr else_branch = rewrite(ternary->else_branch);
+            if (condition != ternary->condition || then_branch != ternary->then_branch ||
+                else_branch != ternary->else_branch)
+                rewritten = make_Ternary(condition, then_branch, else_branch);
+        }
+        else if (auto unary = dynamic_cast<const Unary *>(node))
+        {
+            ExprPtr right = rewrite(unary->right);
+            if (right != unary->right)
+                rewritten = make_Unary(unary->operator_token, right);
+        }
+        else if (auto grouping = dynamic_cast<const Grouping *>(node))
+        {
+            ExprPtr inner = rewrite(grouping->expression);
+            if (inner != grouping->expression)
+                rewritten = make_Grouping(inner);
+        }
+        else if (auto assign = dynamic_cast<const Assign *>(node))
+        {
+            ExprPtr value = rewrite(assign->value, !is_self_update(*assign));
+            if (value != assign->value)
+                rewritten = make_Assign(assign->name, value);
+        }
+
+        if (defined)
+            return make_Assign(temporary_token(defined->temporary), rewritten);
+        return rewritten;
+    }
+
+    // `i = i + 1` stays as written, the loop fast path recognizes counters by that shape
+    bool Interner::is_self_update(const Assign &assign)
+    {
+        const auto &names = variables_of(assign.value.get());
+        return std::binary_search(names.begin(), names.end(), assign.name.lexeme);
+    }
+
+    // worth a temporary: an operation without side effects that can never produce nil
+    // (only a nil literal can, reading an uninitialized variable is an error)
+    bool Interner::is_candidate(const Expr *expr)
+    {
+        auto it = candidates_memo.find(expr);
+        if (it != candidates_memo.end())
+            return it->second;
+
+        // pure: no Assign and no nil literal anywhere below
+        std::function<bool(const Expr *)> pure = [&](const Expr *node) -> bool
+        {
+            if (auto literal = dynamic_cast<const Literal *>(node))
+                return !std::holds_alternative<std::monostate>(literal->value);
+            if (dynamic_cast<const Variable *>(node))
+                return true;
+            if (auto binary = dynamic_cast<const Binary *>(node))
+                return pure(binary->left.get()) && pure(binary->right.get());
+            if (auto logical = dynamic_cast<const Logical *>(node))
+                return pure(logical->left.get()) && pure(logical->right.get());
+            if (auto ternary = dynamic_cast<const Ternary *>(node))
+                return pure(ternary->condition.get()) && pure(ternary->then_branch.get()) &&
+                       pure(ternary->else_branch.get());
+            if (auto unary = dynamic_cast<const Unary *>(node))
+                return pure(unary->right.get());
+            if (auto grouping = dynamic_cast<const Grouping *>(node))
+                return pure(grouping->expression.get());
+            return false;
+        };
+
+        bool operation = dynamic_cast<const Binary *>(expr) || dynamic_cast<const Logical *>(expr) ||
+                         dynamic_cast<const Ternary *>(expr) || dynamic_cast<const Unary *>(expr);
+        bool candidate = operation && pure(expr);
+        candidates_memo[expr] = candidate;
+        return candidate;
+    }
+
+    size_t Interner::value_number(const Expr *expr)
+    {
+        auto it = node_numbers.find(expr);
+        if (it != node_numbers.end())
+            return it->second;
+
+        std::string key;
+        auto child = [&](const ExprPtr &node)
+        { key += "," + std::to_string(value_number(node.get())); };
+
+        if (auto literal = dynamic_cast<const Literal *>(expr))
+            key = "L" + literal_detail(literal->value);
+        else if (auto variable = dynamic_cast<const Variable *>(expr))
+            key = "V" + variable->name.lexeme;
+        else if (auto binary = dynamic_cast<const Binary *>(expr))
+        {
+            key = "B" + token_detail(binary->operator_token);
+            child(binary->left);
+            child(binary->right);
+        }
+        else if (auto logical = dynamic_cast<const Logical *>(expr))
+        {
+            key = "O" + token_detail(logical->operator_token);
+            child(logical->left);
+            child(logical->right);
+        }
+        else if (auto ternary = dynamic_cast<const Ternary *>(expr))
+        {
+            key = "T";
+            child(ternary->condition);
+            child(ternary->then_branch);
+            child(ternary->else_branch);
+        }
+        else if (auto unary = dynamic_cast<const Unary *>(expr))
+        {
+            key = "U" + token_detail(unary->operator_token);
+            child(unary->right);
+        }
+        else if (auto grouping = dynamic_cast<const Grouping *>(expr))
+        {
+            key = "G";
+            child(grouping->expression);
+        }
+
+        size_t number = value_numbers.try_emplace(key, value_numbers.size()).first->second;
+        node_numbers[expr] = number;
+        return number;
+    }
+
+    const std::vector<std::string> &Interner::variables_of(const Expr *expr)
+    {
+        auto it = free_variables.find(expr);
+        if (it != free_variables.end())
+            return it->second;
+
+        std::vector<std::string> names;
+        std::function<void(const Expr *)> collect = [&](const Expr *node)
+        {
+            if (auto variable = dynamic_cast<const Variable *>(node))
+                names.push_back(variable->name.lexeme);
+            else if (auto binary = dynamic_cast<const Binary *>(node))
+            {
+                collect(binary->left.get());
+                collect(binary->right.get());
+            }
+            else if (auto logical = dynamic_cast<const Logical *>(node))
+            {
+                collect(logical->left.get());
+                collect(logical->right.get());
+            }
+            else if (auto ternary = dynamic_cast<const Ternary *>(node))
+            {
+                collect(ternary->condition.get());
+                collect(ternary->then_branch.get());
+                collect(ternary->else_branch.get());
+            }
+            else if (auto unary = dynamic_cast<const Unary *>(node))
+                collect(unary->right.get());
+            else if (auto grouping = dynamic_cast<const Grouping *>(node))
+                collect(grouping->expression.get());
+        };
+        collect(expr);
+
+        std::sort(names.begin(), names.end());
+        names.erase(std::unique(names.begin(), names.end()), names.end());
+        return free_variables[expr] = std::move(names);
+    }
+
+    // same value number and every variable it reads still holds the same assignment
+    std::string Interner::candidate_key(const Expr *expr)
+    {
+        std::string key = std::to_string(value_number(expr));
+        for (const auto &name : variables_of(expr))
+        {
+            auto it = versions.find(name);
+            key += ";" + name + "=" + std::to_string(it == versions.end() ? 0 : it->second);
+        }
+        return key;
+    }
+
+    // Hash-consing
+
+    ExprPtr Interner::canonical(const ExprPtr &node, std::string detail, const Expr *a, const Expr *b, const Expr *c)
+    {
+        NodeKey key{std::move(detail), {a, b, c}};
+        return nodes.try_emplace(std::move(key), node).first->second;
+    }
+
+    ExprPtr Interner::intern(const ExprPtr &expr)
+    {
+        if (expr == nullptr)
+            return nullptr;
+
+        auto memo = interned.find(expr.get());
+        if (memo != interned.end())
+            return memo->second;
+
+        ExprPtr result;
+        if (auto literal = dynamic_cast<const Literal *>(expr.get()))
+            result = canonical(expr, "L" + literal_detail(literal->value));
+        else if (auto variable = dynamic_cast<const Variable *>(expr.get()))
+            result = canonical(expr, with_line("V" + variable->name.lexeme, variable->name));
+        else if (auto binary = dynamic_cast<const Binary *>(expr.get()))
+        {
+            ExprPtr left = intern(binary->left);
+            ExprPtr right = intern(binary->right);
+            ExprPtr node = left == binary->left && right == binary->right
+                               ? expr
+                               : make_Binary(left, binary->operator_token, right);
+            result = canonical(node, with_line("B" + token_detail(binary->operator_token), binary->operator_token),
+                               left.get(), right.get());
+        }
+        else if (auto logical = dynamic_cast<const Logical *>(expr.get()))
+        {
+            ExprPtr left = intern(logical->left);
+            ExprPtr right = intern(logical->right);
+            ExprPtr node = left == logical->left && right == logical->right
+                               ? expr
+                               : make_Logical(left, logical->operator_token, right);
+            result = canonical(node, with_line("O" + token_detail(logical->operator_token), logical->operator_token),
+                               left.get(), right.get());
+        }
+        else if (auto ternary = dynamic_cast<const Ternary *>(expr.get()))
+        {
+            ExprPtr condition = intern(ternary->condition);
+            ExprPtr then_branch = intern(ternary->then_branch);
+            ExprPtr else_branch = intern(ternary->else_branch);
+            ExprPtr node = condition == ternary->condition && then_branch == ternary->then_branch &&
+                                   else_branch == ternary->else_branch
+                               ? expr
+                               : make_Ternary(condition, then_branch, else_branch);
+            result = canonical(node, "T", condition.get(), then_branch.get(), else_branch.get());
+        }
+        else if (auto unary = dynamic_cast<const Unary *>(expr.get()))
+        {
+            ExprPtr right = intern(unary->right);
+            ExprPtr node = right == unary->right ? expr : make_Unary(unary->operator_token, right);
+            result = canonical(node, with_line("U" + token_detail(unary->operator_token), unary->operator_token),
+                               right.get());
+        }
+        else if (auto grouping = dynamic_cast<const Grouping *>(expr.get()))
+        {
+            ExprPtr inner = intern(grouping->expression);
+            ExprPtr node = inner == grouping->expression ? expr : make_Grouping(inner);
+            result = canonical(node, "G", inner.get());
+        }
+        else if (auto assign = dynamic_cast<const Assign *>(expr.get()))
+        {
+            // has a side effect, never shared, but its value can be
+            ExprPtr value = intern(assign->value);
+            result = value == assign->value ? expr : make_Assign(assign->name, value);
+        }
+        else
+            result = expr;
+
+        interned[expr.get()] = result;
+        return result;
+    }
+
+    StmtPtr Interner::intern(const StmtPtr &stmt)
+    {
+        if (stmt == nullptr)
+            return nullptr;
+        if (auto expression = dynamic_cast<const ExpressionStmt *>(stmt.get()))
+            return make_ExpressionStmt(intern(expression->expression));
+        if (auto print = dynamic_cast<const PrintStmt *>(stmt.get()))
+            return make_PrintStmt(intern(print->expression));
+        if (auto variable = dynamic_cast<const VariableStmt *>(stmt.get()))
+            return make_VariableStmt(variable->name, intern(variable->initializer));
+        if (auto block = dynamic_cast<const BlockStmt *>(stmt.get()))
+        {
+            std::vector<StmtPtr> statements;
+            statements.reserve(block->statements.size());
+            for (const auto &statement : block->statements)
+                statements.push_back(intern(statement));
+            return make_BlockStmt(std::move(statements));
+        }
+        if (auto if_stmt = dynamic_cast<const IfStmt *>(stmt.get()))
+            return make_IfStmt(intern(if_stmt->condition), intern(if_stmt->then_branch), intern(if_stmt->else_branch));
+        if (auto while_stmt = dynamic_cast<const WhileStmt *>(stmt.get()))
+            return make_WhileStmt(intern(while_stmt->condition), intern(while_stmt->body));
+        if (auto for_stmt = dynamic_cast<const ForStmt *>(stmt.get()))
+            return make_ForStmt(intern(for_stmt->initializer), intern(for_stmt->condition),
+                                intern(for_stmt->increment), intern(for_stmt->body));
+        return stmt;
+    }
+
+    void Interner::count_nodes(const Expr *expr, std::unordered_set<const Expr *> &seen)
+    {
+        if (expr == nullptr || !seen.insert(expr).second)
+            return;
+        if (auto binary = dynamic_cast<const Binary *>(expr))
+        {
+            count_nodes(binary->left.get(), seen);
+            count_nodes(binary->right.get(), seen);
+        }
+        else if (auto logical = dynamic_cast<const Logical *>(expr))
+        {
+            count_nodes(logical->left.get(), seen);
+            count_nodes(logical->right.get(), seen);
+        }
+        else if (auto ternary = dynamic_cast<const Ternary *>(expr))
+        {
+            count_nodes(ternary->condition.get(), seen);
+            count_nodes(ternary->then_branch.get(), seen);
+            count_nodes(ternary->else_branch.get(), seen);
+        }
+        else if (auto unary = dynamic_cast<const Unary *>(expr))
+            count_nodes(unary->right.get(), seen);
+        else if (auto grouping = dynamic_cast<const Grouping *>(expr))
+            count_nodes(grouping->expression.get(), seen);
+        else if (auto assign = dynamic_cast<const Assign *>(expr))
+            count_nodes(assign->value.get(), seen);
+    }
+
+    void Interner::count_nodes(const Stmt *stmt, std::unordered_set<const Expr *> &seen)
+    {
+        if (stmt == nullptr)
+            return;
+        if (auto expression = dynamic_cast<const ExpressionStmt *>(stmt))
+            count_nodes(expression->expression.get(), seen);
+        else if (auto print = dynamic_cast<const PrintStmt *>(stmt))
+            count_nodes(print->expression.get(), seen);
+        else if (auto variable = dynamic_cast<const VariableStmt *>(stmt))
+            count_nodes(variable->initializer.get(), seen);
+        else if (auto block = dynamic_cast<const BlockStmt *>(stmt))
+        {
+            for (const auto &statement : block->statements)
+                count_nodes(statement.get(), seen);
+        }
+        else if (auto if_stmt = dynamic_cast<const IfStmt *>(stmt))
+        {
+            count_nodes(if_stmt->condition.get(), seen);
+            count_nodes(if_stmt->then_branch.get(), seen);
+            count_nodes(if_stmt->else_branch.get(), seen);
+        }
+        else if (auto while_stmt = dynamic_cast<const WhileStmt *>(stmt))
+        {
+            count_nodes(while_stmt->condition.get(), seen);
+            count_nodes(while_stmt->body.get(), seen);
+        }
+        else if (auto for_stmt = dynamic_cast<const ForStmt *>(stmt))
+        {
+            count_nodes(for_stmt->initializer.get(), seen);
+            count_nodes(for_stmt->condition.get(), seen);
+            count_nodes(for_stmt->increment.get(), seen);
+            count_nodes(for_stmt->body.get(), seen);
+        }
+    }
+}
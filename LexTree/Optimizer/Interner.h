@@ -0,0 +1,103 @@
+#pragma once
+
+#include "../Parser/Expr.h"
+#include "../Parser/Stmt.h"
+#include "InternStats.h"
+#include <cstddef>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace lex
+{
+    /*
+     * Optional pass (`--intern`) for generated scripts that repeat the same expressions over and over.
+     *
+     * Common subexpressions: inside a run of straight-line statements (print/var/expression statements of one
+     * block), a pure expression evaluated again while none of its variables were assigned is computed once.
+     * The first occurrence becomes `$cseN = <expr>` (evaluated in place, so order and errors are unchanged)
+     * and the later ones read `$cseN`. The temporaries are declared at the start of the program.
+     *
+     * Hash-consing: afterwards structurally identical pure expressions are merged into one shared node.
+     * Tokens are compared with their line so a shared node still reports runtime errors on the right line.
+     */
+    class Interner
+    {
+    public:
+        using Stats = InternStats;
+
+        std::vector<StmtPtr> intern(const std::vector<StmtPtr> &statements);
+        const Stats &stats() const { return statistics; }
+
+    private:
+        // a node is identified by its kind, its token/literal and its (already interned) children
+        struct NodeKey
+        {
+            std::string detail;
+            const Expr *children[3];
+
+            bool operator==(const NodeKey &other) const;
+        };
+
+        struct NodeKeyHash
+        {
+            size_t operator()(const NodeKey &key) const;
+        };
+
+        struct Candidate
+        {
+            size_t definition;        // occurrence index of the first evaluation
+            bool unconditional;       // a Ternary branch or the right side of and/or may never run
+            size_t uses = 0;
+            std::string temporary;
+        };
+
+        struct Occurrence
+        {
+            std::string key;
+            bool use;
+        };
+
+        Stats statistics;
+
+        // hash-consing
+        std::unordered_map<NodeKey, ExprPtr, NodeKeyHash> nodes;
+        std::unordered_map<const Expr *, ExprPtr> interned;
+
+        // value numbers ignore lines, evaluating the same pure expression twice gives the same value anywhere
+        std::unordered_map<std::string, size_t> value_numbers;
+        std::unordered_map<const Expr *, size_t> node_numbers;
+        std::unordered_map<const Expr *, bool> candidates_memo;
+        std::unordered_map<const Expr *, std::vector<std::string>> free_variables;
+
+        // state of the straight-line run being processed
+        std::map<std::string, int> versions;
+        std::unordered_map<std::string, Candidate> candidates;
+        std::unordered_map<size_t, Occurrence> occurrences;
+        size_t occurrence = 0;
+        std::vector<std::string> temporaries;
+
+        // common subexpressions
+        std::vector<StmtPtr> eliminate(const std::vector<StmtPtr> &statements, bool top_level);
+        void eliminate_run(std::vector<StmtPtr> &run);
+        StmtPtr eliminate_nested(const StmtPtr &stmt);
+        void count(const ExprPtr &expr, bool conditional, bool reusable = true);
+        ExprPtr rewrite(const ExprPtr &expr, bool reusable = true);
+        bool is_self_update(const Assign &assign);
+        bool is_candidate(const Expr *expr);
+        size_t value_number(const Expr *expr);
+        const std::vector<std::string> &variables_of(const Expr *expr);
+        std::string candidate_key(const Expr *expr);
+
+        // hash-consing
+        ExprPtr intern(const ExprPtr &expr);
+        StmtPtr intern(const StmtPtr &stmt);
+        ExprPtr canonical(const ExprPtr &node, std::string detail, const Expr *a = nullptr, const Expr *b = nullptr,
+                          const Expr *c = nullptr);
+
+        static void count_nodes(const Expr *expr, std::unordered_set<const Expr *> &seen);
+        static void count_nodes(const Stmt *stmt, std::unordered_set<const Expr *> &seen);
+    };
+}
@@ -0,0 +1,338 @@
+#include "LoopAnalysis.h"
+#include <set>
+
+namespace lex
+{
+    namespace
+    {
+        const Expr *unwrap_grouping(const Expr *expr)
+        {
+            while (auto grouping = dynamic_cast<const Grouping *>(expr))
+                expr = grouping->expression.get();
+            return expr;
+        }
+
+        // every name the loop body assigns or declares, a declaration could shadow or redefine a name
+        void collect_writes(const Expr *expr, std::set<std::string> &writes)
+        {
+            if (expr == nullptr)
+                return;
+            if (auto assign = dynamic_cast<const Assign *>(expr))
+            {
+                writes.insert(assign->name.lexeme);
+                collect_writes(assign->value.get(), writes);
+            }
+            else if (auto binary = dynamic_cast<const Binary *>(expr))
+            {
+                collect_writes(binary->left.get(), writes);
+                collect_writes(binary->right.get(), writes);
+            }
+            else if (auto logical = dynamic_cast<const Logical *>(expr))
+            {
+                collect_writes(logical->left.get(), writes);
+                collect_writes(logical->right.get(), writes);
+            }
+            else if (auto grouping = dynamic_cast<const Grouping *>(expr))
+                collect_writes(grouping->expression.get(), writes);
+            else if (auto unary = dynamic_cast<const Unary *>(expr))
+                collect_writes(unary->right.get(), writes);
+            else if (auto ternary = dynamic_cast<const Ternary *>(expr))
+            {
+                collect_writes(ternary->condition.get(), writes);
+                collect_writes(ternary->then_branch.get(), writes);
+                collect_writes(ternary->else_branch.get(), writes);
+            }
+        }
+
+        void collect_writes(const Stmt *stmt, std::set<std::string> &writes)
+        {
+            if (stmt == nullptr)
+                return;
+            if (auto expression = dynamic_cast<const ExpressionStmt *>(stmt))
+                collect_writes(expression->expression.get(), writes);
+            else if (auto print = dynamic_cast<const PrintStmt *>(stmt))
+                collect_writes(print->expression.get(), writes);
+            else if (auto variable = dynamic_cast<const VariableStmt *>(stmt))
+            {
+                writes.insert(variable->name.lexeme);
+                collect_writes(variable->initializer.get(), writes);
+            }
+            else if (auto block = dynamic_cast<const BlockStmt *>(stmt))
+            {
+                for (const auto &statement : block->statements)
+                    collect_writes(statement.get(), writes);
+            }
+            else if (auto if_stmt = dynamic_cast<const IfStmt *>(stmt))
+            {
+                collect_writes(if_stmt->condition.get(), writes);
+                collect_writes(if_stmt->then_branch.get(), writes);
+                collect_writes(if_stmt->else_branch.get(), writes);
+            }
+            else if (auto while_stmt = dynamic_cast<const WhileStmt *>(stmt))
+            {
+                collect_writes(while_stmt->condition.get(), writes);
+                collect_writes(while_stmt->body.get(), writes);
+            }
+            else if (auto for_stmt = dynamic_cast<const ForStmt *>(stmt))
+            {
+                collect_writes(for_stmt->initializer.get(), writes);
+                collect_writes(for_stmt->condition.get(), writes);
+                collect_writes(for_stmt->increment.get(), writes);
+                collect_writes(for_stmt->body.get(), writes);
+            }
+        }
+
+        // pure and only reads variables the loop never writes
+        bool is_invariant(const Expr *expr, const std::set<std::string> &writes)
+        {
+            if (expr == nullptr)
+                return true;
+            if (dynamic_cast<const Literal *>(expr))
+                return true;
+            if (auto variable = dynamic_cast<const Variable *>(expr))
+                return writes.count(variable->name.lexeme) == 0;
+            if (auto binary = dynamic_cast<const Binary *>(expr))
+                return is_invariant(binary->left.get(), writes) && is_invariant(binary->right.get(), writes);
+            if (auto logical = dynamic_cast<const Logical *>(expr))
+                return is_invariant(logical->left.get(), writes) && is_invariant(logical->right.get(), writes);
+            if (auto grouping = dynamic_cast<const Grouping *>(expr))
+                return is_invariant(grouping->expression.get(), writes);
+            if (auto unary = dynamic_cast<const Unary *>(expr))
+                return is_invariant(unary->right.get(), writes);
+            if (auto ternary = dynamic_cast<const Ternary *>(expr))
+                return is_invariant(ternary->condition.get(), writes) && is_invariant(ternary->then_branch.get(), writes) &&
+                       is_invariant(ternary->else_branch.get(), writes);
+            return false; // Assign
+        }
+
+        // hoisting a bare literal or variable read gains nothing
+        bool is_trivial(const Expr *expr)
+        {
+            expr = unwrap_grouping(expr);
+            return dynamic_cast<const Literal *>(expr) || dynamic_cast<const Variable *>(expr);
+        }
+
+        void collect_invariants(const ExprPtr &expr, const std::set<std::string> &writes, std::vector<ExprPtr> &invariants)
+        {
+            if (expr == nullptr || is_trivial(expr.get()))
+                return;
+            if (is_invariant(expr.get(), writes))
+            {
+                invariants.push_back(expr);
+                return;
+            }
+
+            if (auto assign = dynamic_cast<const Assign *>(expr.get()))
+                collect_invariants(assign->value, writes, invariants);
+            else if (auto binary = dynamic_cast<const Binary *>(expr.get()))
+            {
+                collect_invariants(binary->left, writes, invariants);
+                collect_invariants(binary->right, writes, invariants);
+            }
+            else if (auto logical = dynamic_cast<const Logical *>(expr.get()))
+            {
+                collect_invariants(logical->left, writes, invariants);
+                collect_invariants(logical->right, writes, invariants);
+            }
+            else if (auto grouping = dynamic_cast<const Grouping *>(expr.get()))
+                collect_invariants(grouping->expression, writes, invariants);
+            else if (auto unary = dynamic_cast<const Unary *>(expr.get()))
+                collect_invariants(unary->right, writes, invariants);
+            else if (auto ternary = dynamic_cast<const Ternary *>(expr.get()))
+            {
+                collect_invariants(ternary->condition, writes, invariants);
+                collect_invariants(ternary->then_branch, writes, invariants);
+                collect_invariants(ternary->else_branch, writes, invariants);
+            }
+        }
+
+        void collect_invariants(const StmtPtr &stmt, const std::set<std::string> &writes, std::vector<ExprPtr> &invariants)
+        {
+            if (stmt == nullptr)
+                return;
+            if (auto expression = dynamic_cast<const ExpressionStmt *>(stmt.get()))
+                collect_invariants(expression->expression, writes, invariants);
+            else if (auto print = dynamic_cast<const PrintStmt *>(stmt.get()))
+                collect_invariants(print->expression, writes, invariants);
+            else if (auto variable = dynamic_cast<const VariableStmt *>(stmt.get()))
+                collect_invariants(variable->initializer, writes, invariants);
+            else if (auto block = dynamic_cast<const BlockStmt *>(stmt.get()))
+            {
+                for (const auto &statement : block->statements)
+                    collect_invariants(statement, writes, invariants);
+            }
+            else if (auto if_stmt = dynamic_cast<const IfStmt *>(stmt.get()))
+            {
+                collect_invariants(if_stmt->condition, writes, invariants);
+                collect_invariants(if_stmt->then_branch, writes, invariants);
+                collect_invariants(if_stmt->else_branch, writes, invariants);
+            }
+            else if (auto while_stmt = dynamic_cast<const WhileStmt *>(stmt.get()))
+            {
+                collect_invariants(while_stmt->condition, writes, invariants);
+                collect_invariants(while_stmt->body, writes, invariants);
+            }
+            else if (auto for_stmt = dynamic_cast<const ForStmt *>(stmt.get()))
+            {
+                collect_invariants(for_stmt->initializer, writes, invariants);
+                collect_invariants(for_stmt->condition, writes, invariants);
+                collect_invariants(for_stmt->increment, writes, invariants);
+                collect_invariants(for_stmt->body, writes, invariants);
+            }
+        }
+
+        TokenType flip(TokenType comparison)
+        {
+            switch (comparison)
+            {
+            case TokenType::LESS:
+                return TokenType::GREATER;
+            case TokenType::LESS_EQUAL:
+                return TokenType::GREATER_EQUAL;
+            case TokenType::GREATER:
+                return TokenType::LESS;
+            default:
+                return TokenType::LESS_EQUAL;
+            }
+        }
+
+        // `i < bound` or `bound > i`
+        bool match_condition(const ExprPtr &condition, CountedLoop &loop)
+        {
+            auto binary = dynamic_cast<const Binary *>(unwrap_grouping(condition.get()));
+            if (binary == nullptr)
+                return false;
+
+            TokenType type = binary->operator_token.type;
+            if (type != TokenType::LESS && type != TokenType::LESS_EQUAL && type != TokenType::GREATER &&
+                type != TokenType::GREATER_EQUAL)
+                return false;
+
+            if (auto variable = dynamic_cast<const Variable *>(unwrap_grouping(binary->left.get())))
+            {
+                loop.counter = variable->name.lexeme;
+                loop.comparison = type;
+                loop.bound = binary->right;
+                return true;
+            }
+            if (auto variable = dynamic_cast<const Variable *>(unwrap_grouping(binary->right.get())))
+            {
+                loop.counter = variable->name.lexeme;
+                loop.comparison = flip(type);
+                loop.bound = binary->left;
+                return true;
+            }
+            return false;
+        }
+
+        // `i = i + step`, `i = step + i` or `i = i - step` with a number literal step
+        bool match_increment(const Expr *expr, CountedLoop &loop)
+        {
+            auto assign = dynamic_cast<const Assign *>(unwrap_grouping(expr));
+            if (assign == nullptr || assign->name.lexeme != loop.counter)
+                return false;
+
+            auto binary = dynamic_cast<const Binary *>(unwrap_grouping(assign->value.get()));
+            if (binary == nullptr)
+                return false;
+
+            TokenType type = binary->operator_token.type;
+            if (type != TokenType::PLUS && type != TokenType::MINUS)
+                return false;
+
+            auto is_counter = [&](const ExprPtr &operand)
+            {
+                auto variable = dynamic_cast<const Variable *>(unwrap_grouping(operand.get()));
+                return variable != nullptr && variable->name.lexeme == loop.counter;
+            };
+            auto number = [](const ExprPtr &operand) -> const double *
+            {
+                auto literal = dynamic_cast<const Literal *>(unwrap_grouping(operand.get()));
+                return literal ? std::get_if<double>(&literal->value) : nullptr;
+            };
+
+            const double *step = nullptr;
+            if (is_counter(binary->left))
+                step = number(binary->right);
+            else if (type == TokenType::PLUS && is_counter(binary->right))
+                step = number(binary->left);
+
+            if (step == nullptr || *step == 0.0)
+                return false;
+            loop.step = type == TokenType::PLUS ? *step : -*step;
+            return true;
+        }
+
+        bool declares_variables(const std::vector<StmtPtr> &statements)
+        {
+            for (const auto &statement : statements)
+            {
+                if (dynamic_cast<const VariableStmt *>(statement.get()))
+                    return true;
+                auto for_stmt = dynamic_cast<const ForStmt *>(statement.get());
+                if (for_stmt && dynamic_cast<const VariableStmt *>(for_stmt->initializer.get()))
+                    return true;
+            }
+            return false;
+        }
+
+        // shared tail of both loop kinds, `loop.body` already holds the per-iteration statements
+        std::optional<CountedLoop> finish(CountedLoop loop)
+        {
+            std::set<std::string> writes;
+            for (const auto &statement : loop.body)
+                collect_writes(statement.get(), writes);
+
+            if (writes.count(loop.counter) > 0)
+                return std::nullopt;
+
+            // the counter changes every iteration, anything reading it is not invariant
+            writes.insert(loop.counter);
+            if (!is_invariant(loop.bound.get(), writes))
+                return std::nullopt;
+
+            for (const auto &statement : loop.body)
+                collect_invariants(statement, writes, loop.invariants);
+            return loop;
+        }
+    }
+
+    std::optional<CountedLoop> analyze_counted_loop(const WhileStmt &stmt)
+    {
+        CountedLoop loop;
+        if (!match_condition(stmt.condition, loop))
+            return std::nullopt;
+
+        // the increment has to be the last statement of a block body
+        auto block = dynamic_cast<const BlockStmt *>(stmt.body.get());
+        if (block == nullptr || block->statements.empty())
+            return std::nullopt;
+        auto increment = dynamic_cast<const ExpressionStmt *>(block->statements.back().get());
+        if (increment == nullptr || !match_increment(increment->expression.get(), loop))
+            return std::nullopt;
+
+        loop.body.assign(block->statements.begin(), block->statements.end() - 1);
+        loop.needs_scope = declares_variables(loop.body);
+        return finish(std::move(loop));
+    }
+
+    std::optional<CountedLoop> analyze_counted_loop(const ForStmt &stmt)
+    {
+        CountedLoop loop;
+        if (stmt.condition == nullptr || stmt.increment == nullptr || !match_condition(stmt.condition, loop))
+            return std::nullopt;
+        if (!match_increment(stmt.increment.get(), loop))
+            return std::nullopt;
+
+        if (auto block = dynamic_cast<const BlockStmt *>(stmt.body.get()))
+        {
+            loop.body = block->statements;
+            loop.needs_scope = declares_variables(loop.body);
+        }
+        else
+        {
+            loop.body.push_back(stmt.body);
+        }
+        return finish(std::move(loop));
+    }
+}
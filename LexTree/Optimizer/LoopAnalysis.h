@@ -0,0 +1,32 @@
+#pragma once
+
+#include "../Parser/Expr.h"
+#include "../Parser/Stmt.h"
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace lex
+{
+    /*
+     * A loop of the shape
+     *     while (i < bound) { ...; i = i + step; }
+     *     for (...; i < bound; i = i + step) ...
+     * where the body never writes `i` or any variable of `bound`, and `step` is a number literal.
+     * The Interpreter runs these with the counter kept in a plain double instead of re-evaluating
+     * the condition and increment ASTs on every iteration.
+     */
+    struct CountedLoop
+    {
+        std::string counter;        // induction variable
+        TokenType comparison;       // counter <comparison> bound, normalized so the counter is on the left
+        ExprPtr bound;              // loop-invariant, evaluated once on entry
+        double step = 0;            // signed increment per iteration
+        std::vector<StmtPtr> body;  // statements of one iteration, without the increment
+        bool needs_scope = false;   // the body is a block declaring variables, every iteration needs a fresh Environment
+        std::vector<ExprPtr> invariants; // maximal loop-invariant subexpressions of the body (hoisting candidates)
+    };
+
+    std::optional<CountedLoop> analyze_counted_loop(const WhileStmt &stmt);
+    std::optional<CountedLoop> analyze_counted_loop(const ForStmt &stmt);
+}
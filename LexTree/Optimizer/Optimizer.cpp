@@ -0,0 +1,344 @@
+#include "Optimizer.h"
+#include "../Interpreter/Value.h"
+#include <optional>
+
+namespace lex
+{
+    namespace
+    {
+        Value literal_to_value(const LiteralValue &literal)
+        {
+            if (std::holds_alternative<double>(literal))
+                return Value(std::get<double>(literal));
+            if (std::holds_alternative<std::string>(literal))
+                return Value(std::get<std::string>(literal));
+            if (std::holds_alternative<bool>(literal))
+                return Value(std::get<bool>(literal));
+            return Value(std::monostate{});
+        }
+
+        ExprPtr make_value_literal(const Value &value, int line)
+        {
+            if (std::holds_alternative<double>(value))
+                return make_Literal(std::get<double>(value), line);
+            if (std::holds_alternative<std::string>(value))
+                return make_Literal(std::get<std::string>(value), line);
+            if (std::holds_alternative<bool>(value))
+                return make_Literal(std::get<bool>(value), line);
+            return make_Literal(std::monostate{}, line);
+        }
+
+        const Literal *as_literal(const ExprPtr &expr)
+        {
+            return dynamic_cast<const Literal *>(expr.get());
+        }
+
+        // same rules as Interpreter::visitBinaryExpr, empty when the operation would raise a runtime error
+        std::optional<Value> fold_binary(TokenType type, const Value &left, const Value &right)
+        {
+            bool numbers = std::holds_alternative<double>(left) && std::holds_alternative<double>(right);
+
+            switch (type)
+            {
+            case TokenType::MINUS:
+                if (numbers)
+                    return Value(std::get<double>(left) - std::get<double>(right));
+                break;
+            case TokenType::STAR:
+                if (numbers)
+                    return Value(std::get<double>(left) * std::get<double>(right));
+                break;
+            case TokenType::SLASH:
+                if (numbers && std::get<double>(right) != 0.0)
+                    return Value(std::get<double>(left) / std::get<double>(right));
+                break;
+            case TokenType::PLUS:
+                if (numbers)
+                    return Value(std::get<double>(left) + std::get<double>(right));
+                if (std::holds_alternative<std::string>(left))
+                    return Value(std::get<std::string>(left) + value_to_string(right));
+                if (std::holds_alternative<std::string>(right))
+                    return Value(value_to_string(left) + std::get<std::string>(right));
+                break;
+            case TokenType::GREATER:
+                if (numbers)
+                    return Value(std::get<double>(left) > std::get<double>(right));
+                break;
+            case TokenType::GREATER_EQUAL:
+                if (numbers)
+                    return Value(std::get<double>(left) >= std::get<double>(right));
+                break;
+            case TokenType::LESS:
+                if (numbers)
+                    return Value(std::get<double>(left) < std::get<double>(right));
+                break;
+            case TokenType::LESS_EQUAL:
+                if (numbers)
+                    return Value(std::get<double>(left) <= std::get<double>(right));
+                break;
+            case TokenType::BANG_EQUAL:
+                return Value(!values_equal(left, right));
+            case TokenType::EQUAL_EQUAL:
+                return Value(values_equal(left, right));
+            default:
+                break;
+            }
+            return std::nullopt;
+        }
+    }
+
+    std::vector<StmtPtr> Optimizer::optimize(const std::vector<StmtPtr> &statements)
+    {
+        std::vector<StmtPtr> optimized;
+        optimized.reserve(statements.size());
+        for (const auto &statement : statements)
+        {
+            if (StmtPtr stmt = optimize(statement))
+                optimized.push_back(std::move(stmt));
+        }
+        return optimized;
+    }
+
+    void Optimizer::substitute(std::unordered_map<const Expr *, ExprPtr> replacements)
+    {
+        substitutions = std::move(replacements);
+    }
+
+    ExprPtr Optimizer::optimize(const ExprPtr &expr)
+    {
+        if (expr == nullptr)
+            return nullptr;
+
+        if (!substitutions.empty())
+        {
+            auto it = substitutions.find(expr.get());
+            if (it != substitutions.end())
+                return it->second;
+        }
+
+        ExprPtr saved = current_expr;
+        current_expr = expr;
+        ExprPtr optimized = std::any_cast<ExprPtr>(expr->accept(this));
+        current_expr = saved;
+        return optimized;
+    }
+
+    StmtPtr Optimizer::optimize(const StmtPtr &stmt)
+    {
+        if (stmt == nullptr)
+            return nullptr;
+
+        StmtPtr saved = current_stmt;
+        current_stmt = stmt;
+        stmt->accept(this);
+        current_stmt = saved;
+        return std::move(result);
+    }
+
+    StmtPtr Optimizer::optimize_body(const StmtPtr &stmt)
+    {
+        StmtPtr optimized = optimize(stmt);
+        return optimized ? optimized : make_BlockStmt({});
+    }
+
+    // Statements
+
+    void Optimizer::visitExpressionStmt(ExpressionStmt *stmt)
+    {
+        ExprPtr expression = optimize(stmt->expression);
+        if (as_literal(expression))
+            result = nullptr; // evaluating a literal does nothing
+        else
+            result = expression == stmt->expression ? current_stmt : make_ExpressionStmt(expression);
+    }
+
+    void Optimizer::visitPrintStmt(PrintStmt *stmt)
+    {
+        ExprPtr expression = optimize(stmt->expression);
+        result = expression == stmt->expression ? current_stmt : make_PrintStmt(expression);
+    }
+
+    void Optimizer::visitVariableStmt(VariableStmt *stmt)
+    {
+        ExprPtr initializer = optimize(stmt->initializer);
+        result = initializer == stmt->initializer ? current_stmt : make_VariableStmt(stmt->name, initializer);
+    }
+
+    void Optimizer::visitBlockStmt(BlockStmt *stmt)
+    {
+        StmtPtr self = current_stmt;
+        std::vector<StmtPtr> statements = optimize(stmt->statements);
+
+        if (statements.empty())
+            result = nullptr;
+        else if (statements == stmt->statements)
+            result = self;
+        else
+            result = make_BlockStmt(std::move(statements));
+    }
+
+    void Optimizer::visitIfStmt(IfStmt *stmt)
+    {
+        StmtPtr self = current_stmt;
+        ExprPtr condition = optimize(stmt->condition);
+
+        if (const Literal *literal = as_literal(condition))
+        {
+            // the branch replaces the whole if, it is always a statement (or block) so scoping is unchanged
+            result = is_truthy(literal_to_value(literal->value)) ? optimize(stmt->then_branch) : optimize(stmt->else_branch);
+            return;
+        }
+
+        StmtPtr then_branch = optimize_body(stmt->then_branch);
+        StmtPtr else_branch = optimize(stmt->else_branch);
+        if (condition == stmt->condition && then_branch == stmt->then_branch && else_branch == stmt->else_branch)
+            result = self;
+        else
+            result = make_IfStmt(condition, then_branch, else_branch);
+    }
+
+    void Optimizer::visitWhileStmt(WhileStmt *stmt)
+    {
+        StmtPtr self = current_stmt;
+        ExprPtr condition = optimize(stmt->condition);
+
+        const Literal *literal = as_literal(condition);
+        if (literal && !is_truthy(literal_to_value(literal->value)))
+        {
+            result = nullptr; // never runs
+            return;
+        }
+
+        StmtPtr body = optimize_body(stmt->body);
+        if (condition == stmt->condition && body == stmt->body)
+            result = self;
+        else
+            result = make_WhileStmt(condition, body);
+    }
+
+    void Optimizer::visitForStmt(ForStmt *stmt)
+    {
+        StmtPtr self = current_stmt;
+        StmtPtr initializer = optimize(stmt->initializer);
+        ExprPtr condition = optimize(stmt->condition);
+
+        const Literal *literal = as_literal(condition);
+        if (literal && !is_truthy(literal_to_value(literal->value)))
+        {
+            result = initializer; // only the initializer ever runs, and it runs in the enclosing scope
+            return;
+        }
+
+        ExprPtr increment = optimize(stmt->increment);
+        StmtPtr body = optimize_body(stmt->body);
+        if (initializer == stmt->initializer && condition == stmt->condition && increment == stmt->increment &&
+            body == stmt->body)
+            result = self;
+        else
+            result = make_ForStmt(initializer, condition, increment, body);
+    }
+
+    // Expressions
+
+    std::any Optimizer::visitLiteralExpr(Literal *)
+    {
+        return current_expr;
+    }
+
+    std::any Optimizer::visitVariableExpr(Variable *)
+    {
+        return current_expr;
+    }
+
+    std::any Optimizer::visitGroupingExpr(Grouping *expr)
+    {
+        ExprPtr self = current_expr;
+        ExprPtr inner = optimize(expr->expression);
+        if (as_literal(inner))
+            return inner;
+        return inner == expr->expression ? self : make_Grouping(inner);
+    }
+
+    std::any Optimizer::visitUnaryExpr(Unary *expr)
+    {
+        ExprPtr self = current_expr;
+        ExprPtr right = optimize(expr->right);
+
+        if (const Literal *literal = as_literal(right))
+        {
+            Value value = literal_to_value(literal->value);
+            if (expr->operator_token.type == TokenType::BANG)
+                return make_Literal(!is_truthy(value), expr->operator_token.line);
+            if (std::holds_alternative<double>(value))
+                return make_Literal(-std::get<double>(value), expr->operator_token.line);
+        }
+        return right == expr->right ? self : make_Unary(expr->operator_token, right);
+    }
+
+    std::any Optimizer::visitBinaryExpr(Binary *expr)
+    {
+        ExprPtr self = current_expr;
+        ExprPtr left = optimize(expr->left);
+        ExprPtr right = optimize(expr->right);
+
+        const Literal *left_literal = as_literal(left);
+        const Literal *right_literal = as_literal(right);
+
+        // a literal on the left of a comma has no effect
+        if (expr->operator_token.type == TokenType::COMMA && left_literal)
+            return right;
+
+        if (left_literal && right_literal)
+        {
+            auto folded = fold_binary(expr->operator_token.type, literal_to_value(left_literal->value),
+                                      literal_to_value(right_literal->value));
+            if (folded)
+                return make_value_literal(*folded, expr->operator_token.line);
+        }
+
+        if (left == expr->left && right == expr->right)
+            return self;
+        return make_Binary(left, expr->operator_token, right);
+    }
+
+    std::any Optimizer::visitTernaryExpr(Ternary *expr)
+    {
+        ExprPtr self = current_expr;
+        ExprPtr condition = optimize(expr->condition);
+
+        if (const Literal *literal = as_literal(condition))
+            return is_truthy(literal_to_value(literal->value)) ? optimize(expr->then_branch) : optimize(expr->else_branch);
+
+        ExprPtr then_branch = optimize(expr->then_branch);
+        ExprPtr else_branch = optimize(expr->else_branch);
+        if (condition == expr->condition && then_branch == expr->then_branch && else_branch == expr->else_branch)
+            return self;
+        return make_Ternary(condition, then_branch, else_branch);
+    }
+
+    std::any Optimizer::visitAssignExpr(Assign *expr)
+    {
+        ExprPtr self = current_expr;
+        ExprPtr value = optimize(expr->value);
+        return value == expr->value ? self : make_Assign(expr->name, value);
+    }
+
+    std::any Optimizer::visitLogicalExpr(Logical *expr)
+    {
+        ExprPtr self = current_expr;
+        ExprPtr left = optimize(expr->left);
+
+        if (const Literal *literal = as_literal(left))
+        {
+            // `or` keeps a truthy left, `and` keeps a falsey left, otherwise the result is the right operand
+            bool truthy = is_truthy(literal_to_value(literal->value));
+            bool keep_left = expr->operator_token.type == TokenType::OR ? truthy : !truthy;
+            return keep_left ? left : optimize(expr->right);
+        }
+
+        ExprPtr right = optimize(expr->right);
+        if (left == expr->left && right == expr->right)
+            return self;
+        return make_Logical(left, expr->operator_token, right);
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "../Parser/Expr.h"
+#include "../Parser/Stmt.h"
+#include <unordered_map>
+#include <vector>
+
+namespace lex
+{
+    /*
+     * AST to AST simplification pass, runs right after Parser::parse.
+     *  - folds Binary/Unary/Grouping/Ternary/Logical expressions whose operands are literals
+     *  - prunes dead IfStmt branches and loops whose condition is a false literal
+     *  - drops expression statements that have no effect (a bare literal)
+     * Anything that would raise a runtime error (`1 / 0`, `-"a"`) is left in place so the error still happens
+     * at runtime, on the same line. Nodes are immutable, changed subtrees are rebuilt and untouched ones shared.
+     */
+    class Optimizer : public ExprVisitor, public StmtVisitor
+    {
+    public:
+        std::vector<StmtPtr> optimize(const std::vector<StmtPtr> &statements);
+
+        // replace the given nodes while optimizing, used to plug in values known at runtime (hoisted invariants)
+        void substitute(std::unordered_map<const Expr *, ExprPtr> replacements);
+
+        // Visit methods from ExprVisitor, each returns the (possibly new) ExprPtr
+        std::any visitBinaryExpr(Binary *expr) override;
+        std::any visitGroupingExpr(Grouping *expr) override;
+        std::any visitLiteralExpr(Literal *expr) override;
+        std::any visitUnaryExpr(Unary *expr) override;
+        std::any visitTernaryExpr(Ternary *expr) override;
+        std::any visitVariableExpr(Variable *expr) override;
+        std::any visitAssignExpr(Assign *expr) override;
+        std::any visitLogicalExpr(Logical *expr) override;
+
+        // Visit methods from StmtVisitor, each stores the replacement in `result` (nullptr drops the statement)
+        void visitExpressionStmt(ExpressionStmt *stmt) override;
+        void visitPrintStmt(PrintStmt *stmt) override;
+        void visitVariableStmt(VariableStmt *stmt) override;
+        void visitBlockStmt(BlockStmt *stmt) override;
+        void visitIfStmt(IfStmt *stmt) override;
+        void visitWhileStmt(WhileStmt *stmt) override;
+        void visitForStmt(ForStmt *stmt) override;
+
+    private:
+        ExprPtr current_expr; // node being visited, returned as is when nothing changes
+        StmtPtr current_stmt;
+        StmtPtr result;
+        std::unordered_map<const Expr *, ExprPtr> substitutions;
+
+        ExprPtr optimize(const ExprPtr &expr);
+        StmtPtr optimize(const StmtPtr &stmt);
+        StmtPtr optimize_body(const StmtPtr &stmt); // never nullptr, loops and ifs need a body
+    };
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include "Expr.h"
+#include "Stmt.h"
+#include <string>
+#include <any>
+#include <sstream>
+#include <vector>
+
+namespace lex
+{
+  class ASTPrinter: public ExprVisitor, public StmtVisitor
+  {
+  private:
+    std::ostringstream out; // statements are written here, one per line
+    int depth = 0;
+
+    std::string parenthesize(const std::string & name, Expr * expr)
+    {
+      std::ostringstream oss;
+      oss << "(" << name << " ";
+      oss << std::any_cast<std::string>(expr->accept(this));
+      oss << ")";
+      return oss.str();
+    }
+
+    std::string parenthesize(const std::string& name, Expr* left, Expr* right)
+    {
+      std::ostringstream oss;
+      oss << "(" << name << " ";
+      oss << std::any_cast<std::string>(left->accept(this)) << " ";
+      oss << std::any_cast<std::string>(right->accept(this));
+      oss << ")";
+      return oss.str();
+    }
+
+      std::string parenthesize(const std::string& name, Expr* first, Expr* second, Expr* third)
+      {
+          std::ostringstream oss;
+          oss << "(" << name << " ";
+          oss << std::any_cast<std::string>(first->accept(this)) << " ";
+          oss << std::any_cast<std::string>(second->accept(this)) << " ";
+          oss << std::any_cast<std::string>(third->accept(this));
+          oss << ")";
+          return oss.str();
+      }
+
+      std::ostringstream& line()
+      {
+          out << std::string(depth * 2, ' ');
+          return out;
+      }
+
+      void nested(Stmt* stmt)
+      {
+          depth++;
+          if (stmt != nullptr)
+              stmt->accept(this);
+          depth--;
+      }
+
+  public:
+    std::string print(Expr * expr)
+    {
+      return std::any_cast<std::string>(expr->accept(this));
+    }
+
+    std::string print(const std::vector<StmtPtr>& statements)
+    {
+        out.str("");
+        depth = 0;
+        for (const auto& stmt : statements)
+            stmt->accept(this);
+        return out.str();
+    }
+
+    std::any visitBinaryExpr(Binary* expr) override
+    {
+      return parenthesize(expr->operator_token.lexeme, expr->left.get(), expr->right.get());
+    }
+    std::any visitGroupingExpr(Grouping* expr) override {
+      return parenthesize("group", expr->expression.get());
+    }
+
+    std::any visitLiteralExpr(Literal* expr) override
+    {
+        if (std::holds_alternative<std::monostate>(expr->value)) {
+            return std::string("nil");
+        }
+        else if (std::holds_alternative<std::string>(expr->value)) {
+            return "\"" + std::get<std::string>(expr->value) + "\"";
+        }
+        else if (std::holds_alternative<double>(expr->value)) {
+            std::ostringstream oss;
+            oss << std::get<double>(expr->value);
+            return oss.str();
+        }
+        else if (std::holds_alternative<bool>(expr->value)) {
+            return std::get<bool>(expr->value) ? std::string("true") : std::string("false");
+        }
+
+        return std::string("unknown literal");
+    }
+
+    std::any visitUnaryExpr(Unary* expr) override
+    {
+        return parenthesize(expr->operator_token.lexeme, expr->right.get());
+    }
+
+    std::any visitTernaryExpr(Ternary* expr) override
+    {
+        return parenthesize("?:", expr->condition.get(), expr->then_branch.get(), expr->else_branch.get());
+    }
+
+    std::any visitVariableExpr(Variable* expr ) override
+    {
+        return expr->name.lexeme;
+    }
+
+    std::any visitAssignExpr(Assign* expr) override
+    {
+        return parenthesize("= " + expr->name.lexeme, expr->value.get());
+    }
+
+    std::any visitLogicalExpr(Logical* expr) override
+    {
+        return parenthesize(expr->operator_token.lexeme, expr->left.get(), expr->right.get());
+    }
+
+    // statements, printed one per line with nested statements indented
+
+    void visitExpressionStmt(ExpressionStmt* stmt) override
+    {
+        line() << "(expr " << print(stmt->expression.get()) << ")\n";
+    }
+
+    void visitPrintStmt(PrintStmt* stmt) override
+    {
+        line() << "(print " << print(stmt->expression.get()) << ")\n";
+    }
+
+    void visitVariableStmt(VariableStmt* stmt) override
+    {
+        line() << "(var " << stmt->name.lexeme;
+        if (stmt->initializer)
+            out << " " << print(stmt->initializer.get());
+        out << ")\n";
+    }
+
+    void visitBlockStmt(BlockStmt* stmt) override
+    {
+        line() << "(block\n";
+        for (const auto& statement : stmt->statements)
+            nested(statement.get());
+        line() << ")\n";
+    }
+
+    void visitIfStmt(IfStmt* stmt) override
+    {
+        line() << "(if " << print(stmt->condition.get()) << "\n";
+        nested(stmt->then_branch.get());
+        if (stmt->else_branch)
+        {
+            line() << "else\n";
+            nested(stmt->else_branch.get());
+        }
+        line() << ")\n";
+    }
+
+    void visitWhileStmt(WhileStmt* stmt) override
+    {
+        line() << "(while " << print(stmt->condition.get()) << "\n";
+        nested(stmt->body.get());
+        line() << ")\n";
+    }
+
+    void visitForStmt(ForStmt* stmt) override
+    {
+        line() << "(for " << (stmt->condition ? print(stmt->condition.get()) : "true");
+        if (stmt->increment)
+            out << " " << print(stmt->increment.get());
+        out << "\n";
+        nested(stmt->initializer.get());
+        nested(stmt->body.get());
+        line() << ")\n";
+    }
+  };
+}
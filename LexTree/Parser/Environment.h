@@ -1,8 +1,10 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <any>
 #include "../Interpreter/Value.h"
+#include "../Interpreter/Memory.h"
 #include "../Lexer/Token.h"
 #include "../Error_Handling/RunTimeError.h"
 #include <stdexcept>
@@ -14,13 +16,65 @@ namespace lex
     private:
         std::shared_ptr<Environment> parent;
         std::map<std::string, Value> values;
+        Snapshot base; // globals forked from a snapshot, copied into `values` on first write
+        Memory *memory = nullptr; // charged for `values` when set, shared with the enclosing scopes
+        size_t held = 0;          // what `values` is charged for
+
+        // brings the account from `before` to `after` bytes, throws (changing nothing) when that does not fit
+        void charge(const Token &name, size_t before, size_t after)
+        {
+            if (!memory)
+                return;
+            if (after > before)
+            {
+                if (!memory->fits(after - before))
+                    throw RuntimeError(name, memory->exceeded());
+                memory->add(after - before);
+            }
+            else
+                memory->remove(before - after);
+            held = held + after - before;
+        }
 
     public:
-        Environment() : parent(nullptr) {} // default for global scope
-        Environment(std::shared_ptr<Environment> parent) : parent(std::move(parent)) {} // for local scopes
-        void define(const std::string &name, const Value &value)
+        Environment(Memory *memory = nullptr) : parent(nullptr), memory(memory) {} // default for global scope
+        Environment(std::shared_ptr<Environment> parent) : parent(std::move(parent)) // for local scopes
         {
-            values[name] = value;
+            memory = this->parent->memory;
+        }
+        // global scope forked from a snapshot
+        Environment(Snapshot base, Memory *memory = nullptr) : parent(nullptr), base(std::move(base)), memory(memory) {}
+
+        ~Environment()
+        {
+            if (memory)
+                memory->remove(held);
+        }
+
+        Environment(const Environment &) = delete;
+        Environment &operator=(const Environment &) = delete;
+
+        // every variable of this (global) environment, the snapshot it was forked from included
+        Snapshot snapshot() const
+        {
+            if (values.empty() && base)
+                return base;
+            auto frozen = base ? std::make_shared<std::map<std::string, Value>>(*base)
+                               : std::make_shared<std::map<std::string, Value>>();
+            for (const auto &[name, value] : values)
+                (*frozen)[name] = value;
+            return frozen;
+        }
+
+        void define(const Token &name, const Value &value)
+        {
+            auto it = values.find(name.lexeme);
+            size_t before = it != values.end() ? Memory::footprint(name.lexeme, it->second) : 0;
+            charge(name, before, Memory::footprint(name.lexeme, value));
+            if (it != values.end())
+                it->second = value;
+            else
+                values.emplace(name.lexeme, value);
         }
 
         Value get(Token name)
@@ -30,6 +84,12 @@ namespace lex
             {
                 return it->second;
             }
+            if (base)
+            {
+                auto shared = base->find(name.lexeme);
+                if (shared != base->end())
+                    return shared->second;
+            }
             // check in parent environment
             if(parent)
             {
@@ -39,11 +99,57 @@ namespace lex
             throw RuntimeError(name, "Undefined variable: " + name.lexeme);
         }
 
+        // storage of a variable, walking up the scopes, nullptr when undefined.
+        // std::map never moves its nodes, so the pointer stays valid while this environment lives
+        Value *find(const std::string &name)
+        {
+            auto it = values.find(name);
+            if (it != values.end())
+                return &it->second;
+            if (base)
+            {
+                // the caller may write through the pointer, so take a private copy first
+                auto shared = base->find(name);
+                if (shared != base->end())
+                {
+                    // a copy of a value that already exists, charged without a check
+                    if (memory)
+                    {
+                        size_t bytes = Memory::footprint(name, shared->second);
+                        memory->add(bytes);
+                        held += bytes;
+                    }
+                    return &values.emplace(name, shared->second).first->second;
+                }
+            }
+            return parent ? parent->find(name) : nullptr;
+        }
+
+        // how many scopes up `name` is defined (0: here), the whole chain when it is not defined anywhere
+        size_t distance(const std::string &name) const
+        {
+            size_t hops = 0;
+            for (const Environment *scope = this; scope; scope = scope->parent.get(), hops++)
+            {
+                if (scope->values.count(name) || (scope->base && scope->base->count(name)))
+                    return hops;
+            }
+            return hops - 1;
+        }
+
         void assign(Token name, const Value &value)
         {
-          if(values.find(name.lexeme) != values.end())
+          auto it = values.find(name.lexeme);
+          if (it != values.end())
+          {
+            charge(name, Memory::footprint(name.lexeme, it->second), Memory::footprint(name.lexeme, value));
+            it->second = value;
+            return;
+          }
+          if (base && base->count(name.lexeme))
           {
-            values[name.lexeme] = value;
+            charge(name, 0, Memory::footprint(name.lexeme, value));
+            values.emplace(name.lexeme, value); // copy on write for snapshot variables
             return;
           }
           if (parent != nullptr)
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../Lexer/Token.h"
+#include <cstdint>
 #include <memory>
 #include <any>
 #include <utility>
@@ -10,6 +11,9 @@ namespace lex
     class Expr;
     using ExprPtr = std::shared_ptr<Expr>;
 
+    // id of a node that belongs to no Program (made up while running, e.g. the literals of a loop plan)
+    inline constexpr uint32_t NO_NODE_ID = UINT32_MAX;
+
     class ExprVisitor
     {
     public:
@@ -29,6 +33,8 @@ namespace lex
     class Expr
     {
     public:
+        uint32_t id = NO_NODE_ID; // dense number within its Program, given when the Program is made
+
         virtual ~Expr() = default;
         virtual std::any accept(ExprVisitor *visitor) = 0;
     };
@@ -72,8 +78,9 @@ namespace lex
     {
     public:
         const LiteralValue value;
+        const int line; // of the token it was written as (of the folded expression after optimizing), 0: unknown
 
-        Literal(LiteralValue value) : value(std::move(value))
+        Literal(LiteralValue value, int line = 0) : value(std::move(value)), line(line)
         {
         }
         std::any accept(ExprVisitor *visitor) override
@@ -178,9 +185,9 @@ namespace lex
         return std::make_shared<Grouping>(std::move(expression));
     }
 
-    inline ExprPtr make_Literal(LiteralValue value)
+    inline ExprPtr make_Literal(LiteralValue value, int line = 0)
     {
-        return std::make_shared<Literal>(std::move(value));
+        return std::make_shared<Literal>(std::move(value), line);
     }
 
     inline ExprPtr make_Unary(Token operator_token, ExprPtr right)
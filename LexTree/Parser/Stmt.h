@@ -28,6 +28,8 @@ namespace lex
     class Stmt
     {
     public:
+        uint32_t id = NO_NODE_ID; // dense number within its Program, shared with the expressions
+
         virtual ~Stmt() = default;
         virtual void accept(StmtVisitor *visitor) = 0;
     };
@@ -1,9 +1,8 @@
 #include "parser.h"
-#include "../LexTree.h"
 
 namespace lex
 {
-    Parser::Parser(const std::vector<Token> &tokens) : tokens(tokens) {}
+    Parser::Parser(const std::vector<Token> &tokens, Diagnostics &diagnostics) : tokens(tokens), diagnostics(diagnostics) {}
     std::vector<StmtPtr> Parser::parse()
     {
         std::vector<StmtPtr> statements;
@@ -71,7 +70,7 @@ namespace lex
 
     ParseError Parser::error(const lex::Token &token, const std::string &message)
     {
-        LexTree::error(token.line, message);
+        diagnostics.error(token.line, message);
         return ParseError(message);
     }
 
@@ -428,20 +427,20 @@ namespace lex
 
         // Literals
         if (match(TokenType::FALSE))
-            return make_Literal(false);
+            return make_Literal(false, previous().line);
         if (match(TokenType::TRUE))
-            return make_Literal(true);
+            return make_Literal(true, previous().line);
         if (match(TokenType::NIL))
-            return make_Literal(std::monostate{});
+            return make_Literal(std::monostate{}, previous().line);
 
         if (match(TokenType::NUMBER))
         {
-            return make_Literal(std::get<double>(previous().literal));
+            return make_Literal(std::get<double>(previous().literal), previous().line);
         }
 
         if (match(TokenType::STRING))
         {
-            return make_Literal(std::get<std::string>(previous().literal));
+            return make_Literal(std::get<std::string>(previous().literal), previous().line);
         }
 
         if (match(TokenType::IDENTIFIER))
@@ -4,6 +4,7 @@
 #include "../Lexer/Token.h"
 #include "Expr.h"
 #include "Stmt.h"
+#include "../Error_Handling/Diagnostics.h"
 #include <vector>
 #include <string>
 #include <stdexcept>
@@ -20,6 +21,7 @@ namespace lex
     {
     private:
         std::vector<Token> tokens;
+        Diagnostics &diagnostics;
         int current = 0;
 
         // Production rules
@@ -63,7 +65,7 @@ namespace lex
         void synchronize();
 
     public:
-        explicit Parser(const std::vector<Token> &tokens);
+        Parser(const std::vector<Token> &tokens, Diagnostics &diagnostics);
         std::vector<StmtPtr> parse();
     };
 }
\ No newline at end of file
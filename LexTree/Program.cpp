@@ -0,0 +1,188 @@
+#include "Program.h"
+#include "Engine.h"
+#include "Lexer/Lexer.h"
+#include "Parser/parser.h"
+#include "Optimizer/Optimizer.h"
+#include "Optimizer/Interner.h"
+#include "Instrumentation/Stats.h"
+#include "Cache/AstCache.h"
+#include "Instrumentation/Trace.h"
+
+namespace lex
+{
+    namespace
+    {
+        // keeps syntax errors so every engine running the program can report them again
+        class RecordingDiagnostics : public Diagnostics
+        {
+        public:
+            std::vector<std::pair<int, std::string>> errors;
+
+        protected:
+            void report_error(int line, const std::string &message) override
+            {
+                errors.emplace_back(line, message);
+            }
+        };
+
+        // hands out ids in source order, a node reachable from several places keeps the first one
+        class NodeNumbering
+        {
+        public:
+            uint32_t next = 0;
+
+            void number(Stmt *stmt)
+            {
+                if (stmt == nullptr || stmt->id != NO_NODE_ID)
+                    return;
+                stmt->id = next++;
+                if (auto expression = dynamic_cast<ExpressionStmt *>(stmt))
+                    number(expression->expression.get());
+                else if (auto print = dynamic_cast<PrintStmt *>(stmt))
+                    number(print->expression.get());
+                else if (auto variable = dynamic_cast<VariableStmt *>(stmt))
+                    number(variable->initializer.get());
+                else if (auto block = dynamic_cast<BlockStmt *>(stmt))
+                {
+                    for (const auto &statement : block->statements)
+                        number(statement.get());
+                }
+                else if (auto if_stmt = dynamic_cast<IfStmt *>(stmt))
+                {
+                    number(if_stmt->condition.get());
+                    number(if_stmt->then_branch.get());
+                    number(if_stmt->else_branch.get());
+                }
+                else if (auto while_stmt = dynamic_cast<WhileStmt *>(stmt))
+                {
+                    number(while_stmt->condition.get());
+                    number(while_stmt->body.get());
+                }
+                else if (auto for_stmt = dynamic_cast<ForStmt *>(stmt))
+                {
+                    number(for_stmt->initializer.get());
+                    number(for_stmt->condition.get());
+                    number(for_stmt->increment.get());
+                    number(for_stmt->body.get());
+                }
+            }
+
+            void number(Expr *expr)
+            {
+                if (expr == nullptr || expr->id != NO_NODE_ID)
+                    return;
+                expr->id = next++;
+                if (auto binary = dynamic_cast<Binary *>(expr))
+                {
+                    number(binary->left.get());
+                    number(binary->right.get());
+                }
+                else if (auto logical = dynamic_cast<Logical *>(expr))
+                {
+                    number(logical->left.get());
+                    number(logical->right.get());
+                }
+                else if (auto unary = dynamic_cast<Unary *>(expr))
+                    number(unary->right.get());
+                else if (auto ternary = dynamic_cast<Ternary *>(expr))
+                {
+                    number(ternary->condition.get());
+                    number(ternary->then_branch.get());
+                    number(ternary->else_branch.get());
+                }
+                else if (auto grouping = dynamic_cast<Grouping *>(expr))
+                    number(grouping->expression.get());
+                else if (auto assign = dynamic_cast<Assign *>(expr))
+                    number(assign->value.get());
+            }
+        };
+
+        uint32_t number_nodes(const std::vector<StmtPtr> &statements)
+        {
+            NodeNumbering numbering;
+            for (const auto &statement : statements)
+                numbering.number(statement.get());
+            return numbering.next;
+        }
+    }
+
+    Program::Program(std::vector<StmtPtr> statements, std::vector<std::pair<int, std::string>> errors, bool optimized,
+                     bool interned, InternStats intern_stats)
+        : statements(std::move(statements)), errors(std::move(errors)), optimized(optimized), interned(interned),
+          intern_stats(intern_stats), nodes(number_nodes(this->statements))
+    {
+    }
+
+    ProgramPtr Program::compile(const std::string &source, const EngineOptions &options, const std::string &path,
+                                Stats *stats)
+    {
+        std::string cache = options.cache && !path.empty() ? AstCache::path_for(path, source) : std::string();
+        if (!cache.empty())
+        {
+            ProgramPtr program;
+            {
+                PhaseTimer timer(stats ? &stats->cache : nullptr);
+                LEX_TRACE_SPAN("cache load", "compile");
+                program = AstCache::load(cache, source, options.optimize, options.intern);
+            }
+            if (program)
+            {
+                if (stats)
+                    stats->nodes = Stats::count_nodes(program->statements);
+                return program;
+            }
+        }
+
+        RecordingDiagnostics diagnostics;
+        std::vector<Token> tokens;
+        {
+            PhaseTimer timer(stats ? &stats->lex : nullptr);
+            LEX_TRACE_SPAN("lex", "compile");
+            Lexer lexer(source, diagnostics);
+            tokens = lexer.scan_tokens();
+        }
+        std::vector<StmtPtr> statements;
+        {
+            PhaseTimer timer(stats ? &stats->parse : nullptr);
+            LEX_TRACE_SPAN("parse", "compile");
+            Parser parser(tokens, diagnostics);
+            statements = parser.parse();
+        }
+        if (stats)
+        {
+            stats->tokens = tokens.size();
+            stats->nodes = Stats::count_nodes(statements);
+        }
+
+        if (!diagnostics.errors.empty())
+            return std::make_shared<const Program>(std::move(statements), std::move(diagnostics.errors), false, false,
+                                                   InternStats{});
+
+        ProgramPtr program = build(std::move(statements), options, stats);
+        if (!cache.empty())
+            AstCache::store(cache, source, *program); // best effort, a read-only directory just means no cache
+        return program;
+    }
+
+    ProgramPtr Program::build(std::vector<StmtPtr> statements, const EngineOptions &options, Stats *stats)
+    {
+        PhaseTimer timer(stats ? &stats->optimize : nullptr);
+        LEX_TRACE_SPAN("optimize", "compile");
+        if (options.optimize)
+        {
+            Optimizer optimizer;
+            statements = optimizer.optimize(statements);
+        }
+
+        InternStats interned;
+        if (options.intern)
+        {
+            Interner interner;
+            statements = interner.intern(statements);
+            interned = interner.stats();
+        }
+
+        return std::make_shared<const Program>(std::move(statements), std::vector<std::pair<int, std::string>>{},
+                                               options.optimize, options.intern, interned);
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Parser/Stmt.h"
+#include "Optimizer/InternStats.h"
+
+namespace lex
+{
+    struct EngineOptions;
+    struct Stats;
+    class Program;
+    using ProgramPtr = std::shared_ptr<const Program>;
+
+    /*
+     * A script after the front end: parsed, optimized and (with `intern`) interned. Nothing changes it after
+     * construction, so one Program can be executed by any number of engines on any number of threads at once.
+     * Engines that want to remember something per node (the Interpreter's loop plans, the VM's compiled chunk)
+     * keep it in their own tables keyed by node/program, never in the nodes. The one thing the Program puts into its
+     * nodes is their dense `id`, so such a table can be a plain array.
+     */
+    class Program
+    {
+    public:
+        // lex and parse `source` (or load the .lexc of `path` when options.cache is set), then optimize/intern.
+        // With `stats` the phases are timed into it.
+        static ProgramPtr compile(const std::string &source, const EngineOptions &options, const std::string &path = "",
+                                  Stats *stats = nullptr);
+        // optimize/intern an already parsed program
+        static ProgramPtr build(std::vector<StmtPtr> statements, const EngineOptions &options, Stats *stats = nullptr);
+
+        const std::vector<StmtPtr> statements;
+        // syntax errors as (line, message), a program with errors must not run
+        const std::vector<std::pair<int, std::string>> errors;
+        const bool optimized;
+        const bool interned;
+        const InternStats intern_stats; // only meaningful when interned
+
+        // every node reachable from `statements` gets its `id`, 0 .. nodes - 1 in source order (shared nodes once)
+        const uint32_t nodes;
+
+        Program(std::vector<StmtPtr> statements, std::vector<std::pair<int, std::string>> errors, bool optimized,
+                bool interned, InternStats intern_stats);
+
+        Program(const Program &) = delete;
+        Program &operator=(const Program &) = delete;
+    };
+}
@@ -0,0 +1,93 @@
+#include "Repl.h"
+#include "../Lexer/Lexer.h"
+
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+
+namespace lex
+{
+    namespace
+    {
+        // remembers whether the input stopped in the middle of a string or block comment, reports nothing
+        class OpenTokenDiagnostics : public Diagnostics
+        {
+        public:
+            bool unterminated = false;
+
+        protected:
+            void report_error(int, const std::string &message) override
+            {
+                if (message == "Unterminated string." || message == "Unterminated block comment.")
+                    unterminated = true;
+            }
+        };
+    }
+
+    bool Repl::feed(const std::string &line)
+    {
+        buffer += line;
+        buffer += '\n';
+        if (!is_complete(buffer))
+            return false;
+
+        std::string source = std::move(buffer);
+        buffer.clear();
+        evaluate(source);
+        return true;
+    }
+
+    void Repl::flush()
+    {
+        if (!pending())
+            return;
+        std::string source = std::move(buffer);
+        buffer.clear();
+        evaluate(source);
+    }
+
+    void Repl::evaluate(const std::string &source)
+    {
+        auto start = std::chrono::steady_clock::now();
+        size_t hits = programs.hits();
+        ProgramPtr program = programs.get(source, engine.options);
+        auto compiled = std::chrono::steady_clock::now();
+        engine.run(program);
+        auto finished = std::chrono::steady_clock::now();
+
+        if (report_latency)
+        {
+            std::ostringstream latency;
+            latency << std::fixed << std::setprecision(3)
+                    << "[repl] compile: " << std::chrono::duration<double, std::milli>(compiled - start).count()
+                    << " ms" << (programs.hits() > hits ? " (cached)" : "")
+                    << ", run: " << std::chrono::duration<double, std::milli>(finished - compiled).count() << " ms";
+            engine.diagnostics().note(latency.str());
+        }
+    }
+
+    bool Repl::is_complete(const std::string &source)
+    {
+        OpenTokenDiagnostics diagnostics;
+        Lexer lexer(source, diagnostics);
+        std::vector<Token> tokens = lexer.scan_tokens();
+        if (diagnostics.unterminated)
+            return false;
+
+        std::vector<TokenType> open;
+        for (const Token &token : tokens)
+        {
+            if (token.type == TokenType::LEFT_BRACE || token.type == TokenType::LEFT_PAREN)
+                open.push_back(token.type);
+            else if (token.type == TokenType::RIGHT_BRACE || token.type == TokenType::RIGHT_PAREN)
+            {
+                TokenType expected = token.type == TokenType::RIGHT_BRACE ? TokenType::LEFT_BRACE : TokenType::LEFT_PAREN;
+                // a stray or mismatched closing bracket is an error the parser reports, not a reason to wait
+                if (open.empty() || open.back() != expected)
+                    return true;
+                open.pop_back();
+            }
+        }
+        return open.empty();
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "../Engine.h"
+#include "../Cache/ProgramCache.h"
+#include <string>
+
+namespace lex
+{
+    /*
+     * Interactive session on top of an Engine (`lextree` without a script).
+     * Lines are collected until the entry is complete (brackets closed, no open string or block comment), then the
+     * entry runs on the same engine so globals persist. Compiled entries are kept in a ProgramCache: typing a line
+     * again, which is what an operations console mostly does, skips the Lexer, Parser and Optimizer.
+     */
+    class Repl
+    {
+    public:
+        explicit Repl(Engine &engine) : engine(engine) {}
+
+        // feeds one input line, runs the entry once it is complete; returns false while more lines are needed
+        bool feed(const std::string &line);
+        // runs whatever is buffered (end of input inside an open block), errors included
+        void flush();
+
+        bool pending() const { return !buffer.empty(); }
+        const char *prompt() const { return pending() ? "... " : "> "; }
+
+        // report compile and run time of every entry as a note on the engine's diagnostics (`--latency`, `:time`)
+        bool report_latency = false;
+
+    private:
+        Engine &engine;
+        ProgramCache programs;
+        std::string buffer;
+
+        void evaluate(const std::string &source);
+        static bool is_complete(const std::string &source);
+    };
+}
@@ -0,0 +1,48 @@
+#include "Client.h"
+#include <algorithm>
+
+namespace lex
+{
+    int Client::run(const std::string &socket_path, const Request &request, std::ostream &out, std::ostream &err)
+    {
+        std::optional<int> fd = Connection::connect(socket_path);
+        if (!fd)
+        {
+            err << "Could not connect to: " << socket_path << std::endl;
+            return 74;
+        }
+
+        Connection connection(*fd);
+        if (!connection.write_all(request.encode()))
+        {
+            err << "Could not send the request to: " << socket_path << std::endl;
+            return 74;
+        }
+
+        while (std::optional<std::string> header = connection.read_line())
+        {
+            size_t space = header->find(' ');
+            std::string kind = header->substr(0, space);
+            std::string value = space == std::string::npos ? std::string() : header->substr(space + 1);
+            if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos || value.size() > 19)
+                break;
+
+            if (kind == "status")
+            {
+                out.flush();
+                return static_cast<int>(std::min<unsigned long long>(std::stoull(value), 255));
+            }
+
+            std::optional<std::string> data = connection.read_exact(std::stoull(value));
+            if (!data || (kind != "out" && kind != "err"))
+                break;
+            std::ostream &target = kind == "out" ? out : err;
+            target << *data;
+            target.flush();
+        }
+
+        out.flush();
+        err << "Connection to " << socket_path << " closed before the script finished." << std::endl;
+        return 74;
+    }
+}
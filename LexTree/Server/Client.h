@@ -0,0 +1,18 @@
+#pragma once
+
+#include "Protocol.h"
+#include <iostream>
+#include <string>
+
+namespace lex
+{
+    // thin client of a Server (`lextree --connect <socket> <script>`)
+    class Client
+    {
+    public:
+        // sends `request`, copies the streamed output to `out`/`err` as it arrives and returns the script's exit
+        // code (74 when the server cannot be reached or hangs up early)
+        static int run(const std::string &socket_path, const Request &request, std::ostream &out = std::cout,
+                       std::ostream &err = std::cerr);
+    };
+}
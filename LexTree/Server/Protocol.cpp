@@ -0,0 +1,248 @@
+#include "Protocol.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define LEXTREE_HAS_UNIX_SOCKETS 1
+#endif
+
+namespace lex
+{
+    namespace
+    {
+        std::optional<uint64_t> parse_number(const std::string &text)
+        {
+            if (text.empty() || text.size() > 19 || text.find_first_not_of("0123456789") != std::string::npos)
+                return std::nullopt;
+            return std::stoull(text);
+        }
+    }
+
+    std::string Request::encode() const
+    {
+        std::string header;
+        if (has_source)
+            header += "source " + std::to_string(source.size()) + "\n";
+        else
+            header += "file " + path + "\n";
+        if (time_limit_ms)
+            header += "time-limit " + std::to_string(*time_limit_ms) + "\n";
+        if (step_limit)
+            header += "step-limit " + std::to_string(*step_limit) + "\n";
+        if (memory_limit)
+            header += "memory-limit " + std::to_string(*memory_limit) + "\n";
+        header += "\n";
+        return has_source ? header + source : header;
+    }
+
+    Connection::~Connection()
+    {
+#ifdef LEXTREE_HAS_UNIX_SOCKETS
+        if (fd >= 0)
+            ::close(fd);
+#endif
+    }
+
+    std::optional<int> Connection::connect(const std::string &path)
+    {
+#ifdef LEXTREE_HAS_UNIX_SOCKETS
+        sockaddr_un address{};
+        if (path.size() >= sizeof(address.sun_path))
+            return std::nullopt;
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return std::nullopt;
+        if (::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+        {
+            ::close(fd);
+            return std::nullopt;
+        }
+        return fd;
+#else
+        (void)path;
+        return std::nullopt;
+#endif
+    }
+
+    void Connection::set_read_deadline(std::chrono::milliseconds timeout, const std::atomic<bool> *stop_flag)
+    {
+        deadline = std::chrono::steady_clock::now() + timeout;
+        stop = stop_flag;
+    }
+
+    bool Connection::wait_readable()
+    {
+#ifdef LEXTREE_HAS_UNIX_SOCKETS
+        if (!deadline)
+            return true;
+        while (true)
+        {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(*deadline -
+                                                                              std::chrono::steady_clock::now());
+            if (left.count() <= 0 || (stop && stop->load()))
+            {
+                expired = true;
+                return false;
+            }
+            // in slices, so a stop is noticed quickly
+            pollfd waiting{fd, POLLIN, 0};
+            int ready = ::poll(&waiting, 1, static_cast<int>(std::min<long long>(left.count(), 200)));
+            if (ready > 0)
+                return true;
+            if (ready < 0 && errno != EINTR)
+                return false;
+        }
+#else
+        return false;
+#endif
+    }
+
+    bool Connection::fill()
+    {
+#ifdef LEXTREE_HAS_UNIX_SOCKETS
+        if (position > 0)
+        {
+            buffer.erase(0, position);
+            position = 0;
+        }
+        if (!wait_readable())
+            return false;
+        char chunk[16384];
+        ssize_t received;
+        do
+            received = ::recv(fd, chunk, sizeof(chunk), 0);
+        while (received < 0 && errno == EINTR);
+        if (received <= 0)
+            return false;
+        buffer.append(chunk, static_cast<size_t>(received));
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    std::optional<std::string> Connection::read_line(size_t limit)
+    {
+        while (true)
+        {
+            size_t end = buffer.find('\n', position);
+            if (end != std::string::npos)
+            {
+                if (end - position > limit)
+                    return std::nullopt;
+                std::string line = buffer.substr(position, end - position);
+                position = end + 1;
+                return line;
+            }
+            if (buffer.size() - position > limit || !fill())
+                return std::nullopt;
+        }
+    }
+
+    std::optional<std::string> Connection::read_exact(size_t size)
+    {
+        while (buffer.size() - position < size)
+        {
+            if (!fill())
+                return std::nullopt;
+        }
+        std::string data = buffer.substr(position, size);
+        position += size;
+        return data;
+    }
+
+    bool Connection::write_all(const char *data, size_t size)
+    {
+#ifdef LEXTREE_HAS_UNIX_SOCKETS
+        int flags = 0;
+#ifdef MSG_NOSIGNAL
+        flags = MSG_NOSIGNAL; // a client that went away must not kill the server with SIGPIPE
+#endif
+        while (size > 0)
+        {
+            ssize_t sent = ::send(fd, data, size, flags);
+            if (sent < 0 && errno == EINTR)
+                continue;
+            if (sent <= 0)
+                return false;
+            data += sent;
+            size -= static_cast<size_t>(sent);
+        }
+        return true;
+#else
+        (void)data;
+        (void)size;
+        return false;
+#endif
+    }
+
+    std::optional<Request> Connection::read_request(std::string &error)
+    {
+        Request request;
+        bool has_file = false;
+        size_t source_size = 0;
+        while (true)
+        {
+            std::optional<std::string> line = read_line();
+            if (!line)
+            {
+                error = expired ? "Request timed out." : "Incomplete request header.";
+                return std::nullopt;
+            }
+            if (line->empty())
+                break;
+
+            size_t space = line->find(' ');
+            std::string key = line->substr(0, space);
+            std::string value = space == std::string::npos ? std::string() : line->substr(space + 1);
+            std::optional<uint64_t> number = parse_number(value);
+
+            if (key == "file" && !value.empty())
+            {
+                request.path = value;
+                has_file = true;
+            }
+            else if (key == "source" && number && *number <= MAX_REQUEST_SOURCE)
+            {
+                source_size = static_cast<size_t>(*number);
+                request.has_source = true;
+            }
+            else if (key == "time-limit" && number)
+                request.time_limit_ms = *number;
+            else if (key == "step-limit" && number)
+                request.step_limit = *number;
+            else if (key == "memory-limit" && number)
+                request.memory_limit = static_cast<size_t>(*number);
+            else
+            {
+                error = "Bad request header: " + *line;
+                return std::nullopt;
+            }
+        }
+
+        if (has_file == request.has_source)
+        {
+            error = "A request needs exactly one of 'file' and 'source'.";
+            return std::nullopt;
+        }
+        if (request.has_source)
+        {
+            std::optional<std::string> source = read_exact(source_size);
+            if (!source)
+            {
+                error = expired ? "Request timed out." : "Incomplete request source.";
+                return std::nullopt;
+            }
+            request.source = std::move(*source);
+        }
+        return request;
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace lex
+{
+    /*
+     * Wire format of `lextree --serve`, one request per connection.
+     *
+     * client -> server: header lines "<key> <value>\n", an empty line, then the script text when sent inline
+     *     file <path>             run a script file the server reads itself
+     *     source <bytes>          run the <bytes> bytes of script text that follow the header
+     *     time-limit <ms>         optional, lowers the server's limit (see EngineOptions::time_limit_ms)
+     *     step-limit <steps>      optional, lowers the server's limit (see EngineOptions::step_limit)
+     *     memory-limit <bytes>    optional, lowers the server's limit (see EngineOptions::memory_limit)
+     * A limit above the server's, or 0, gets the server's.
+     *
+     * server -> client: any number of "out <n>\n" / "err <n>\n" frames followed by n bytes of program output or
+     * diagnostics, in the order they were produced, then "status <exit code>\n" and the connection is closed.
+     */
+    struct Request
+    {
+        std::string path;   // file request
+        std::string source; // inline request
+        bool has_source = false;
+        std::optional<uint64_t> time_limit_ms;
+        std::optional<uint64_t> step_limit;
+        std::optional<size_t> memory_limit;
+
+        std::string encode() const;
+    };
+
+    // largest inline script a server accepts
+    constexpr size_t MAX_REQUEST_SOURCE = 64u << 20;
+
+    // blocking, buffered I/O on a connected stream socket, reads optionally with a deadline; owns the descriptor
+    class Connection
+    {
+    public:
+        explicit Connection(int fd) : fd(fd) {}
+        ~Connection();
+
+        Connection(const Connection &) = delete;
+        Connection &operator=(const Connection &) = delete;
+
+        // connects to the socket at `path`, nullopt when nobody listens there
+        static std::optional<int> connect(const std::string &path);
+
+        // a line without its '\n', nullopt on end of stream or when it is longer than `limit`
+        std::optional<std::string> read_line(size_t limit = 4096);
+        std::optional<std::string> read_exact(size_t size);
+        bool write_all(const char *data, size_t size);
+        bool write_all(const std::string &data) { return write_all(data.data(), data.size()); }
+
+        // reads and parses a request, nullopt (with `error` set) on a malformed one
+        std::optional<Request> read_request(std::string &error);
+
+        // from now on reads fail like the end of the stream once `timeout` has passed, or as soon as `stop` is set
+        void set_read_deadline(std::chrono::milliseconds timeout, const std::atomic<bool> *stop = nullptr);
+        bool timed_out() const { return expired; }
+
+    private:
+        int fd;
+        std::string buffer;
+        size_t position = 0;
+        std::optional<std::chrono::steady_clock::time_point> deadline;
+        const std::atomic<bool> *stop = nullptr;
+        bool expired = false;
+
+        bool wait_readable();
+
+        bool fill();
+    };
+}
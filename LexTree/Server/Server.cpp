@@ -0,0 +1,258 @@
+#include "Server.h"
+#include "Protocol.h"
+#include "../Batch/ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <streambuf>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define LEXTREE_HAS_UNIX_SOCKETS 1
+#endif
+
+namespace lex
+{
+    namespace
+    {
+        /*
+         * Output of one request. Writes from the out and err streams are kept in order as frames and sent when
+         * enough piled up or a little time passed since the last send, so a chatty script does not cost a
+         * system call per line but a slow one is still seen live.
+         */
+        class FrameWriter
+        {
+        public:
+            explicit FrameWriter(Connection &connection) : connection(connection) {}
+
+            void append(char channel, const char *data, size_t size)
+            {
+                if (frames.empty() || frames.back().first != channel)
+                    frames.emplace_back(channel, std::string());
+                frames.back().second.append(data, size);
+                pending += size;
+                if (pending >= 16384)
+                    flush();
+            }
+
+            void flush_if_due()
+            {
+                if (pending > 0 && std::chrono::steady_clock::now() - last_send > std::chrono::milliseconds(20))
+                    flush();
+            }
+
+            void flush()
+            {
+                std::string packet;
+                for (const auto &[channel, data] : frames)
+                {
+                    packet += channel == 'o' ? "out " : "err ";
+                    packet += std::to_string(data.size()) + "\n";
+                    packet += data;
+                }
+                frames.clear();
+                pending = 0;
+                last_send = std::chrono::steady_clock::now();
+                if (!packet.empty() && !disconnected && !connection.write_all(packet))
+                {
+                    // nobody is reading anymore, stop the script instead of running it for nothing
+                    disconnected = true;
+                    if (engine)
+                        engine->interrupt();
+                }
+            }
+
+            bool disconnected = false;
+            Engine *engine = nullptr; // interrupted when the client goes away
+
+        private:
+            Connection &connection;
+            std::vector<std::pair<char, std::string>> frames;
+            size_t pending = 0;
+            std::chrono::steady_clock::time_point last_send = std::chrono::steady_clock::now();
+        };
+
+        // unbuffered streambuf feeding one channel of a FrameWriter
+        class ChannelBuffer : public std::streambuf
+        {
+        public:
+            ChannelBuffer(FrameWriter &writer, char channel) : writer(writer), channel(channel) {}
+
+        protected:
+            int_type overflow(int_type c) override
+            {
+                if (c != traits_type::eof())
+                {
+                    char ch = traits_type::to_char_type(c);
+                    writer.append(channel, &ch, 1);
+                }
+                return traits_type::not_eof(c);
+            }
+
+            std::streamsize xsputn(const char *data, std::streamsize size) override
+            {
+                writer.append(channel, data, static_cast<size_t>(size));
+                return size;
+            }
+
+            int sync() override
+            {
+                writer.flush_if_due();
+                return 0;
+            }
+
+        private:
+            FrameWriter &writer;
+            char channel;
+        };
+
+        // the server's limits are ceilings: a request can only lower them. 0 is "no limit" for the server and
+        // "the server's" for a request.
+        template <typename Limit>
+        Limit tighter(Limit server, std::optional<Limit> requested)
+        {
+            if (!requested || *requested == 0)
+                return server;
+            return server == 0 ? *requested : std::min(server, *requested);
+        }
+
+#ifdef LEXTREE_HAS_UNIX_SOCKETS
+        // clears the way for bind(): only a socket nobody answers on is left over from a killed server and can go.
+        // False when something else is at `path`, a live server or any other file.
+        bool remove_stale_socket(const std::string &path)
+        {
+            struct stat info;
+            if (::lstat(path.c_str(), &info) != 0)
+                return errno == ENOENT;
+            if (!S_ISSOCK(info.st_mode))
+                return false;
+            if (std::optional<int> live = Connection::connect(path))
+            {
+                ::close(*live);
+                return false;
+            }
+            return ::unlink(path.c_str()) == 0;
+        }
+#endif
+    }
+
+    void Server::handle(int fd)
+    {
+        Connection connection(fd);
+        connection.set_read_deadline(options.request_timeout, &stopping);
+        FrameWriter writer(connection);
+        ChannelBuffer out_buffer(writer, 'o');
+        ChannelBuffer err_buffer(writer, 'e');
+        std::ostream out(&out_buffer);
+        std::ostream err(&err_buffer);
+
+        Engine::Status status = Engine::Status::IO_ERROR;
+        std::string error;
+        std::optional<Request> request = connection.read_request(error);
+        if (!request)
+            err << error << std::endl;
+        else
+        {
+            std::string source = request->source;
+            bool readable = request->has_source;
+            if (!readable)
+            {
+                std::ifstream file(request->path);
+                std::stringstream buffer;
+                buffer << file.rdbuf();
+                source = buffer.str();
+                readable = file.is_open();
+                if (!readable)
+                    err << "Could not open file: " << request->path << std::endl;
+            }
+
+            if (readable)
+            {
+                EngineOptions engine_options = options.engine;
+                engine_options.memory_limit = tighter(engine_options.memory_limit, request->memory_limit);
+                engine_options.step_limit = tighter(engine_options.step_limit, request->step_limit);
+                engine_options.time_limit_ms = tighter(engine_options.time_limit_ms, request->time_limit_ms);
+
+                Engine engine(engine_options, out, err);
+                writer.engine = &engine;
+                if (options.prelude)
+                    engine.fork(options.prelude);
+                ProgramPtr program = programs.get(source, engine_options, request->path);
+
+                status = engine.run(program);
+                writer.engine = nullptr;
+            }
+        }
+
+        out.flush();
+        err.flush();
+        writer.flush();
+        if (!writer.disconnected)
+            connection.write_all("status " + std::to_string(static_cast<int>(status)) + "\n");
+        served++;
+    }
+
+    int Server::serve(const std::string &socket_path)
+    {
+#ifdef LEXTREE_HAS_UNIX_SOCKETS
+        sockaddr_un address{};
+        if (socket_path.size() >= sizeof(address.sun_path))
+        {
+            std::fprintf(stderr, "Socket path too long: %s\n", socket_path.c_str());
+            return 74;
+        }
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+        if (!remove_stale_socket(socket_path))
+        {
+            std::fprintf(stderr, "Address in use: %s\n", socket_path.c_str());
+            return 74;
+        }
+
+        int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+            ::listen(listener, 128) != 0)
+        {
+            std::fprintf(stderr, "Could not listen on: %s (%s)\n", socket_path.c_str(), std::strerror(errno));
+            if (listener >= 0)
+                ::close(listener);
+            return 74;
+        }
+
+        {
+            ThreadPool pool(options.jobs);
+            while (!stopping.load())
+            {
+                // poll with a timeout so stop() is noticed without another connection coming in
+                pollfd waiting{listener, POLLIN, 0};
+                if (::poll(&waiting, 1, 200) <= 0)
+                    continue;
+                int client = ::accept(listener, nullptr, nullptr);
+                if (client < 0)
+                    continue;
+                pool.submit([this, client] { handle(client); });
+            }
+            pool.wait();
+        }
+
+        ::close(listener);
+        ::unlink(socket_path.c_str());
+        return 0;
+#else
+        std::fprintf(stderr, "--serve needs Unix domain sockets, which this platform does not have: %s\n",
+                     socket_path.c_str());
+        return 74;
+#endif
+    }
+}
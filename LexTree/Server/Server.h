@@ -0,0 +1,51 @@
+#pragma once
+
+#include "../Engine.h"
+#include "../Cache/ProgramCache.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+namespace lex
+{
+    /*
+     * Local script execution daemon (`lextree --serve <socket>`): accepts requests on a Unix domain socket
+     * (format in Protocol.h) and runs them concurrently on a ThreadPool. Every request gets a fresh Engine, but the
+     * expensive parts stay warm: compiled programs come from one ProgramCache shared by all workers and a prelude
+     * snapshot is forked instead of executed.
+     */
+    class Server
+    {
+    public:
+        struct Options
+        {
+            EngineOptions engine; // the limits in here are ceilings, a request can only ask for lower ones
+            size_t jobs = std::thread::hardware_concurrency();
+            Snapshot prelude;           // when set, every request starts with these globals
+            // a client that has not sent its whole request by then is dropped, so it cannot hold a worker
+            std::chrono::milliseconds request_timeout{5000};
+        };
+
+        explicit Server(Options options) : options(std::move(options)) {}
+
+        // listens on `socket_path` until stop(); returns the exit code. A socket file left by a killed server is
+        // replaced, anything else at the path (a running server, a regular file) is "Address in use".
+        int serve(const std::string &socket_path);
+
+        // makes serve() return after the requests in progress, callable from any thread or a signal handler
+        void stop() { stopping.store(true); }
+
+        size_t requests() const { return served.load(); }
+        const ProgramCache &program_cache() const { return programs; }
+
+    private:
+        Options options;
+        ProgramCache programs;
+        std::atomic<bool> stopping{false};
+        std::atomic<size_t> served{0};
+
+        void handle(int fd);
+    };
+}
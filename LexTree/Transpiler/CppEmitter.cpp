@@ -0,0 +1,463 @@
+#include "CppEmitter.h"
+#include <iomanip>
+
+namespace lex
+{
+    namespace
+    {
+        // runtime shipped inside every generated file, mirrors Value.h and the Interpreter's semantics
+        const char *RUNTIME = R"RUNTIME(#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <variant>
+
+namespace lexrt
+{
+    using Value = std::variant<std::monostate, bool, double, std::string>;
+
+    struct RuntimeError : public std::runtime_error
+    {
+        int line;
+        RuntimeError(int line, const std::string &message) : std::runtime_error(message), line(line) {}
+    };
+
+    struct Global
+    {
+        Value value;
+        bool defined = false;
+    };
+
+    // braced initialization evaluates left to right, function arguments do not
+    struct Operands
+    {
+        Value left;
+        Value right;
+    };
+
+    inline bool is_truthy(const Value &value)
+    {
+        if (std::holds_alternative<std::monostate>(value))
+            return false;
+        if (std::holds_alternative<bool>(value))
+            return std::get<bool>(value);
+        return true;
+    }
+
+    inline bool values_equal(const Value &a, const Value &b)
+    {
+        if (a.index() != b.index())
+            return false;
+        if (std::holds_alternative<std::monostate>(a))
+            return true;
+        if (std::holds_alternative<bool>(a))
+            return std::get<bool>(a) == std::get<bool>(b);
+        if (std::holds_alternative<double>(a))
+            return std::get<double>(a) == std::get<double>(b);
+        return std::get<std::string>(a) == std::get<std::string>(b);
+    }
+
+    inline std::string value_to_string(const Value &value)
+    {
+        if (std::holds_alternative<std::monostate>(value))
+            return "nil";
+        if (std::holds_alternative<bool>(value))
+            return std::get<bool>(value) ? "true" : "false";
+        if (std::holds_alternative<double>(value))
+        {
+            std::string text = std::to_string(std::get<double>(value));
+            if (text.find('.') != std::string::npos)
+            {
+                text = text.substr(0, text.find_last_not_of('0') + 1);
+                if (text.back() == '.')
+                    text = text.substr(0, text.size() - 1);
+            }
+            return text;
+        }
+        return std::get<std::string>(value);
+    }
+
+    inline Value read(const Value &value, const char *name, int line)
+    {
+        if (std::holds_alternative<std::monostate>(value))
+            throw RuntimeError(line, std::string("Uninitialized variable: ") + name);
+        return value;
+    }
+
+    inline Value get(const Global &global, const char *name, int line)
+    {
+        if (!global.defined)
+            throw RuntimeError(line, std::string("Undefined variable: ") + name);
+        return read(global.value, name, line);
+    }
+
+    inline Value assign(Global &global, const char *name, int line, Value value)
+    {
+        if (!global.defined)
+            throw RuntimeError(line, std::string("Undefined variable: ") + name);
+        global.value = value;
+        return value;
+    }
+
+    inline void define(Global &global, Value value)
+    {
+        global.value = std::move(value);
+        global.defined = true;
+    }
+
+    inline void check_numbers(const Operands &operands, int line)
+    {
+        if (!std::holds_alternative<double>(operands.left) || !std::holds_alternative<double>(operands.right))
+            throw RuntimeError(line, "Operands must be numbers.");
+    }
+
+    inline double left(const Operands &operands) { return std::get<double>(operands.left); }
+    inline double right(const Operands &operands) { return std::get<double>(operands.right); }
+
+    inline Value add(const Operands &o, int line)
+    {
+        if (std::holds_alternative<double>(o.left) && std::holds_alternative<double>(o.right))
+            return left(o) + right(o);
+        if (std::holds_alternative<std::string>(o.left) && std::holds_alternative<std::string>(o.right))
+            return std::get<std::string>(o.left) + std::get<std::string>(o.right);
+        if (std::holds_alternative<std::string>(o.left))
+            return std::get<std::string>(o.left) + value_to_string(o.right);
+        if (std::holds_alternative<std::string>(o.right))
+            return value_to_string(o.left) + std::get<std::string>(o.right);
+        throw RuntimeError(line, "Operands must be two numbers or two strings.");
+    }
+
+    inline Value subtract(const Operands &o, int line) { check_numbers(o, line); return left(o) - right(o); }
+    inline Value multiply(const Operands &o, int line) { check_numbers(o, line); return left(o) * right(o); }
+    inline Value divide(const Operands &o, int line)
+    {
+        check_numbers(o, line);
+        if (right(o) == 0.0)
+            throw RuntimeError(line, "Division by zero.");
+        return left(o) / right(o);
+    }
+    inline Value greater(const Operands &o, int line) { check_numbers(o, line); return left(o) > right(o); }
+    inline Value greater_equal(const Operands &o, int line) { check_numbers(o, line); return left(o) >= right(o); }
+    inline Value less(const Operands &o, int line) { check_numbers(o, line); return left(o) < right(o); }
+    inline Value less_equal(const Operands &o, int line) { check_numbers(o, line); return left(o) <= right(o); }
+    inline Value equal(const Operands &o) { return values_equal(o.left, o.right); }
+    inline Value not_equal(const Operands &o) { return !values_equal(o.left, o.right); }
+
+    inline Value negate(const Value &value, int line)
+    {
+        if (!std::holds_alternative<double>(value))
+            throw RuntimeError(line, "Operand must be a number.");
+        return -std::get<double>(value);
+    }
+
+    inline Value logical_not(const Value &value) { return !is_truthy(value); }
+
+    inline void print(const Value &value) { std::cout << value_to_string(value) << std::endl; }
+
+    inline void report(const RuntimeError &error)
+    {
+        std::cerr << error.what() << "\n[line " << error.line << "]" << std::endl;
+    }
+}
+)RUNTIME";
+
+        std::string quote(const std::string &text)
+        {
+            std::ostringstream oss;
+            oss << '"';
+            for (unsigned char c : text)
+            {
+                switch (c)
+                {
+                case '"':
+                    oss << "\\\"";
+                    break;
+                case '\\':
+                    oss << "\\\\";
+                    break;
+                case '\n':
+                    oss << "\\n";
+                    break;
+                case '\t':
+                    oss << "\\t";
+                    break;
+                case '\r':
+                    oss << "\\r";
+                    break;
+                default:
+                    if (c < 0x20 || c >= 0x7f)
+                        oss << '\\' << std::oct << std::setw(3) << std::setfill('0') << static_cast<int>(c) << std::dec;
+                    else
+                        oss << c;
+                }
+            }
+            oss << '"';
+            return oss.str();
+        }
+
+        const char *binary_helper(TokenType type)
+        {
+            switch (type)
+            {
+            case TokenType::PLUS:
+                return "add";
+            case TokenType::MINUS:
+                return "subtract";
+            case TokenType::STAR:
+                return "multiply";
+            case TokenType::SLASH:
+                return "divide";
+            case TokenType::GREATER:
+                return "greater";
+            case TokenType::GREATER_EQUAL:
+                return "greater_equal";
+            case TokenType::LESS:
+                return "less";
+            case TokenType::LESS_EQUAL:
+                return "less_equal";
+            case TokenType::BANG_EQUAL:
+                return "not_equal";
+            default:
+                return "equal";
+            }
+        }
+    }
+
+    std::string CppEmitter::emit(const std::vector<StmtPtr> &statements)
+    {
+        body.str("");
+        scopes.clear();
+        globals.clear();
+        indent_level = 1;
+        next_local = 0;
+
+        for (const auto &stmt : statements)
+        {
+            // like Interpreter::interpret, a runtime error only aborts the current top-level statement
+            line() << "try\n";
+            line() << "{\n";
+            ++indent_level;
+            statement(stmt);
+            --indent_level;
+            line() << "}\n";
+            line() << "catch (const lexrt::RuntimeError &error)\n";
+            line() << "{\n";
+            line() << "    lexrt::report(error);\n";
+            line() << "    had_runtime_error = true;\n";
+            line() << "}\n";
+        }
+
+        std::ostringstream out;
+        out << "// generated by lextree --emit-cpp\n";
+        out << RUNTIME << "\n";
+        for (const auto &name : globals)
+            out << "static lexrt::Global g_" << name << ";\n";
+        out << "\nint main()\n{\n";
+        out << "    bool had_runtime_error = false;\n\n";
+        out << body.str();
+        out << "\n    return had_runtime_error ? 70 : 0;\n}\n";
+        return out.str();
+    }
+
+    std::ostringstream &CppEmitter::line()
+    {
+        body << std::string(indent_level * 4, ' ');
+        return body;
+    }
+
+    std::string CppEmitter::expression(const ExprPtr &expr)
+    {
+        return std::any_cast<std::string>(expr->accept(this));
+    }
+
+    void CppEmitter::statement(const StmtPtr &stmt)
+    {
+        stmt->accept(this);
+    }
+
+    const CppEmitter::Local *CppEmitter::resolve(const std::string &name) const
+    {
+        for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope)
+        {
+            for (auto local = scope->rbegin(); local != scope->rend(); ++local)
+            {
+                if (local->name == name)
+                    return &*local;
+            }
+        }
+        return nullptr;
+    }
+
+    std::string CppEmitter::global(const std::string &name)
+    {
+        globals.insert(name);
+        return "g_" + name;
+    }
+
+    // Statements
+
+    void CppEmitter::visitExpressionStmt(ExpressionStmt *stmt)
+    {
+        line() << "(void)(" << expression(stmt->expression) << ");\n";
+    }
+
+    void CppEmitter::visitPrintStmt(PrintStmt *stmt)
+    {
+        line() << "lexrt::print(" << expression(stmt->expression) << ");\n";
+    }
+
+    void CppEmitter::visitVariableStmt(VariableStmt *stmt)
+    {
+        // the initializer is translated before the name is declared: `var a = a;` reads the outer a
+        std::string initializer = stmt->initializer ? expression(stmt->initializer) : "lexrt::Value()";
+        const std::string &name = stmt->name.lexeme;
+
+        if (scopes.empty())
+        {
+            line() << "lexrt::define(" << global(name) << ", " << initializer << ");\n";
+            return;
+        }
+
+        std::string identifier = "l_" + name + "_" + std::to_string(next_local++);
+        line() << "lexrt::Value " << identifier << " = " << initializer << ";\n";
+        scopes.back().push_back(Local{name, identifier});
+    }
+
+    void CppEmitter::visitBlockStmt(BlockStmt *stmt)
+    {
+        line() << "{\n";
+        ++indent_level;
+        scopes.emplace_back();
+        for (const auto &statement : stmt->statements)
+            this->statement(statement);
+        scopes.pop_back();
+        --indent_level;
+        line() << "}\n";
+    }
+
+    void CppEmitter::visitIfStmt(IfStmt *stmt)
+    {
+        line() << "if (lexrt::is_truthy(" << expression(stmt->condition) << "))\n";
+        line() << "{\n";
+        ++indent_level;
+        statement(stmt->then_branch);
+        --indent_level;
+        line() << "}\n";
+
+        if (stmt->else_branch)
+        {
+            line() << "else\n";
+            line() << "{\n";
+            ++indent_level;
+            statement(stmt->else_branch);
+            --indent_level;
+            line() << "}\n";
+        }
+    }
+
+    void CppEmitter::visitWhileStmt(WhileStmt *stmt)
+    {
+        line() << "while (lexrt::is_truthy(" << expression(stmt->condition) << "))\n";
+        line() << "{\n";
+        ++indent_level;
+        statement(stmt->body);
+        --indent_level;
+        line() << "}\n";
+    }
+
+    void CppEmitter::visitForStmt(ForStmt *stmt)
+    {
+        // the initializer lives in the enclosing scope, exactly like Interpreter::visitForStmt
+        if (stmt->initializer)
+            statement(stmt->initializer);
+
+        std::string condition = stmt->condition ? "lexrt::is_truthy(" + expression(stmt->condition) + ")" : "true";
+        line() << "while (" << condition << ")\n";
+        line() << "{\n";
+        ++indent_level;
+        statement(stmt->body);
+        if (stmt->increment)
+            line() << "(void)(" << expression(stmt->increment) << ");\n";
+        --indent_level;
+        line() << "}\n";
+    }
+
+    // Expressions
+
+    std::any CppEmitter::visitLiteralExpr(Literal *expr)
+    {
+        if (std::holds_alternative<double>(expr->value))
+        {
+            // hexfloat keeps the exact bit pattern of the number
+            std::ostringstream oss;
+            oss << "lexrt::Value(" << std::hexfloat << std::get<double>(expr->value) << ")";
+            return oss.str();
+        }
+        if (std::holds_alternative<std::string>(expr->value))
+            return "lexrt::Value(std::string(" + quote(std::get<std::string>(expr->value)) + "))";
+        if (std::holds_alternative<bool>(expr->value))
+            return std::string(std::get<bool>(expr->value) ? "lexrt::Value(true)" : "lexrt::Value(false)");
+        return std::string("lexrt::Value()");
+    }
+
+    std::any CppEmitter::visitGroupingExpr(Grouping *expr)
+    {
+        return "(" + expression(expr->expression) + ")";
+    }
+
+    std::any CppEmitter::visitVariableExpr(Variable *expr)
+    {
+        const std::string &name = expr->name.lexeme;
+        std::string line_number = std::to_string(expr->name.line);
+
+        if (const Local *local = resolve(name))
+            return "lexrt::read(" + local->identifier + ", \"" + name + "\", " + line_number + ")";
+        return "lexrt::get(" + global(name) + ", \"" + name + "\", " + line_number + ")";
+    }
+
+    std::any CppEmitter::visitAssignExpr(Assign *expr)
+    {
+        const std::string &name = expr->name.lexeme;
+        std::string value = expression(expr->value);
+
+        if (const Local *local = resolve(name))
+            return "lexrt::Value(" + local->identifier + " = " + value + ")";
+        return "lexrt::assign(" + global(name) + ", \"" + name + "\", " + std::to_string(expr->name.line) + ", " + value + ")";
+    }
+
+    std::any CppEmitter::visitUnaryExpr(Unary *expr)
+    {
+        std::string right = expression(expr->right);
+        if (expr->operator_token.type == TokenType::BANG)
+            return "lexrt::logical_not(" + right + ")";
+        return "lexrt::negate(" + right + ", " + std::to_string(expr->operator_token.line) + ")";
+    }
+
+    std::any CppEmitter::visitBinaryExpr(Binary *expr)
+    {
+        std::string left = expression(expr->left);
+        std::string right = expression(expr->right);
+
+        if (expr->operator_token.type == TokenType::COMMA)
+            return "((void)(" + left + "), " + right + ")";
+
+        std::string helper = binary_helper(expr->operator_token.type);
+        std::string operands = "lexrt::Operands{" + left + ", " + right + "}";
+        if (helper == "equal" || helper == "not_equal")
+            return "lexrt::" + helper + "(" + operands + ")";
+        return "lexrt::" + helper + "(" + operands + ", " + std::to_string(expr->operator_token.line) + ")";
+    }
+
+    std::any CppEmitter::visitTernaryExpr(Ternary *expr)
+    {
+        return "(lexrt::is_truthy(" + expression(expr->condition) + ") ? " + expression(expr->then_branch) +
+               " : " + expression(expr->else_branch) + ")";
+    }
+
+    std::any CppEmitter::visitLogicalExpr(Logical *expr)
+    {
+        // short-circuit: `or` keeps a truthy left, `and` keeps a falsey left
+        std::string keep_left = expr->operator_token.type == TokenType::OR ? "lexrt::is_truthy(left)" : "!lexrt::is_truthy(left)";
+        return "[&]() -> lexrt::Value { lexrt::Value left = " + expression(expr->left) + "; return " + keep_left +
+               " ? left : " + expression(expr->right) + "; }()";
+    }
+}
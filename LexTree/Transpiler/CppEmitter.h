@@ -0,0 +1,60 @@
+#pragma once
+
+#include "../Parser/Expr.h"
+#include "../Parser/Stmt.h"
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace lex
+{
+    /*
+     * Ahead-of-time translation of a parsed program into a standalone C++ translation unit.
+     * The generated code carries its own small runtime (Value, truthiness, printing, runtime errors)
+     * so it only needs the standard library to build: `lextree --emit-cpp s.lex > s.cpp && c++ -std=c++20 -O2 s.cpp`
+     */
+    class CppEmitter : public ExprVisitor, public StmtVisitor
+    {
+    public:
+        std::string emit(const std::vector<StmtPtr> &statements);
+
+        // Visit methods from ExprVisitor, each returns the C++ expression as a std::string
+        std::any visitBinaryExpr(Binary *expr) override;
+        std::any visitGroupingExpr(Grouping *expr) override;
+        std::any visitLiteralExpr(Literal *expr) override;
+        std::any visitUnaryExpr(Unary *expr) override;
+        std::any visitTernaryExpr(Ternary *expr) override;
+        std::any visitVariableExpr(Variable *expr) override;
+        std::any visitAssignExpr(Assign *expr) override;
+        std::any visitLogicalExpr(Logical *expr) override;
+
+        // Visit methods from StmtVisitor, each writes the C++ statement to `body`
+        void visitExpressionStmt(ExpressionStmt *stmt) override;
+        void visitPrintStmt(PrintStmt *stmt) override;
+        void visitVariableStmt(VariableStmt *stmt) override;
+        void visitBlockStmt(BlockStmt *stmt) override;
+        void visitIfStmt(IfStmt *stmt) override;
+        void visitWhileStmt(WhileStmt *stmt) override;
+        void visitForStmt(ForStmt *stmt) override;
+
+    private:
+        struct Local
+        {
+            std::string name;
+            std::string identifier; // mangled C++ name
+        };
+
+        std::ostringstream body;
+        std::vector<std::vector<Local>> scopes;
+        std::set<std::string> globals;
+        int indent_level = 1;
+        int next_local = 0;
+
+        std::string expression(const ExprPtr &expr);
+        void statement(const StmtPtr &stmt);
+        std::ostringstream &line();
+        const Local *resolve(const std::string &name) const;
+        std::string global(const std::string &name);
+    };
+}
@@ -0,0 +1,550 @@
+#include "Compiler.h"
+#include <algorithm>
+#include <cmath>
+
+namespace lex
+{
+    namespace
+    {
+        Value literal_to_value(const LiteralValue &literal)
+        {
+            if (std::holds_alternative<double>(literal))
+                return Value(std::get<double>(literal));
+            if (std::holds_alternative<std::string>(literal))
+                return Value(std::get<std::string>(literal));
+            if (std::holds_alternative<bool>(literal))
+                return Value(std::get<bool>(literal));
+            return Value(std::monostate{});
+        }
+
+        const Expr *unwrap_grouping(const Expr *expr)
+        {
+            while (auto grouping = dynamic_cast<const Grouping *>(expr))
+                expr = grouping->expression.get();
+            return expr;
+        }
+
+        // true when the expression can never produce nil (reading a nil variable is already an error)
+        bool never_nil(const Expr *expr)
+        {
+            expr = unwrap_grouping(expr);
+            if (auto literal = dynamic_cast<const Literal *>(expr))
+                return !std::holds_alternative<std::monostate>(literal->value);
+            if (auto binary = dynamic_cast<const Binary *>(expr))
+                return binary->operator_token.type != TokenType::COMMA || never_nil(binary->right.get());
+            if (auto assign = dynamic_cast<const Assign *>(expr))
+                return never_nil(assign->value.get());
+            if (auto ternary = dynamic_cast<const Ternary *>(expr))
+                return never_nil(ternary->then_branch.get()) && never_nil(ternary->else_branch.get());
+            if (auto logical = dynamic_cast<const Logical *>(expr))
+            {
+                if (logical->operator_token.type == TokenType::OR)
+                    return never_nil(logical->right.get());
+                return never_nil(logical->left.get()) && never_nil(logical->right.get());
+            }
+            return true; // Unary and Variable
+        }
+
+        bool has_assignment(const Expr *expr)
+        {
+            if (expr == nullptr)
+                return false;
+            if (dynamic_cast<const Assign *>(expr))
+                return true;
+            if (auto binary = dynamic_cast<const Binary *>(expr))
+                return has_assignment(binary->left.get()) || has_assignment(binary->right.get());
+            if (auto logical = dynamic_cast<const Logical *>(expr))
+                return has_assignment(logical->left.get()) || has_assignment(logical->right.get());
+            if (auto grouping = dynamic_cast<const Grouping *>(expr))
+                return has_assignment(grouping->expression.get());
+            if (auto unary = dynamic_cast<const Unary *>(expr))
+                return has_assignment(unary->right.get());
+            if (auto ternary = dynamic_cast<const Ternary *>(expr))
+                return has_assignment(ternary->condition.get()) || has_assignment(ternary->then_branch.get()) ||
+                       has_assignment(ternary->else_branch.get());
+            return false;
+        }
+
+        void collect_nil_assignments(const Expr *expr, std::set<std::string> &names)
+        {
+            if (expr == nullptr)
+                return;
+            if (auto assign = dynamic_cast<const Assign *>(expr))
+            {
+                if (!never_nil(assign->value.get()))
+                    names.insert(assign->name.lexeme);
+                collect_nil_assignments(assign->value.get(), names);
+            }
+            else if (auto binary = dynamic_cast<const Binary *>(expr))
+            {
+                collect_nil_assignments(binary->left.get(), names);
+                collect_nil_assignments(binary->right.get(), names);
+            }
+            else if (auto logical = dynamic_cast<const Logical *>(expr))
+            {
+                collect_nil_assignments(logical->left.get(), names);
+                collect_nil_assignments(logical->right.get(), names);
+            }
+            else if (auto grouping = dynamic_cast<const Grouping *>(expr))
+                collect_nil_assignments(grouping->expression.get(), names);
+            else if (auto unary = dynamic_cast<const Unary *>(expr))
+                collect_nil_assignments(unary->right.get(), names);
+            else if (auto ternary = dynamic_cast<const Ternary *>(expr))
+            {
+                collect_nil_assignments(ternary->condition.get(), names);
+                collect_nil_assignments(ternary->then_branch.get(), names);
+                collect_nil_assignments(ternary->else_branch.get(), names);
+            }
+        }
+
+        void collect_nil_assignments(const Stmt *stmt, std::set<std::string> &names)
+        {
+            if (stmt == nullptr)
+                return;
+            if (auto expression = dynamic_cast<const ExpressionStmt *>(stmt))
+                collect_nil_assignments(expression->expression.get(), names);
+            else if (auto print = dynamic_cast<const PrintStmt *>(stmt))
+                collect_nil_assignments(print->expression.get(), names);
+            else if (auto variable = dynamic_cast<const VariableStmt *>(stmt))
+                collect_nil_assignments(variable->initializer.get(), names);
+            else if (auto block = dynamic_cast<const BlockStmt *>(stmt))
+            {
+                for (const auto &statement : block->statements)
+                    collect_nil_assignments(statement.get(), names);
+            }
+            else if (auto if_stmt = dynamic_cast<const IfStmt *>(stmt))
+            {
+                collect_nil_assignments(if_stmt->condition.get(), names);
+                collect_nil_assignments(if_stmt->then_branch.get(), names);
+                collect_nil_assignments(if_stmt->else_branch.get(), names);
+            }
+            else if (auto while_stmt = dynamic_cast<const WhileStmt *>(stmt))
+            {
+                collect_nil_assignments(while_stmt->condition.get(), names);
+                collect_nil_assignments(while_stmt->body.get(), names);
+            }
+            else if (auto for_stmt = dynamic_cast<const ForStmt *>(stmt))
+            {
+                collect_nil_assignments(for_stmt->initializer.get(), names);
+                collect_nil_assignments(for_stmt->condition.get(), names);
+                collect_nil_assignments(for_stmt->increment.get(), names);
+                collect_nil_assignments(for_stmt->body.get(), names);
+            }
+        }
+    }
+
+    Chunk Compiler::compile(const std::vector<StmtPtr> &statements)
+    {
+        chunk = Chunk();
+        scopes.clear();
+        next_register = 0;
+        locals_top = 0;
+
+        for (const auto &statement : statements)
+        {
+            compile_statement(statement);
+            chunk.statement_ends.push_back(static_cast<uint32_t>(chunk.code.size()));
+        }
+        emit(OpCode::HALT);
+
+        return std::move(chunk);
+    }
+
+    uint32_t Compiler::emit(OpCode op, uint32_t a, uint32_t b, uint32_t c, uint32_t token)
+    {
+        chunk.code.push_back(Instruction{op, a, b, c, token});
+        return static_cast<uint32_t>(chunk.code.size() - 1);
+    }
+
+    uint32_t Compiler::add_constant(const Value &value)
+    {
+        // small programs, a linear scan keeps the constant table free of duplicates. Numbers by their bits, -0 is
+        // equal to 0 but prints differently.
+        for (size_t i = 0; i < chunk.constants.size(); ++i)
+        {
+            const Value &constant = chunk.constants[i];
+            if (constant.index() != value.index())
+                continue;
+            bool same = std::holds_alternative<double>(value)
+                            ? std::signbit(std::get<double>(constant)) == std::signbit(std::get<double>(value)) &&
+                                  values_equal(constant, value)
+                            : values_equal(constant, value);
+            if (same)
+                return static_cast<uint32_t>(i) | K_BIT;
+        }
+        chunk.constants.push_back(value);
+        return static_cast<uint32_t>(chunk.constants.size() - 1) | K_BIT;
+    }
+
+    uint32_t Compiler::add_token(const Token &token)
+    {
+        chunk.tokens.push_back(token);
+        return static_cast<uint32_t>(chunk.tokens.size() - 1);
+    }
+
+    void Compiler::patch_jump(uint32_t at, uint32_t target)
+    {
+        Instruction &instruction = chunk.code[at];
+        if (instruction.op == OpCode::JUMP)
+            instruction.a = target;
+        else
+            instruction.b = target;
+    }
+
+    uint32_t Compiler::alloc_register()
+    {
+        uint32_t reg = next_register++;
+        chunk.register_count = std::max(chunk.register_count, next_register);
+        return reg;
+    }
+
+    bool Compiler::is_temporary(uint32_t reg) const
+    {
+        return reg >= locals_top;
+    }
+
+    const Compiler::Local *Compiler::resolve(const std::string &name) const
+    {
+        for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope)
+        {
+            for (auto local = scope->locals.rbegin(); local != scope->locals.rend(); ++local)
+            {
+                if (local->name == name)
+                    return &*local;
+            }
+        }
+        return nullptr; // global
+    }
+
+    uint32_t Compiler::operand(const ExprPtr &expr)
+    {
+        destination = NO_DEST;
+        return std::any_cast<uint32_t>(expr->accept(this));
+    }
+
+    uint32_t Compiler::to_register(const ExprPtr &expr, uint32_t dest)
+    {
+        destination = dest;
+        uint32_t result = std::any_cast<uint32_t>(expr->accept(this));
+        return materialize(result, dest);
+    }
+
+    uint32_t Compiler::materialize(uint32_t operand, uint32_t dest)
+    {
+        if (operand & K_BIT)
+        {
+            uint32_t reg = dest == NO_DEST ? alloc_register() : dest;
+            emit(OpCode::LOAD_CONST, reg, operand & ~K_BIT);
+            return reg;
+        }
+        if (dest != NO_DEST && operand != dest)
+        {
+            emit(OpCode::MOVE, dest, operand);
+            return dest;
+        }
+        return operand;
+    }
+
+    // Statements
+
+    void Compiler::compile_statement(const StmtPtr &stmt)
+    {
+        stmt->accept(this);
+        next_register = locals_top; // temporaries die at the end of every statement
+    }
+
+    void Compiler::compile_block(const std::vector<StmtPtr> &statements)
+    {
+        Scope scope;
+        for (const auto &statement : statements)
+            collect_nil_assignments(statement.get(), scope.nil_assigned);
+        scopes.push_back(std::move(scope));
+        uint32_t saved_top = locals_top;
+
+        for (const auto &statement : statements)
+            compile_statement(statement);
+
+        scopes.pop_back();
+        locals_top = saved_top;
+        next_register = saved_top;
+    }
+
+    void Compiler::declare(const Token &name, const ExprPtr &initializer)
+    {
+        if (scopes.empty())
+        {
+            uint32_t value;
+            if (initializer != nullptr)
+                value = to_register(initializer);
+            else
+                emit(OpCode::LOAD_NIL, value = alloc_register());
+            emit(OpCode::DEFINE_GLOBAL, value, 0, 0, add_token(name));
+            return;
+        }
+
+        // reserve the slot first so the initializer's temporaries live above it,
+        // the name only becomes visible after the initializer (`var a = a;` reads the outer a)
+        uint32_t reg = alloc_register();
+        locals_top = next_register;
+        if (initializer != nullptr)
+            to_register(initializer, reg);
+        else
+            emit(OpCode::LOAD_NIL, reg);
+
+        bool may_be_nil = initializer == nullptr || !never_nil(initializer.get()) ||
+                          scopes.back().nil_assigned.count(name.lexeme) > 0;
+        scopes.back().locals.push_back(Local{name.lexeme, reg, may_be_nil});
+    }
+
+    void Compiler::visitExpressionStmt(ExpressionStmt *stmt)
+    {
+        operand(stmt->expression);
+    }
+
+    void Compiler::visitPrintStmt(PrintStmt *stmt)
+    {
+        emit(OpCode::PRINT, operand(stmt->expression));
+    }
+
+    void Compiler::visitVariableStmt(VariableStmt *stmt)
+    {
+        declare(stmt->name, stmt->initializer);
+    }
+
+    void Compiler::visitBlockStmt(BlockStmt *stmt)
+    {
+        compile_block(stmt->statements);
+    }
+
+    void Compiler::visitIfStmt(IfStmt *stmt)
+    {
+        uint32_t condition = to_register(stmt->condition);
+        uint32_t jump_to_else = emit(OpCode::JUMP_IF_FALSE, condition);
+        compile_statement(stmt->then_branch);
+
+        if (stmt->else_branch)
+        {
+            uint32_t jump_to_end = emit(OpCode::JUMP);
+            patch_jump(jump_to_else, static_cast<uint32_t>(chunk.code.size()));
+            compile_statement(stmt->else_branch);
+            patch_jump(jump_to_end, static_cast<uint32_t>(chunk.code.size()));
+        }
+        else
+        {
+            patch_jump(jump_to_else, static_cast<uint32_t>(chunk.code.size()));
+        }
+    }
+
+    void Compiler::visitWhileStmt(WhileStmt *stmt)
+    {
+        uint32_t loop_start = static_cast<uint32_t>(chunk.code.size());
+        uint32_t condition = to_register(stmt->condition);
+        uint32_t exit_jump = emit(OpCode::JUMP_IF_FALSE, condition);
+        next_register = locals_top;
+
+        compile_statement(stmt->body);
+        emit(OpCode::LOOP, loop_start);
+        patch_jump(exit_jump, static_cast<uint32_t>(chunk.code.size()));
+    }
+
+    void Compiler::visitForStmt(ForStmt *stmt)
+    {
+        // the initializer runs in the enclosing scope, exactly like Interpreter::visitForStmt
+        if (stmt->initializer != nullptr)
+            compile_statement(stmt->initializer);
+
+        uint32_t loop_start = static_cast<uint32_t>(chunk.code.size());
+        uint32_t exit_jump = NO_DEST;
+        if (stmt->condition != nullptr)
+        {
+            uint32_t condition = to_register(stmt->condition);
+            exit_jump = emit(OpCode::JUMP_IF_FALSE, condition);
+            next_register = locals_top;
+        }
+
+        compile_statement(stmt->body);
+        if (stmt->increment != nullptr)
+        {
+            operand(stmt->increment);
+            next_register = locals_top;
+        }
+        emit(OpCode::LOOP, loop_start);
+
+        if (exit_jump != NO_DEST)
+            patch_jump(exit_jump, static_cast<uint32_t>(chunk.code.size()));
+    }
+
+    // Expressions
+
+    std::any Compiler::visitLiteralExpr(Literal *expr)
+    {
+        destination = NO_DEST;
+        return add_constant(literal_to_value(expr->value));
+    }
+
+    std::any Compiler::visitGroupingExpr(Grouping *expr)
+    {
+        // transparent, the requested destination passes through
+        return expr->expression->accept(this);
+    }
+
+    std::any Compiler::visitVariableExpr(Variable *expr)
+    {
+        uint32_t dest = destination;
+        destination = NO_DEST;
+
+        if (const Local *local = resolve(expr->name.lexeme))
+        {
+            if (local->may_be_nil)
+                emit(OpCode::CHECK_INIT, local->reg, 0, 0, add_token(expr->name));
+            return local->reg;
+        }
+
+        uint32_t reg = dest == NO_DEST ? alloc_register() : dest;
+        emit(OpCode::GET_GLOBAL, reg, 0, 0, add_token(expr->name));
+        return reg;
+    }
+
+    std::any Compiler::visitAssignExpr(Assign *expr)
+    {
+        uint32_t dest = destination;
+        destination = NO_DEST;
+
+        if (const Local *local = resolve(expr->name.lexeme))
+        {
+            uint32_t reg = local->reg;
+            // ternaries, logicals and comma write their destination before they finish reading,
+            // so they must not target a live variable directly
+            const Expr *value = unwrap_grouping(expr->value.get());
+            bool writes_early = dynamic_cast<const Ternary *>(value) || dynamic_cast<const Logical *>(value);
+            if (auto binary = dynamic_cast<const Binary *>(value))
+                writes_early = binary->operator_token.type == TokenType::COMMA;
+
+            if (writes_early)
+                emit(OpCode::MOVE, reg, to_register(expr->value));
+            else
+                to_register(expr->value, reg);
+            return reg;
+        }
+
+        uint32_t value = to_register(expr->value, dest);
+        emit(OpCode::SET_GLOBAL, value, 0, 0, add_token(expr->name));
+        return value;
+    }
+
+    std::any Compiler::visitUnaryExpr(Unary *expr)
+    {
+        uint32_t dest = destination;
+        uint32_t right = operand(expr->right);
+        uint32_t reg = dest != NO_DEST                                ? dest
+                       : (!(right & K_BIT) && is_temporary(right)) ? right
+                                                                     : alloc_register();
+
+        OpCode op = expr->operator_token.type == TokenType::BANG ? OpCode::NOT : OpCode::NEGATE;
+        emit(op, reg, right, 0, add_token(expr->operator_token));
+        return reg;
+    }
+
+    std::any Compiler::visitBinaryExpr(Binary *expr)
+    {
+        uint32_t dest = destination;
+        destination = NO_DEST;
+
+        if (expr->operator_token.type == TokenType::COMMA)
+        {
+            operand(expr->left);
+            destination = dest;
+            return expr->right->accept(this);
+        }
+
+        uint32_t left = operand(expr->left);
+        // a variable register read directly could be overwritten by an assignment on the right
+        if (!(left & K_BIT) && !is_temporary(left) && has_assignment(expr->right.get()))
+        {
+            uint32_t copy = alloc_register();
+            emit(OpCode::MOVE, copy, left);
+            left = copy;
+        }
+        uint32_t right = operand(expr->right);
+
+        uint32_t reg = dest;
+        if (reg == NO_DEST)
+        {
+            if (!(left & K_BIT) && is_temporary(left))
+                reg = left;
+            else if (!(right & K_BIT) && is_temporary(right))
+                reg = right;
+            else
+                reg = alloc_register();
+        }
+
+        OpCode op;
+        switch (expr->operator_token.type)
+        {
+        case TokenType::PLUS:
+            op = OpCode::ADD;
+            break;
+        case TokenType::MINUS:
+            op = OpCode::SUBTRACT;
+            break;
+        case TokenType::STAR:
+            op = OpCode::MULTIPLY;
+            break;
+        case TokenType::SLASH:
+            op = OpCode::DIVIDE;
+            break;
+        case TokenType::GREATER:
+            op = OpCode::GREATER;
+            break;
+        case TokenType::GREATER_EQUAL:
+            op = OpCode::GREATER_EQUAL;
+            break;
+        case TokenType::LESS:
+            op = OpCode::LESS;
+            break;
+        case TokenType::LESS_EQUAL:
+            op = OpCode::LESS_EQUAL;
+            break;
+        case TokenType::BANG_EQUAL:
+            op = OpCode::NOT_EQUAL;
+            break;
+        default:
+            op = OpCode::EQUAL;
+            break;
+        }
+
+        emit(op, reg, left, right, add_token(expr->operator_token));
+        return reg;
+    }
+
+    std::any Compiler::visitTernaryExpr(Ternary *expr)
+    {
+        uint32_t dest = destination;
+        destination = NO_DEST;
+        uint32_t reg = dest == NO_DEST ? alloc_register() : dest;
+
+        uint32_t condition = to_register(expr->condition);
+        uint32_t jump_to_else = emit(OpCode::JUMP_IF_FALSE, condition);
+        to_register(expr->then_branch, reg);
+        uint32_t jump_to_end = emit(OpCode::JUMP);
+        patch_jump(jump_to_else, static_cast<uint32_t>(chunk.code.size()));
+        to_register(expr->else_branch, reg);
+        patch_jump(jump_to_end, static_cast<uint32_t>(chunk.code.size()));
+        return reg;
+    }
+
+    std::any Compiler::visitLogicalExpr(Logical *expr)
+    {
+        uint32_t dest = destination;
+        destination = NO_DEST;
+        uint32_t reg = dest == NO_DEST ? alloc_register() : dest;
+
+        to_register(expr->left, reg);
+        // short-circuit: `or` keeps a truthy left, `and` keeps a falsey left
+        OpCode op = expr->operator_token.type == TokenType::OR ? OpCode::JUMP_IF_TRUE : OpCode::JUMP_IF_FALSE;
+        uint32_t jump_to_end = emit(op, reg);
+        to_register(expr->right, reg);
+        patch_jump(jump_to_end, static_cast<uint32_t>(chunk.code.size()));
+        return reg;
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Instruction.h"
+#include "../Parser/Expr.h"
+#include "../Parser/Stmt.h"
+#include <set>
+#include <string>
+#include <vector>
+
+namespace lex
+{
+    /*
+     * Lowers the AST produced by Parser::parse into register VM code.
+     * Variables declared inside blocks are resolved at compile time and live in registers,
+     * top-level variables stay in the global Environment and are accessed by name
+     */
+    class Compiler : public ExprVisitor, public StmtVisitor
+    {
+    public:
+        Chunk compile(const std::vector<StmtPtr> &statements);
+
+        // Visit methods from ExprVisitor, each returns the operand (register or K_BIT|constant) holding the result
+        std::any visitBinaryExpr(Binary *expr) override;
+        std::any visitGroupingExpr(Grouping *expr) override;
+        std::any visitLiteralExpr(Literal *expr) override;
+        std::any visitUnaryExpr(Unary *expr) override;
+        std::any visitTernaryExpr(Ternary *expr) override;
+        std::any visitVariableExpr(Variable *expr) override;
+        std::any visitAssignExpr(Assign *expr) override;
+        std::any visitLogicalExpr(Logical *expr) override;
+
+        // Visit methods from StmtVisitor
+        void visitExpressionStmt(ExpressionStmt *stmt) override;
+        void visitPrintStmt(PrintStmt *stmt) override;
+        void visitVariableStmt(VariableStmt *stmt) override;
+        void visitBlockStmt(BlockStmt *stmt) override;
+        void visitIfStmt(IfStmt *stmt) override;
+        void visitWhileStmt(WhileStmt *stmt) override;
+        void visitForStmt(ForStmt *stmt) override;
+
+    private:
+        struct Local
+        {
+            std::string name;
+            uint32_t reg;
+            bool may_be_nil; // reads need a CHECK_INIT
+        };
+
+        struct Scope
+        {
+            std::vector<Local> locals;
+            std::set<std::string> nil_assigned; // names that get a possibly-nil value somewhere in the block
+        };
+
+        Chunk chunk;
+        std::vector<Scope> scopes;
+        uint32_t next_register = 0;
+        uint32_t locals_top = 0; // registers below this hold declared variables, the rest are temporaries
+        // requested destination of the expression being compiled, or NO_DEST
+        uint32_t destination = NO_DEST;
+
+        static constexpr uint32_t NO_DEST = 0xFFFFFFFFu;
+
+        // emitting
+        uint32_t emit(OpCode op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0, uint32_t token = NO_TOKEN);
+        uint32_t add_constant(const Value &value);
+        uint32_t add_token(const Token &token);
+        void patch_jump(uint32_t at, uint32_t target);
+
+        // registers
+        uint32_t alloc_register();
+        bool is_temporary(uint32_t reg) const;
+
+        // expressions
+        uint32_t operand(const ExprPtr &expr);                                     // register or constant
+        uint32_t to_register(const ExprPtr &expr, uint32_t dest = NO_DEST);        // always a register
+        uint32_t materialize(uint32_t operand, uint32_t dest);                     // move/load an operand into a register
+        const Local *resolve(const std::string &name) const;
+
+        // statements
+        void compile_statement(const StmtPtr &stmt);
+        void compile_block(const std::vector<StmtPtr> &statements);
+        void declare(const Token &name, const ExprPtr &initializer);
+    };
+}
@@ -0,0 +1,124 @@
+#include "Instruction.h"
+#include <sstream>
+
+namespace lex
+{
+    const char *opcode_to_string(OpCode op)
+    {
+        switch (op)
+        {
+        case OpCode::LOAD_CONST:
+            return "LOAD_CONST";
+        case OpCode::LOAD_NIL:
+            return "LOAD_NIL";
+        case OpCode::MOVE:
+            return "MOVE";
+        case OpCode::CHECK_INIT:
+            return "CHECK_INIT";
+        case OpCode::GET_GLOBAL:
+            return "GET_GLOBAL";
+        case OpCode::SET_GLOBAL:
+            return "SET_GLOBAL";
+        case OpCode::DEFINE_GLOBAL:
+            return "DEFINE_GLOBAL";
+        case OpCode::ADD:
+            return "ADD";
+        case OpCode::SUBTRACT:
+            return "SUBTRACT";
+        case OpCode::MULTIPLY:
+            return "MULTIPLY";
+        case OpCode::DIVIDE:
+            return "DIVIDE";
+        case OpCode::GREATER:
+            return "GREATER";
+        case OpCode::GREATER_EQUAL:
+            return "GREATER_EQUAL";
+        case OpCode::LESS:
+            return "LESS";
+        case OpCode::LESS_EQUAL:
+            return "LESS_EQUAL";
+        case OpCode::EQUAL:
+            return "EQUAL";
+        case OpCode::NOT_EQUAL:
+            return "NOT_EQUAL";
+        case OpCode::NEGATE:
+            return "NEGATE";
+        case OpCode::NOT:
+            return "NOT";
+        case OpCode::JUMP:
+            return "JUMP";
+        case OpCode::JUMP_IF_FALSE:
+            return "JUMP_IF_FALSE";
+        case OpCode::JUMP_IF_TRUE:
+            return "JUMP_IF_TRUE";
+        case OpCode::LOOP:
+            return "LOOP";
+        case OpCode::PRINT:
+            return "PRINT";
+        case OpCode::HALT:
+            return "HALT";
+        }
+        return "UNKNOWN";
+    }
+
+    std::string disassemble(const Chunk &chunk)
+    {
+        auto operand = [&](uint32_t value)
+        {
+            std::ostringstream oss;
+            if (value & K_BIT)
+                oss << "K" << (value & ~K_BIT) << "(" << value_to_string(chunk.constants[value & ~K_BIT]) << ")";
+            else
+                oss << "R" << value;
+            return oss.str();
+        };
+
+        std::ostringstream oss;
+        for (size_t pc = 0; pc < chunk.code.size(); ++pc)
+        {
+            const Instruction &instruction = chunk.code[pc];
+            oss << pc << "\t" << opcode_to_string(instruction.op);
+
+            switch (instruction.op)
+            {
+            case OpCode::LOAD_CONST:
+                oss << " R" << instruction.a << ", " << operand(instruction.b | K_BIT);
+                break;
+            case OpCode::LOAD_NIL:
+            case OpCode::CHECK_INIT:
+                oss << " R" << instruction.a;
+                break;
+            case OpCode::MOVE:
+                oss << " R" << instruction.a << ", R" << instruction.b;
+                break;
+            case OpCode::GET_GLOBAL:
+            case OpCode::SET_GLOBAL:
+            case OpCode::DEFINE_GLOBAL:
+                oss << " R" << instruction.a << ", " << chunk.tokens[instruction.token].lexeme;
+                break;
+            case OpCode::NEGATE:
+            case OpCode::NOT:
+                oss << " R" << instruction.a << ", " << operand(instruction.b);
+                break;
+            case OpCode::JUMP:
+            case OpCode::LOOP:
+                oss << " -> " << instruction.a;
+                break;
+            case OpCode::JUMP_IF_FALSE:
+            case OpCode::JUMP_IF_TRUE:
+                oss << " R" << instruction.a << " -> " << instruction.b;
+                break;
+            case OpCode::PRINT:
+                oss << " " << operand(instruction.a);
+                break;
+            case OpCode::HALT:
+                break;
+            default: // binary operators
+                oss << " R" << instruction.a << ", " << operand(instruction.b) << ", " << operand(instruction.c);
+                break;
+            }
+            oss << "\n";
+        }
+        return oss.str();
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "../Lexer/Token.h"
+#include "../Interpreter/Value.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lex
+{
+    /*
+     * Three-address instruction set of the register VM.
+     * `a` is (almost always) the destination register, `b` and `c` are operands.
+     * Operands marked RK can either be a register or a constant: when the K_BIT is set
+     * the remaining bits index into the chunk's constant table (same trick Lua uses)
+     */
+    enum class OpCode : uint8_t
+    {
+        LOAD_CONST,    // R[a] = K[b]
+        LOAD_NIL,      // R[a] = nil
+        MOVE,          // R[a] = R[b]
+        CHECK_INIT,    // error if R[a] is nil (reading an uninitialized local)
+
+        GET_GLOBAL,    // R[a] = globals[token]
+        SET_GLOBAL,    // globals[token] = R[a]   (assignment, must already exist)
+        DEFINE_GLOBAL, // globals[token] = R[a]   (declaration)
+
+        ADD,           // R[a] = RK[b] + RK[c]
+        SUBTRACT,      // R[a] = RK[b] - RK[c]
+        MULTIPLY,      // R[a] = RK[b] * RK[c]
+        DIVIDE,        // R[a] = RK[b] / RK[c]
+        GREATER,       // R[a] = RK[b] > RK[c]
+        GREATER_EQUAL, // R[a] = RK[b] >= RK[c]
+        LESS,          // R[a] = RK[b] < RK[c]
+        LESS_EQUAL,    // R[a] = RK[b] <= RK[c]
+        EQUAL,         // R[a] = RK[b] == RK[c]
+        NOT_EQUAL,     // R[a] = RK[b] != RK[c]
+        NEGATE,        // R[a] = -RK[b]
+        NOT,           // R[a] = !RK[b]
+
+        JUMP,          // pc = a
+        JUMP_IF_FALSE, // if !truthy(R[a]) pc = b
+        JUMP_IF_TRUE,  // if truthy(R[a]) pc = b
+        LOOP,          // pc = a (loop back-edge, kept apart from JUMP so it can act as a safe point)
+
+        PRINT,         // print RK[a]
+        HALT
+    };
+
+    constexpr uint32_t K_BIT = 0x80000000u;
+    constexpr uint32_t NO_TOKEN = 0xFFFFFFFFu;
+
+    struct Instruction
+    {
+        OpCode op;
+        uint32_t a = 0;
+        uint32_t b = 0;
+        uint32_t c = 0;
+        uint32_t token = NO_TOKEN; // index into Chunk::tokens, used for errors and global names
+    };
+
+    // the compiled form of a whole program
+    struct Chunk
+    {
+        std::vector<Instruction> code;
+        std::vector<Value> constants;
+        std::vector<Token> tokens;
+        uint32_t register_count = 0;
+
+        // end pc of every top-level statement, a runtime error resumes at the end of the failing statement
+        std::vector<uint32_t> statement_ends;
+    };
+
+    const char *opcode_to_string(OpCode op);
+
+    // human readable listing of a chunk, one instruction per line
+    std::string disassemble(const Chunk &chunk);
+}
@@ -0,0 +1,263 @@
+#include "VM.h"
+#include <algorithm>
+#include <iostream>
+
+namespace lex
+{
+    namespace
+    {
+        void check_number_operand(const Token &operator_token, const Value &operand)
+        {
+            if (!std::holds_alternative<double>(operand))
+                throw RuntimeError(operator_token, "Operand must be a number.");
+        }
+
+        void check_number_operands(const Token &operator_token, const Value &left, const Value &right)
+        {
+            if (!std::holds_alternative<double>(left) || !std::holds_alternative<double>(right))
+                throw RuntimeError(operator_token, "Operands must be numbers.");
+        }
+    }
+
+    // like Interpreter::concatenated, but the VM's locals live in registers rather than in an Environment, so the
+    // strings there count too
+    Value VM::concatenated(const Token &operator_token, const std::string &left, const std::string &right)
+    {
+        size_t size = left.size() + right.size();
+        if (!memory.fits(register_bytes + size))
+            throw RuntimeError(operator_token, memory.exceeded());
+        memory.observe(register_bytes + size);
+
+        std::string text;
+        text.reserve(size);
+        text += left;
+        text += right;
+        return Value(std::move(text));
+    }
+
+    void VM::run(const Chunk &chunk)
+    {
+        start(chunk);
+        resume(0);
+    }
+
+    void VM::start(const Chunk &chunk)
+    {
+        registers.assign(chunk.register_count, Value());
+        register_bytes = 0;
+        current = &chunk;
+        resume_pc = 0;
+    }
+
+    bool VM::resume(uint64_t steps)
+    {
+        const Chunk &chunk = *current;
+        budget.set_slice(steps);
+        while (resume_pc < chunk.code.size())
+        {
+            try
+            {
+                if (!execute(chunk, resume_pc))
+                    return false;
+                break;
+            }
+            catch (const RuntimeError &error)
+            {
+                diagnostics.runtime_error(error);
+            }
+
+            // like Interpreter::interpret, carry on with the next top-level statement
+            auto failed = std::upper_bound(chunk.statement_ends.begin(), chunk.statement_ends.end(), last_pc);
+            if (failed == chunk.statement_ends.end())
+                break;
+            resume_pc = *failed;
+        }
+        resume_pc = static_cast<uint32_t>(chunk.code.size());
+        return true;
+    }
+
+    bool VM::execute(const Chunk &chunk, uint32_t pc)
+    {
+        const Instruction *code = chunk.code.data();
+        const Value *constants = chunk.constants.data();
+        Value *regs = registers.data();
+
+        // RK operand: register or constant
+        auto rk = [&](uint32_t operand) -> const Value &
+        {
+            return (operand & K_BIT) ? constants[operand & ~K_BIT] : regs[operand];
+        };
+        // every register write goes through here, so register_bytes stays what the strings in them take
+        auto store = [&](uint32_t reg, Value value)
+        {
+            if (const std::string *text = std::get_if<std::string>(&regs[reg]))
+                register_bytes -= text->size();
+            if (const std::string *text = std::get_if<std::string>(&value))
+                register_bytes += text->size();
+            regs[reg] = std::move(value);
+        };
+
+        while (true)
+        {
+            const Instruction &instruction = code[pc];
+            last_pc = pc++;
+            ++executed;
+
+            switch (instruction.op)
+            {
+            case OpCode::LOAD_CONST:
+                store(instruction.a, constants[instruction.b]);
+                break;
+            case OpCode::LOAD_NIL:
+                store(instruction.a, std::monostate{});
+                break;
+            case OpCode::MOVE:
+                store(instruction.a, regs[instruction.b]);
+                break;
+            case OpCode::CHECK_INIT:
+                if (std::holds_alternative<std::monostate>(regs[instruction.a]))
+                {
+                    const Token &name = chunk.tokens[instruction.token];
+                    throw RuntimeError(name, "Uninitialized variable: " + name.lexeme);
+                }
+                break;
+
+            case OpCode::GET_GLOBAL:
+            {
+                const Token &name = chunk.tokens[instruction.token];
+                store(instruction.a, globals->get(name));
+                if (std::holds_alternative<std::monostate>(regs[instruction.a]))
+                    throw RuntimeError(name, "Uninitialized variable: " + name.lexeme);
+                break;
+            }
+            case OpCode::SET_GLOBAL:
+                globals->assign(chunk.tokens[instruction.token], regs[instruction.a]);
+                break;
+            case OpCode::DEFINE_GLOBAL:
+                globals->define(chunk.tokens[instruction.token], regs[instruction.a]);
+                break;
+
+            case OpCode::ADD:
+            {
+                const Token &token = chunk.tokens[instruction.token];
+                const Value &left = rk(instruction.b);
+                const Value &right = rk(instruction.c);
+                const std::string *left_text = std::get_if<std::string>(&left);
+                const std::string *right_text = std::get_if<std::string>(&right);
+                if (std::holds_alternative<double>(left) && std::holds_alternative<double>(right))
+                    store(instruction.a, std::get<double>(left) + std::get<double>(right));
+                // same mixed concatenation rules as Interpreter::visitBinaryExpr
+                else if (left_text && right_text)
+                    store(instruction.a, concatenated(token, *left_text, *right_text));
+                else if (left_text)
+                    store(instruction.a, concatenated(token, *left_text, value_to_string(right)));
+                else if (right_text)
+                    store(instruction.a, concatenated(token, value_to_string(left), *right_text));
+                else
+                    throw RuntimeError(token, "Operands must be two numbers or two strings.");
+                break;
+            }
+            case OpCode::SUBTRACT:
+            {
+                const Value &left = rk(instruction.b);
+                const Value &right = rk(instruction.c);
+                check_number_operands(chunk.tokens[instruction.token], left, right);
+                store(instruction.a, std::get<double>(left) - std::get<double>(right));
+                break;
+            }
+            case OpCode::MULTIPLY:
+            {
+                const Value &left = rk(instruction.b);
+                const Value &right = rk(instruction.c);
+                check_number_operands(chunk.tokens[instruction.token], left, right);
+                store(instruction.a, std::get<double>(left) * std::get<double>(right));
+                break;
+            }
+            case OpCode::DIVIDE:
+            {
+                const Value &left = rk(instruction.b);
+                const Value &right = rk(instruction.c);
+                check_number_operands(chunk.tokens[instruction.token], left, right);
+                if (std::get<double>(right) == 0.0)
+                    throw RuntimeError(chunk.tokens[instruction.token], "Division by zero.");
+                store(instruction.a, std::get<double>(left) / std::get<double>(right));
+                break;
+            }
+            case OpCode::GREATER:
+            {
+                const Value &left = rk(instruction.b);
+                const Value &right = rk(instruction.c);
+                check_number_operands(chunk.tokens[instruction.token], left, right);
+                store(instruction.a, std::get<double>(left) > std::get<double>(right));
+                break;
+            }
+            case OpCode::GREATER_EQUAL:
+            {
+                const Value &left = rk(instruction.b);
+                const Value &right = rk(instruction.c);
+                check_number_operands(chunk.tokens[instruction.token], left, right);
+                store(instruction.a, std::get<double>(left) >= std::get<double>(right));
+                break;
+            }
+            case OpCode::LESS:
+            {
+                const Value &left = rk(instruction.b);
+                const Value &right = rk(instruction.c);
+                check_number_operands(chunk.tokens[instruction.token], left, right);
+                store(instruction.a, std::get<double>(left) < std::get<double>(right));
+                break;
+            }
+            case OpCode::LESS_EQUAL:
+            {
+                const Value &left = rk(instruction.b);
+                const Value &right = rk(instruction.c);
+                check_number_operands(chunk.tokens[instruction.token], left, right);
+                store(instruction.a, std::get<double>(left) <= std::get<double>(right));
+                break;
+            }
+            case OpCode::EQUAL:
+                store(instruction.a, values_equal(rk(instruction.b), rk(instruction.c)));
+                break;
+            case OpCode::NOT_EQUAL:
+                store(instruction.a, !values_equal(rk(instruction.b), rk(instruction.c)));
+                break;
+            case OpCode::NEGATE:
+            {
+                const Value &right = rk(instruction.b);
+                check_number_operand(chunk.tokens[instruction.token], right);
+                store(instruction.a, -std::get<double>(right));
+                break;
+            }
+            case OpCode::NOT:
+                store(instruction.a, !is_truthy(rk(instruction.b)));
+                break;
+
+            case OpCode::JUMP:
+                pc = instruction.a;
+                break;
+            case OpCode::LOOP:
+                pc = instruction.a;
+                if (budget.tick())
+                {
+                    resume_pc = pc;
+                    return false;
+                }
+                break;
+            case OpCode::JUMP_IF_FALSE:
+                if (!is_truthy(regs[instruction.a]))
+                    pc = instruction.b;
+                break;
+            case OpCode::JUMP_IF_TRUE:
+                if (is_truthy(regs[instruction.a]))
+                    pc = instruction.b;
+                break;
+
+            case OpCode::PRINT:
+                out << value_to_string(rk(instruction.a)) << std::endl;
+                break;
+            case OpCode::HALT:
+                return true;
+            }
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Instruction.h"
+#include "../Parser/Environment.h"
+#include "../Error_Handling/RunTimeError.h"
+#include "../Error_Handling/Diagnostics.h"
+#include "../Interpreter/Budget.h"
+#include "../Interpreter/Memory.h"
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace lex
+{
+    // Executes a Chunk produced by the Compiler
+    class VM
+    {
+    public:
+        // PRINT writes to `out`, runtime errors go to `diagnostics`
+        explicit VM(Diagnostics &diagnostics, std::ostream &out = std::cout) : diagnostics(diagnostics), out(out) {}
+
+        void run(const Chunk &chunk);
+
+        // time slicing: start() a chunk (which must stay alive), then resume() it until it returns true.
+        // Each call runs at most `steps` loop iterations (0: to the end) and suspends at a LOOP instruction.
+        void start(const Chunk &chunk);
+        bool resume(uint64_t steps);
+
+        // step/time limits and interrupts, ticked at every LOOP; reset it before run()/start()
+        Budget budget;
+
+        // number of instructions dispatched so far, for comparing against other backends
+        uint64_t instruction_count() const { return executed; }
+
+        // what the globals and the strings in registers take, limit checked as they grow (set_limit() to cap)
+        Memory memory;
+
+        // global variables, to start other runs from this state
+        Snapshot snapshot() const { return globals->snapshot(); }
+        // replace the globals by a copy-on-write fork of a snapshot
+        void fork(Snapshot snapshot) { globals = std::make_shared<Environment>(std::move(snapshot), &memory); }
+
+    private:
+        Diagnostics &diagnostics;
+        std::ostream &out;
+        std::shared_ptr<Environment> globals = std::make_shared<Environment>(&memory);
+        std::vector<Value> registers;
+        size_t register_bytes = 0; // size of the strings held in registers
+        uint64_t executed = 0;
+        uint32_t last_pc = 0; // pc of the instruction being executed, used to recover from runtime errors
+        const Chunk *current = nullptr; // chunk being run by start()/resume()
+        uint32_t resume_pc = 0;
+
+        // false when it suspended at the end of a slice (resume_pc is where to continue)
+        bool execute(const Chunk &chunk, uint32_t pc);
+        // left + right, throws before building it when it would not fit next to the register strings
+        Value concatenated(const Token &operator_token, const std::string &left, const std::string &right);
+    };
+}
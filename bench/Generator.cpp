@@ -0,0 +1,362 @@
+#include "Generator.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <string>
+
+namespace lex
+{
+    namespace
+    {
+        // splitmix64, the standard library's engines and distributions are not the same everywhere
+        class Random
+        {
+        public:
+            explicit Random(uint64_t seed) : state(seed) {}
+
+            uint64_t next()
+            {
+                uint64_t z = (state += 0x9e3779b97f4a7c15);
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+                return z ^ (z >> 31);
+            }
+
+            size_t below(size_t n) { return n ? static_cast<size_t>(next() % n) : 0; }
+            bool chance(double p) { return static_cast<double>(next() >> 11) * 0x1.0p-53 < p; }
+
+        private:
+            uint64_t state;
+        };
+
+        // text of a numeric expression and how far from 0 its value can get, in units of 100 (what a variable holds
+        // at most)
+        struct Number
+        {
+            std::string text;
+            double bound;
+        };
+
+        const char *const WORDS[] = {"alpha", "beta", "gamma", "delta", "lex", "tree", "node", "token", "scope",
+                                     "value", "loop", "print", "string", "x", "hello", "world"};
+
+        // every call to `random` is a statement of its own, the order of evaluation within an expression is up to
+        // the compiler and the output would be too
+        class Generator
+        {
+        public:
+            explicit Generator(const GeneratorOptions &options) : options(options), random(options.seed)
+            {
+                if (options.string_density > 0)
+                    texts = std::max<size_t>(1, static_cast<size_t>(options.variables * options.string_density));
+                numbers = options.variables > texts ? options.variables - texts : 1;
+            }
+
+            std::string run()
+            {
+                source = "// lextree_gen --seed " + std::to_string(options.seed) + " --tokens " +
+                         std::to_string(options.tokens) + "\n";
+                for (size_t i = 0; i < numbers; i++)
+                    line(0, "var " + number_variable(i) + " = " + literal().text + ";", 4);
+                for (size_t i = 0; i < texts; i++)
+                    line(0, "var " + text_variable(i) + " = " + string_literal() + ";", 4);
+
+                while (tokens < options.tokens)
+                    statement(0, 0);
+                return source;
+            }
+
+        private:
+            const GeneratorOptions &options;
+            Random random;
+            std::string source;
+            size_t tokens = 0; // emitted so far, EOF not counted
+            size_t numbers = 0;
+            size_t texts = 0;
+
+            // one line at `level` of indentation, `count` tokens on it besides the ones counted where its parts
+            // were made
+            void line(size_t level, const std::string &text, size_t count)
+            {
+                source.append(level * 4, ' ');
+                source += text;
+                source += '\n';
+                tokens += count;
+            }
+
+            std::string words(size_t most)
+            {
+                std::string text = WORDS[random.below(std::size(WORDS))];
+                for (size_t i = random.below(most); i > 0; i--)
+                    text += std::string(" ") + WORDS[random.below(std::size(WORDS))];
+                return text;
+            }
+
+            static std::string number_variable(size_t i) { return "value_" + std::to_string(i); }
+            static std::string text_variable(size_t i) { return "text_" + std::to_string(i); }
+
+            Number literal()
+            {
+                size_t whole = random.below(100);
+                bool half = random.chance(0.25);
+                tokens++;
+                return {std::to_string(whole) + (half ? ".5" : ""), (whole + (half ? 0.5 : 0)) / 100};
+            }
+
+            std::string string_literal()
+            {
+                tokens++;
+                return "\"" + words(3) + "\"";
+            }
+
+            Number leaf()
+            {
+                if (random.below(3) == 0)
+                    return literal();
+                tokens++;
+                return {number_variable(random.below(numbers)), 1};
+            }
+
+            // composites come in parentheses, so any of them is a valid operand
+            Number number(size_t depth)
+            {
+                if (depth == 0)
+                    return leaf();
+
+                Number left = number(depth - 1);
+                switch (random.below(6))
+                {
+                case 0:
+                case 1:
+                {
+                    Number right = random.chance(0.25) ? number(depth / 2) : leaf();
+                    tokens += 3;
+                    return {"(" + left.text + (random.chance(0.5) ? " + " : " - ") + right.text + ")",
+                            left.bound + right.bound};
+                }
+                case 2:
+                {
+                    static const char *const factors[] = {"2", "3", "0.5"};
+                    static const double values[] = {2, 3, 0.5};
+                    size_t pick = random.below(3);
+                    tokens += 4;
+                    return {"(" + left.text + " * " + factors[pick] + ")", left.bound * values[pick]};
+                }
+                case 3:
+                {
+                    static const char *const divisors[] = {"2", "4", "10"};
+                    static const double values[] = {2, 4, 10};
+                    size_t pick = random.below(3);
+                    tokens += 4;
+                    return {"(" + left.text + " / " + divisors[pick] + ")", left.bound / values[pick]};
+                }
+                case 4:
+                    tokens += 3;
+                    return {"(-" + left.text + ")", left.bound};
+                default:
+                {
+                    std::string test = condition(depth - 1);
+                    Number other = leaf();
+                    tokens += 4;
+                    return {"(" + test + " ? " + left.text + " : " + other.text + ")",
+                            std::max(left.bound, other.bound)};
+                }
+                }
+            }
+
+            std::string condition(size_t depth)
+            {
+                if (depth == 0 || random.chance(0.5))
+                {
+                    if (texts && random.chance(options.string_density))
+                    {
+                        std::string variable = text_variable(random.below(texts));
+                        const char *equality = random.chance(0.5) ? " == " : " != ";
+                        tokens += 2;
+                        return variable + equality + string_literal();
+                    }
+                    static const char *const comparisons[] = {" < ", " <= ", " > ", " >= ", " == ", " != "};
+                    std::string left = number(depth ? depth - 1 : 0).text;
+                    const char *comparison = comparisons[random.below(6)];
+                    tokens++;
+                    return left + comparison + leaf().text;
+                }
+                switch (random.below(3))
+                {
+                case 0:
+                    tokens += 3;
+                    return "!(" + condition(depth - 1) + ")";
+                default:
+                {
+                    std::string left = condition(depth - 1);
+                    std::string right = condition(0);
+                    tokens += 3;
+                    return "(" + left + (random.chance(0.5) ? " and " : " or ") + right + ")";
+                }
+                }
+            }
+
+            std::string text(size_t depth)
+            {
+                switch (random.below(4))
+                {
+                case 0:
+                    return string_literal();
+                case 1:
+                    tokens++;
+                    return text_variable(random.below(texts));
+                case 2:
+                {
+                    std::string left = string_literal();
+                    tokens += 3;
+                    return "(" + left + " + " + string_literal() + ")";
+                }
+                default:
+                {
+                    std::string test = condition(depth);
+                    std::string variable = text_variable(random.below(texts));
+                    tokens += 5;
+                    return "(" + test + " ? " + variable + " : " + string_literal() + ")";
+                }
+                }
+            }
+
+            // an assignment scaled down to what a variable may hold
+            std::string scaled(const Number &value)
+            {
+                if (value.bound <= 1)
+                    return value.text;
+                tokens += 2;
+                return value.text + " / " + std::to_string(static_cast<uint64_t>(std::ceil(value.bound)));
+            }
+
+            void comment(size_t level)
+            {
+                if (random.chance(0.5))
+                    line(level, "// " + words(6), 0);
+                else if (random.chance(0.8))
+                    line(level, "/* " + words(6) + " */", 0);
+                else
+                    line(level, "/*\n" + std::string(level * 4 + 3, ' ') + words(10) + "\n" +
+                                std::string(level * 4, ' ') + "*/", 0);
+            }
+
+            void statement(size_t level, size_t loops)
+            {
+                // comment_density > 1 means more than one per statement
+                for (double left = options.comment_density; left > 0; left -= 1)
+                {
+                    if (random.chance(left))
+                        comment(level);
+                }
+
+                if (level < options.block_depth && random.chance(0.2))
+                    compound(level, loops);
+                else if (texts && random.chance(options.string_density))
+                    text_statement(level);
+                else
+                    number_statement(level);
+            }
+
+            void number_statement(size_t level)
+            {
+                size_t depth = random.below(options.expression_depth + 1);
+                size_t pick = random.below(8);
+                if (pick == 0)
+                {
+                    line(level, "print " + number(depth).text + ";", 2);
+                    return;
+                }
+                std::string target = number_variable(random.below(numbers));
+                std::string value = scaled(number(depth));
+                if (level > 0 && pick == 1)
+                    line(level, "var " + target + " = " + value + ";", 4); // shadows the global
+                else
+                    line(level, target + " = " + value + ";", 3);
+            }
+
+            void text_statement(size_t level)
+            {
+                size_t depth = random.below(options.expression_depth + 1);
+                switch (random.below(3))
+                {
+                case 0:
+                {
+                    std::string value = text(depth);
+                    line(level, text_variable(random.below(texts)) + " = " + value + ";", 3);
+                    break;
+                }
+                case 1:
+                {
+                    std::string value = string_literal();
+                    line(level, "print " + text_variable(random.below(texts)) + " + " + value + ";", 4);
+                    break;
+                }
+                default:
+                {
+                    std::string value = string_literal();
+                    line(level, "print " + value + " + " + number(depth).text + ";", 3);
+                    break;
+                }
+                }
+            }
+
+            // { ... } with one to four statements, the braces at `level`
+            void body(size_t level, size_t loops)
+            {
+                line(level, "{", 1);
+                for (size_t i = 1 + random.below(4); i > 0; i--)
+                    statement(level + 1, loops);
+                line(level, "}", 1);
+            }
+
+            void compound(size_t level, size_t loops)
+            {
+                size_t kinds = loops < options.loop_depth ? 5 : 3;
+                std::string counter = "loop_" + std::to_string(loops + 1);
+                std::string trips = std::to_string(options.loop_trips);
+                switch (random.below(kinds))
+                {
+                case 0:
+                    body(level, loops);
+                    break;
+                case 1:
+                case 2:
+                {
+                    std::string test = condition(random.below(options.expression_depth + 1));
+                    line(level, "if (" + test + ")", 3);
+                    body(level, loops);
+                    if (random.chance(0.5))
+                    {
+                        line(level, "else", 1);
+                        body(level, loops);
+                    }
+                    break;
+                }
+                case 3:
+                    line(level, "for (var " + counter + " = 0; " + counter + " < " + trips + "; " + counter + " = " +
+                                counter + " + 1)", 17);
+                    body(level, loops + 1);
+                    break;
+                default:
+                    // the counter is declared in a block of its own, and the statements never assign loop_ names
+                    line(level, "{", 1);
+                    line(level + 1, "var " + counter + " = 0;", 5);
+                    line(level + 1, "while (" + counter + " < " + trips + ")", 6);
+                    line(level + 1, "{", 1);
+                    for (size_t i = 1 + random.below(4); i > 0; i--)
+                        statement(level + 2, loops + 1);
+                    line(level + 2, counter + " = " + counter + " + 1;", 6);
+                    line(level + 1, "}", 1);
+                    line(level, "}", 1);
+                    break;
+                }
+            }
+        };
+    }
+
+    std::string generate_program(const GeneratorOptions &options)
+    {
+        return Generator(options).run();
+    }
+}
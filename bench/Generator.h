@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace lex
+{
+    // what generate_program() makes, `lextree_gen --help` has the same list
+    struct GeneratorOptions
+    {
+        uint64_t seed = 1;
+        size_t tokens = 10000;         // stops at the first top-level statement past this many tokens
+        size_t expression_depth = 4;   // operators nested in the deepest expressions
+        size_t block_depth = 3;        // blocks, ifs and loops nested in each other
+        size_t loop_depth = 1;         // loops nested in each other, a run does about loop_trips^loop_depth the work
+        size_t variables = 16;         // globals the statements read and write
+        size_t loop_trips = 10;        // iterations of every loop
+        double string_density = 0.2;   // share of statements working on strings (literals, concatenation)
+        double comment_density = 0.1;  // comments per statement
+    };
+
+    /*
+     * A synthetic Lex program for scaling benchmarks (lextree_gen, the generated/ benchmarks of lextree_bench).
+     * It always parses and runs without errors on both backends: numbers stay within +-100 (assignments are scaled
+     * down by what their expression could reach), strings do not grow across iterations and nothing divides by
+     * a variable. The same options and seed give the same text on every platform and standard library.
+     */
+    std::string generate_program(const GeneratorOptions &options);
+}
@@ -0,0 +1,588 @@
+// lextree_bench: micro benchmarks of every stage (lexer, parser, environment lookups, dispatch) and macro benchmarks
+// over bench/corpus, results as JSON on stdout (see bench/README.md)
+
+#include "../LexTree/Engine.h"
+#include "../LexTree/Lexer/Lexer.h"
+#include "../LexTree/Parser/parser.h"
+#include "../LexTree/Parser/Environment.h"
+#include "../LexTree/Instrumentation/Allocations.h"
+#include "Generator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Settings
+    {
+        std::string filter;              // only benchmarks whose name contains this
+        size_t repeat = 5;               // samples per benchmark
+        double min_time_ms = 100;        // length of one sample
+        std::string corpus = "bench/corpus";
+        std::string out;                 // JSON file, stdout when empty
+        uint64_t seed = 1;               // of the generated programs
+        size_t max_tokens = 100000;      // largest generated program, they go up from 1000 tokens tenfold
+        bool check_allocations = false;  // only check the allocation budgets, exit code 1 when one is exceeded
+    };
+
+    struct Result
+    {
+        std::string name;
+        std::string kind;  // "micro", "macro" or "scaling"
+        size_t items = 1;  // work units per iteration (tokens, lookups, loop iterations, ...)
+        uint64_t iterations = 0;
+        lex::AllocationCount allocated; // per iteration
+        std::vector<double> samples; // nanoseconds per iteration
+    };
+
+    // swallows everything, so print-heavy scripts measure the interpreter and not the terminal
+    class NullBuffer : public std::streambuf
+    {
+    protected:
+        int_type overflow(int_type c) override { return traits_type::not_eof(c); }
+        std::streamsize xsputn(const char *, std::streamsize size) override { return size; }
+    };
+
+    NullBuffer null_buffer;
+    std::ostream null_stream(&null_buffer);
+
+    // results are added here so the compiler cannot drop the work
+    volatile size_t keep = 0;
+
+    std::vector<Result> results;
+
+    double median(std::vector<double> values)
+    {
+        std::sort(values.begin(), values.end());
+        size_t middle = values.size() / 2;
+        return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+    }
+
+    // times `body` often enough that one sample takes about min_time_ms, `repeat` samples
+    void measure(const Settings &settings, const std::string &name, const std::string &kind, size_t items,
+                 const std::function<void()> &body)
+    {
+        if (!settings.filter.empty() && name.find(settings.filter) == std::string::npos)
+            return;
+
+        // one run on its own for the allocations, it also warms up
+        lex::AllocationCount before = lex::allocations();
+        body();
+        lex::AllocationCount allocated = lex::allocations() - before;
+
+        auto run = [&](uint64_t iterations)
+        {
+            auto start = Clock::now();
+            for (uint64_t i = 0; i < iterations; i++)
+                body();
+            return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        };
+
+        // calibrate: grow until a batch takes a tenth of a sample, then scale up
+        uint64_t iterations = 1;
+        double target = settings.min_time_ms * 1e6;
+        while (true)
+        {
+            double elapsed = run(iterations);
+            if (elapsed >= target / 10 || iterations >= (uint64_t(1) << 30))
+            {
+                iterations = std::max<uint64_t>(1, static_cast<uint64_t>(iterations * target / std::max(elapsed, 1.0)));
+                break;
+            }
+            iterations *= 10;
+        }
+
+        Result result{name, kind, items, iterations, allocated, {}};
+        for (size_t sample = 0; sample < settings.repeat; sample++)
+            result.samples.push_back(run(iterations) / iterations);
+
+        double best = *std::min_element(result.samples.begin(), result.samples.end());
+        std::cerr << name << ": " << median(result.samples) / 1e3 << " us (min " << best / 1e3 << " us, "
+                  << median(result.samples) / items << " ns/item)" << std::endl;
+        results.push_back(std::move(result));
+    }
+
+    // Lex text of roughly `statements` statements mixing every kind of token
+    std::string synthetic_source(size_t statements)
+    {
+        std::string source;
+        for (size_t i = 0; i < statements; i++)
+        {
+            std::string name = "value_" + std::to_string(i % 97);
+            switch (i % 4)
+            {
+            case 0:
+                source += "var " + name + " = " + std::to_string(i) + ".5 * (other + 3);\n";
+                break;
+            case 1:
+                source += "if (" + name + " >= 10 and !done) print \"text " + std::to_string(i) + "\";\n";
+                break;
+            case 2:
+                source += "// a comment line that the lexer has to skip\n" + name + " = " + name + " - 1;\n";
+                break;
+            default:
+                source += "while (" + name + " != nil) { " + name + " = " + name + " / 2; }\n";
+                break;
+            }
+        }
+        return source;
+    }
+
+    std::vector<lex::Token> scan(const std::string &source)
+    {
+        lex::Diagnostics diagnostics(null_stream);
+        lex::Lexer lexer(source, diagnostics);
+        return lexer.scan_tokens();
+    }
+
+    void lexer_benchmarks(const Settings &settings)
+    {
+        for (size_t statements : {100, 1000, 10000})
+        {
+            std::string source = synthetic_source(statements);
+            size_t tokens = scan(source).size();
+            measure(settings, "lexer/scan_tokens/" + std::to_string(tokens) + "_tokens", "micro", tokens,
+                    [&] { keep = keep + scan(source).size(); });
+        }
+    }
+
+    void parse_benchmark(const Settings &settings, const std::string &name, const std::string &source)
+    {
+        std::vector<lex::Token> tokens = scan(source);
+        measure(settings, "parser/parse/" + name, "micro", tokens.size(),
+                [&]
+                {
+                    lex::Diagnostics diagnostics(null_stream);
+                    lex::Parser parser(tokens, diagnostics);
+                    keep = keep + parser.parse().size();
+                });
+    }
+
+    void parser_benchmarks(const Settings &settings)
+    {
+        // deep: (((1 + 1) + 1) ...), one nested grouping per level
+        for (size_t depth : {16, 256})
+        {
+            std::string source = "print " + std::string(depth, '(') + "1";
+            for (size_t i = 0; i < depth; i++)
+                source += " + 1)";
+            parse_benchmark(settings, "deep_" + std::to_string(depth), source + ";");
+        }
+
+        // wide: one long flat expression
+        for (size_t width : {100, 5000})
+        {
+            std::string source = "print 1";
+            for (size_t i = 1; i < width; i++)
+                source += (i % 3 == 0 ? " * " : " + ") + std::to_string(i);
+            parse_benchmark(settings, "wide_" + std::to_string(width), source + ";");
+        }
+
+        parse_benchmark(settings, "statements_1000", synthetic_source(1000));
+    }
+
+    void environment_benchmarks(const Settings &settings)
+    {
+        constexpr size_t LOOKUPS = 1000;
+        lex::Token target(lex::TokenType::IDENTIFIER, "target", std::monostate{}, 1);
+
+        for (size_t depth : {1, 8, 32})
+        {
+            // `target` is a global, every scope above it has a few locals of its own
+            auto globals = std::make_shared<lex::Environment>();
+            globals->define(target, lex::Value(1.0));
+            std::shared_ptr<lex::Environment> scope = globals;
+            for (size_t level = 1; level < depth; level++)
+            {
+                scope = std::make_shared<lex::Environment>(scope);
+                for (const char *local : {"a", "b", "c"})
+                    scope->define(lex::Token(lex::TokenType::IDENTIFIER, local, std::monostate{}, 1), lex::Value(0.0));
+            }
+
+            measure(settings, "environment/get/depth_" + std::to_string(depth), "micro", LOOKUPS,
+                    [&]
+                    {
+                        double sum = 0;
+                        for (size_t i = 0; i < LOOKUPS; i++)
+                            sum += std::get<double>(scope->get(target));
+                        keep = keep + static_cast<size_t>(sum);
+                    });
+        }
+    }
+
+    void run_benchmark(const Settings &settings, const std::string &name, const std::string &kind, size_t items,
+                       const lex::ProgramPtr &program, bool use_vm)
+    {
+        lex::EngineOptions options;
+        options.use_vm = use_vm;
+        measure(settings, name, kind, items,
+                [&]
+                {
+                    lex::Engine engine(options, null_stream, null_stream);
+                    keep = keep + static_cast<size_t>(engine.run(program));
+                });
+    }
+
+    void dispatch_benchmarks(const Settings &settings)
+    {
+        constexpr size_t TRIPS = 10000;
+        lex::EngineOptions options;
+        lex::ProgramPtr loop = lex::Program::compile(
+            "var i = 0; var s = 0; while (i < " + std::to_string(TRIPS) + ") { s = s + i * 2; i = i + 1; }", options);
+        run_benchmark(settings, "interpreter/dispatch/loop", "micro", TRIPS, loop, false);
+        run_benchmark(settings, "vm/dispatch/loop", "micro", TRIPS, loop, true);
+
+        // straight-line code, every statement visited once
+        std::string source = "var x = 0; var y = 1;\n";
+        for (size_t i = 0; i < 1000; i++)
+            source += i % 2 ? "x = x + y * 2;\n" : "y = (x - y) / 3;\n";
+        lex::ProgramPtr straight = lex::Program::compile(source, options);
+        run_benchmark(settings, "interpreter/dispatch/straight_line", "micro", 1000, straight, false);
+        run_benchmark(settings, "vm/dispatch/straight_line", "micro", 1000, straight, true);
+    }
+
+    void corpus_benchmarks(const Settings &settings)
+    {
+        namespace fs = std::filesystem;
+        std::vector<fs::path> scripts;
+        std::error_code error;
+        for (const auto &entry : fs::directory_iterator(settings.corpus, error))
+        {
+            if (entry.path().extension() == ".lex")
+                scripts.push_back(entry.path());
+        }
+        if (error || scripts.empty())
+            std::cerr << "no corpus in " << settings.corpus << ", skipping the macro benchmarks" << std::endl;
+        std::sort(scripts.begin(), scripts.end());
+
+        lex::EngineOptions options;
+        for (const fs::path &script : scripts)
+        {
+            std::ifstream file(script);
+            std::stringstream buffer;
+            buffer << file.rdbuf();
+            std::string source = buffer.str();
+            std::string name = "corpus/" + script.stem().string();
+
+            measure(settings, name + "/compile", "macro", 1,
+                    [&] { keep = keep + lex::Program::compile(source, options)->statements.size(); });
+            lex::ProgramPtr program = lex::Program::compile(source, options);
+            run_benchmark(settings, name + "/interpreter", "macro", 1, program, false);
+            run_benchmark(settings, name + "/vm", "macro", 1, program, true);
+        }
+    }
+
+    // the same generated program (Generator.h) at 1000, 10000, ... tokens through every stage. Time per token
+    // should stay flat as the input grows, a stage where it does not is flagged on stderr.
+    void generated_benchmarks(const Settings &settings)
+    {
+        static const char *const stages[] = {"lex", "parse", "compile", "interpreter", "vm"};
+        lex::EngineOptions options;
+        for (size_t size = 1000; size <= settings.max_tokens; size *= 10)
+        {
+            lex::GeneratorOptions shape;
+            shape.seed = settings.seed;
+            shape.tokens = size;
+            std::string source = lex::generate_program(shape);
+            std::vector<lex::Token> tokens = scan(source);
+            std::string name = "generated/" + std::to_string(size) + "_tokens/";
+
+            measure(settings, name + stages[0], "scaling", tokens.size(),
+                    [&] { keep = keep + scan(source).size(); });
+            measure(settings, name + stages[1], "scaling", tokens.size(),
+                    [&]
+                    {
+                        lex::Diagnostics diagnostics(null_stream);
+                        lex::Parser parser(tokens, diagnostics);
+                        keep = keep + parser.parse().size();
+                    });
+            measure(settings, name + stages[2], "scaling", tokens.size(),
+                    [&] { keep = keep + lex::Program::compile(source, options)->statements.size(); });
+            lex::ProgramPtr program = lex::Program::compile(source, options);
+            run_benchmark(settings, name + stages[3], "scaling", tokens.size(), program, false);
+            run_benchmark(settings, name + stages[4], "scaling", tokens.size(), program, true);
+        }
+
+        // ns per token of every stage as the input grows tenfold: memory effects add a little each step, a stage
+        // that is quadratic somewhere gets 10x slower
+        for (const char *stage : stages)
+        {
+            std::string line;
+            double previous = 0;
+            double worst = 0;
+            for (const Result &result : results)
+            {
+                if (result.kind != "scaling" || !result.name.ends_with(std::string("/") + stage))
+                    continue;
+                double per_token = median(result.samples) / result.items;
+                if (previous > 0)
+                    worst = std::max(worst, per_token / previous);
+                line += (line.empty() ? "" : " -> ") + std::to_string(static_cast<int>(per_token + 0.5));
+                previous = per_token;
+            }
+            if (worst > 0)
+                std::cerr << "generated/" << stage << ": " << line << " ns/token"
+                          << (worst > 2 ? ", superlinear?" : "") << std::endl;
+        }
+    }
+
+    // heap allocations of `body`, the calling thread's
+    template <typename Body>
+    lex::AllocationCount allocations_of(Body &&body)
+    {
+        lex::AllocationCount before = lex::allocations();
+        body();
+        return lex::allocations() - before;
+    }
+
+    /*
+     * --check-allocations: heap allocations per unit of work of each phase, against a budget. A check runs its phase
+     * on a small and a large input and takes the difference, so setup and one-off growth do not count. `retained`
+     * is what is still allocated when the phase is done (its output, or what a loop leaks per iteration).
+     * The budgets are what the code does now. Lower one when a change saves allocations so the saving stays, raise
+     * one only on purpose.
+     */
+    struct AllocationCheck
+    {
+        std::string name;
+        const char *unit;
+        double allocations; // per unit, at most
+        double retained;    // per unit, at most
+        // the allocations of the phase on an input of about `size` units, and how many units that was exactly
+        std::function<std::pair<lex::AllocationCount, size_t>(size_t size)> run;
+    };
+
+    // a loop of `size` iterations running `body` on a fresh engine, only the run counted
+    AllocationCheck loop_check(const std::string &name, bool use_vm, const std::string &body, double allocations,
+                               double retained)
+    {
+        return {(use_vm ? "vm/" : "interpreter/") + name, "iteration", allocations, retained,
+                [=](size_t size)
+                {
+                    lex::EngineOptions options;
+                    options.use_vm = use_vm;
+                    lex::ProgramPtr program = lex::Program::compile(
+                        "var i = 0; var s = 0; var t = \"\";\nwhile (i < " + std::to_string(size) + ")\n{\n" + body +
+                            "\ni = i + 1;\n}",
+                        options);
+                    lex::Engine engine(options, null_stream, null_stream);
+                    lex::AllocationCount made = allocations_of([&] { engine.run(program); });
+                    return std::make_pair(made, size);
+                }};
+    }
+
+    std::vector<AllocationCheck> allocation_checks()
+    {
+        lex::EngineOptions options;
+        std::vector<AllocationCheck> checks = {
+            {"lex", "token", 0.01, 0.01, // lexemes fit in the strings' own buffer
+             [](size_t size)
+             {
+                 std::string source = synthetic_source(size / 10);
+                 std::vector<lex::Token> tokens;
+                 lex::AllocationCount made = allocations_of([&] { tokens = scan(source); });
+                 return std::make_pair(made, tokens.size());
+             }},
+            {"parse", "token", 1.05, 0.75,
+             [](size_t size)
+             {
+                 std::vector<lex::Token> tokens = scan(synthetic_source(size / 10));
+                 std::vector<lex::StmtPtr> statements;
+                 lex::AllocationCount made = allocations_of(
+                     [&]
+                     {
+                         lex::Diagnostics diagnostics(null_stream);
+                         lex::Parser parser(tokens, diagnostics);
+                         statements = parser.parse();
+                     });
+                 return std::make_pair(made, tokens.size());
+             }},
+            {"optimize", "token", 0.6, 0,
+             [options](size_t size)
+             {
+                 std::vector<lex::Token> tokens = scan(synthetic_source(size / 10));
+                 lex::Diagnostics diagnostics(null_stream);
+                 std::vector<lex::StmtPtr> statements = lex::Parser(tokens, diagnostics).parse();
+                 lex::ProgramPtr program;
+                 lex::AllocationCount made =
+                     allocations_of([&] { program = lex::Program::build(std::move(statements), options); });
+                 return std::make_pair(made, tokens.size());
+             }},
+            {"environment/get", "lookup", 0, 0,
+             [](size_t size)
+             {
+                 lex::Token name(lex::TokenType::IDENTIFIER, "target", std::monostate{}, 1);
+                 auto globals = std::make_shared<lex::Environment>();
+                 globals->define(name, lex::Value(1.0));
+                 auto scope = std::make_shared<lex::Environment>(std::make_shared<lex::Environment>(globals));
+                 double sum = 0;
+                 lex::AllocationCount made = allocations_of(
+                     [&]
+                     {
+                         for (size_t i = 0; i < size; i++)
+                             sum += std::get<double>(scope->get(name));
+                     });
+                 keep = keep + static_cast<size_t>(sum);
+                 return std::make_pair(made, size);
+             }},
+        };
+
+        // the tree-walker boxes every value an expression returns in a std::any, one allocation each. The VM
+        // allocates only the strings it builds.
+        const std::string concatenation = "t = \"abcdefghijklmnopqrstuvwxyz\" + \"0123456789\";"; // no small string
+        checks.push_back(loop_check("arithmetic_loop", false, "s = s + i * 2;", 6, 0));
+        checks.push_back(loop_check("block_loop", false, "{ var d = i * 2; s = s + d; }", 9, 0));
+        checks.push_back(loop_check("string_loop", false, concatenation, 3, 0));
+        checks.push_back(loop_check("arithmetic_loop", true, "s = s + i * 2;", 0, 0));
+        checks.push_back(loop_check("block_loop", true, "{ var d = i * 2; s = s + d; }", 0, 0));
+        checks.push_back(loop_check("string_loop", true, concatenation, 1, 0));
+        return checks;
+    }
+
+    // true when every check is within its budget
+    bool check_allocations()
+    {
+        constexpr size_t SMALL = 1000;
+        constexpr size_t LARGE = 11000;
+        bool passed = true;
+        for (const AllocationCheck &check : allocation_checks())
+        {
+            auto [small, small_units] = check.run(SMALL);
+            auto [large, large_units] = check.run(LARGE);
+            double units = static_cast<double>(large_units - small_units);
+            double allocations = (static_cast<double>(large.count) - static_cast<double>(small.count)) / units;
+            double retained = static_cast<double>(large.retained() - small.retained()) / units;
+
+            // a little slack for the rounding of the division, the counts themselves are exact
+            bool within = allocations <= check.allocations + 1e-3 && retained <= check.retained + 1e-3;
+            passed = passed && within;
+            std::cerr << (within ? "[allocations] " : "[allocations] FAILED ") << check.name << ": " << allocations
+                      << " per " << check.unit << " (budget " << check.allocations << "), retained " << retained
+                      << " (budget " << check.retained << ")" << std::endl;
+        }
+        return passed;
+    }
+
+    std::string json_string(const std::string &text)
+    {
+        std::string quoted = "\"";
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                quoted += '\\';
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    // default ostream formatting turns anything from a million ns on into 1.76339e+08, which loses digits and breaks
+    // readers that cut at the decimal point (cmake/PgoReport.cmake)
+    std::string nanoseconds(double value)
+    {
+        std::ostringstream text;
+        text << std::fixed << std::setprecision(2) << value;
+        return text.str();
+    }
+
+    void write_json(std::ostream &out, const Settings &settings)
+    {
+#ifdef NDEBUG
+        const char *build = "release";
+#else
+        const char *build = "debug";
+#endif
+        out << "{\n  \"build\": " << json_string(build) << ",\n  \"repeat\": " << settings.repeat
+            << ",\n  \"min_time_ms\": " << settings.min_time_ms << ",\n  \"benchmarks\": [";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const Result &result = results[i];
+            double mean = std::accumulate(result.samples.begin(), result.samples.end(), 0.0) / result.samples.size();
+            out << (i ? ",\n" : "\n") << "    {\"name\": " << json_string(result.name)
+                << ", \"kind\": " << json_string(result.kind) << ", \"items\": " << result.items
+                << ", \"iterations\": " << result.iterations
+                << ", \"min_ns\": " << nanoseconds(*std::min_element(result.samples.begin(), result.samples.end()))
+                << ", \"median_ns\": " << nanoseconds(median(result.samples)) << ", \"mean_ns\": " << nanoseconds(mean)
+                << ", \"ns_per_item\": " << nanoseconds(median(result.samples) / result.items)
+                << ", \"allocations\": " << result.allocated.count
+                << ", \"allocated_bytes\": " << result.allocated.bytes << ", \"samples_ns\": [";
+            for (size_t s = 0; s < result.samples.size(); s++)
+                out << (s ? ", " : "") << nanoseconds(result.samples[s]);
+            out << "]}";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+    bool is_count(const std::string &text)
+    {
+        return !text.empty() && text.size() < 10 && text.find_first_not_of("0123456789") == std::string::npos;
+    }
+}
+
+int main(int argc, const char **argv)
+{
+    Settings settings;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc)
+            settings.filter = argv[++i];
+        else if (arg == "--repeat" && i + 1 < argc && is_count(argv[i + 1]) && std::stoul(argv[i + 1]) > 0)
+            settings.repeat = std::stoul(argv[++i]);
+        else if (arg == "--min-time" && i + 1 < argc && is_count(argv[i + 1]))
+            settings.min_time_ms = std::stod(argv[++i]);
+        else if (arg == "--corpus" && i + 1 < argc)
+            settings.corpus = argv[++i];
+        else if (arg == "--out" && i + 1 < argc)
+            settings.out = argv[++i];
+        else if (arg == "--seed" && i + 1 < argc && is_count(argv[i + 1]))
+            settings.seed = std::stoull(argv[++i]);
+        else if (arg == "--max-tokens" && i + 1 < argc && is_count(argv[i + 1]))
+            settings.max_tokens = std::stoul(argv[++i]);
+        else if (arg == "--check-allocations")
+            settings.check_allocations = true;
+        else
+        {
+            std::cout << "Usage: lextree_bench [--filter TEXT] [--repeat N] [--min-time MS] [--corpus DIR] [--seed N] "
+                         "[--max-tokens N] [--out FILE] [--check-allocations]"
+                      << std::endl;
+            return 64;
+        }
+    }
+
+    if (settings.check_allocations)
+        return check_allocations() ? 0 : 1;
+
+    lexer_benchmarks(settings);
+    parser_benchmarks(settings);
+    environment_benchmarks(settings);
+    dispatch_benchmarks(settings);
+    corpus_benchmarks(settings);
+    generated_benchmarks(settings);
+
+    if (settings.out.empty())
+    {
+        write_json(std::cout, settings);
+        return 0;
+    }
+    std::ofstream file(settings.out);
+    write_json(file, settings);
+    if (!file)
+    {
+        std::cerr << "Could not write: " << settings.out << std::endl;
+        return 74;
+    }
+    return 0;
+}
@@ -0,0 +1,78 @@
+// lextree_gen: writes a synthetic Lex program of a given size and shape (see Generator.h and bench/README.md)
+
+#include "Generator.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace
+{
+    bool is_count(const std::string &text)
+    {
+        return !text.empty() && text.size() < 20 && text.find_first_not_of("0123456789") == std::string::npos;
+    }
+
+    // 0.25, 1, .5
+    bool is_fraction(const std::string &text)
+    {
+        return !text.empty() && text.size() < 20 && text.find_first_not_of("0123456789.") == std::string::npos &&
+               text.find('.') == text.rfind('.') && text != ".";
+    }
+}
+
+int main(int argc, const char **argv)
+{
+    lex::GeneratorOptions options;
+    std::string out;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool count = i + 1 < argc && is_count(argv[i + 1]);
+        bool fraction = i + 1 < argc && is_fraction(argv[i + 1]);
+        if (arg == "--seed" && count)
+            options.seed = std::stoull(argv[++i]);
+        else if (arg == "--tokens" && count)
+            options.tokens = std::stoull(argv[++i]);
+        else if (arg == "--expression-depth" && count)
+            options.expression_depth = std::stoull(argv[++i]);
+        else if (arg == "--block-depth" && count)
+            options.block_depth = std::stoull(argv[++i]);
+        else if (arg == "--loop-depth" && count)
+            options.loop_depth = std::stoull(argv[++i]);
+        else if (arg == "--variables" && count)
+            options.variables = std::stoull(argv[++i]);
+        else if (arg == "--loop-trips" && count)
+            options.loop_trips = std::stoull(argv[++i]);
+        else if (arg == "--strings" && fraction)
+            options.string_density = std::strtod(argv[++i], nullptr);
+        else if (arg == "--comments" && fraction)
+            options.comment_density = std::strtod(argv[++i], nullptr);
+        else if (arg == "--out" && i + 1 < argc)
+            out = argv[++i];
+        else
+        {
+            std::cout << "Usage: lextree_gen [--seed N] [--tokens N] [--expression-depth N] [--block-depth N] "
+                         "[--loop-depth N] [--variables N] [--loop-trips N] [--strings FRACTION] "
+                         "[--comments PER_STATEMENT] [--out FILE]"
+                      << std::endl;
+            return 64;
+        }
+    }
+
+    std::string program = lex::generate_program(options);
+    if (out.empty())
+    {
+        std::cout << program;
+        return 0;
+    }
+    std::ofstream file(out);
+    file << program;
+    if (!file)
+    {
+        std::cerr << "Could not write: " << out << std::endl;
+        return 74;
+    }
+    return 0;
+}
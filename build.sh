@@ -1,6 +1,21 @@
-rm -rf build
-mkdir build
-cd build
+#!/bin/bash
+# usage: ./build.sh [debug|release|relwithdebinfo|lto|pgo]   (release by default)
+# Builds LexTree and lextree_bench into build/<configuration> with the presets of CMakePresets.json.
+# pgo runs both stages: an instrumented build trained on bench/corpus, then build/pgo-use optimized with its
+# profiles, and reports the speedup over build/release.
+set -e
+cd "$(dirname "$0")"
 
-CC=clang CXX=clang++ cmake ..
-make
\ No newline at end of file
+# clang when it is there, as before (CC/CXX override it)
+if [ -z "$CXX" ] && command -v clang++ > /dev/null; then
+    export CC=clang CXX=clang++
+fi
+
+CONFIG=${1:-release}
+if [ "$CONFIG" = pgo ]; then
+    cmake --preset release && cmake --build --preset release
+    cmake --preset pgo-generate && cmake --build --preset pgo-generate && cmake --build --preset pgo-train
+    cmake --preset pgo-use && cmake --build --preset pgo-use && cmake --build --preset pgo-report
+else
+    cmake --preset "$CONFIG" && cmake --build --preset "$CONFIG"
+fi
@@ -0,0 +1,70 @@
+# Speedup of a PGO build over a plain Release build on the corpus benchmarks, `--target lextree_pgo_report`.
+# Inputs: BASELINE (lextree_bench of the Release build), BENCH (this build's), CORPUS, OUT (where the JSON goes)
+
+if(NOT BASELINE OR NOT EXISTS ${BASELINE})
+    message(FATAL_ERROR "no Release lextree_bench to compare with (LEXTREE_PGO_BASELINE='${BASELINE}'), "
+                        "build the release preset first")
+endif()
+
+# median ns per iteration of every corpus benchmark, as "name=ns;..."
+function(run_bench binary json result)
+    execute_process(COMMAND ${binary} --corpus ${CORPUS} --filter corpus/ --out ${json} ERROR_QUIET
+                    RESULT_VARIABLE status)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "${binary} failed (${status})")
+    endif()
+    file(READ ${json} text)
+    string(JSON count LENGTH "${text}" benchmarks)
+    math(EXPR last "${count} - 1")
+    set(medians "")
+    foreach(i RANGE ${last})
+        string(JSON name GET "${text}" benchmarks ${i} name)
+        string(JSON median GET "${text}" benchmarks ${i} median_ns)
+        string(REGEX REPLACE "\\..*" "" median "${median}") # CMake math is integer only
+        list(APPEND medians "${name}=${median}")
+    endforeach()
+    set(${result} "${medians}" PARENT_SCOPE)
+endfunction()
+
+message(STATUS "benchmarking the Release build ...")
+run_bench(${BASELINE} ${OUT}/pgo-baseline.json baseline)
+message(STATUS "benchmarking the PGO build ...")
+run_bench(${BENCH} ${OUT}/pgo.json optimized)
+
+# before / after as "1.50x", in integer math
+function(speedup before after result)
+    math(EXPR hundredths "${before} * 100 / ${after}")
+    math(EXPR whole "${hundredths} / 100")
+    math(EXPR cents "${hundredths} % 100")
+    if(cents LESS 10)
+        set(cents "0${cents}")
+    endif()
+    set(${result} "${whole}.${cents}x" PARENT_SCOPE)
+endfunction()
+
+set(total_before 0)
+set(total_after 0)
+foreach(entry ${baseline})
+    string(REPLACE "=" ";" pair "${entry}")
+    list(GET pair 0 name)
+    list(GET pair 1 before)
+    foreach(other ${optimized})
+        if(other MATCHES "^${name}=([0-9]+)$")
+            set(after ${CMAKE_MATCH_1})
+        endif()
+    endforeach()
+    if(NOT after OR after EQUAL 0)
+        continue()
+    endif()
+    speedup(${before} ${after} ratio)
+    message(STATUS "${name}: ${before} ns -> ${after} ns, ${ratio}")
+    math(EXPR total_before "${total_before} + ${before}")
+    math(EXPR total_after "${total_after} + ${after}")
+    unset(after)
+endforeach()
+
+if(total_after GREATER 0)
+    speedup(${total_before} ${total_after} ratio)
+    message(STATUS "corpus total: ${total_before} ns -> ${total_after} ns, PGO speedup ${ratio} "
+                   "(results in ${OUT}/pgo-baseline.json and ${OUT}/pgo.json)")
+endif()
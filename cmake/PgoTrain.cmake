@@ -0,0 +1,42 @@
+# Training run of an instrumented (LEXTREE_PGO=GENERATE) build, `cmake --build <dir> --target lextree_pgo_train`.
+# Inputs: LEXTREE, BENCH (binaries), CORPUS (scripts), PROFILES (LEXTREE_PGO_DIR), COMPILER, LLVM_PROFDATA (Clang)
+
+# profiles of an earlier run would add up with this one
+file(REMOVE_RECURSE ${PROFILES})
+file(MAKE_DIRECTORY ${PROFILES})
+
+file(GLOB scripts ${CORPUS}/*.lex)
+if(NOT scripts)
+    message(FATAL_ERROR "no training scripts in ${CORPUS}")
+endif()
+
+foreach(script ${scripts})
+    foreach(backend "" "--vm")
+        execute_process(COMMAND ${LEXTREE} ${backend} ${script} OUTPUT_QUIET ERROR_QUIET RESULT_VARIABLE status)
+        if(NOT status EQUAL 0)
+            message(FATAL_ERROR "training run failed (${status}): lextree ${backend} ${script}")
+        endif()
+    endforeach()
+endforeach()
+
+# the micro benchmarks cover the lexer and parser on larger inputs, and profile lextree_bench itself for the report
+execute_process(COMMAND ${BENCH} --corpus ${CORPUS} --repeat 1 --min-time 20 OUTPUT_QUIET ERROR_QUIET
+                RESULT_VARIABLE status)
+if(NOT status EQUAL 0)
+    message(FATAL_ERROR "training run of lextree_bench failed (${status})")
+endif()
+
+if(COMPILER MATCHES "Clang")
+    if(NOT LLVM_PROFDATA)
+        message(FATAL_ERROR "llvm-profdata not found, it merges the raw profiles for LEXTREE_PGO=USE")
+    endif()
+    file(GLOB raw ${PROFILES}/raw/*.profraw)
+    execute_process(COMMAND ${LLVM_PROFDATA} merge -output=${PROFILES}/lextree.profdata ${raw}
+                    RESULT_VARIABLE status)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "llvm-profdata merge failed (${status})")
+    endif()
+endif()
+
+list(LENGTH scripts count)
+message(STATUS "trained on ${count} scripts, profiles in ${PROFILES}")
@@ -1,16 +1,117 @@
 #include "LexTree/LexTree.h"
+#include "LexTree/Instrumentation/Trace.h"
 #include <iostream>
+#include <cstdint>
+#include <string>
+
+namespace
+{
+    // digits only, for the numeric flags
+    bool is_count(const std::string &text)
+    {
+        return !text.empty() && text.size() < 20 && text.find_first_not_of("0123456789") == std::string::npos;
+    }
+}
 
 int main(int argc, const char ** argv)
 {
-    if (argc > 2)
+    std::string script;
+    std::string batch;
+    std::string batch_out;
+    std::string serve;
+    std::string connect;
+    std::string trace;
+    size_t jobs = 0;
+    uint64_t slice = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--vm")
+            lex::LexTree::options.use_vm = true;
+        else if (arg == "--vm-stats")
+            lex::LexTree::options.use_vm = lex::LexTree::options.vm_stats = true;
+        else if (arg == "--vm-dump")
+            lex::LexTree::options.use_vm = lex::LexTree::options.vm_dump = true;
+        else if (arg == "--emit-cpp")
+            lex::LexTree::options.emit_cpp = true;
+        else if (arg == "--dump-optimized-ast")
+            lex::LexTree::options.dump_optimized_ast = true;
+        else if (arg == "--no-optimize")
+            lex::LexTree::options.optimize = false;
+        else if (arg == "--intern")
+            lex::LexTree::options.intern = true;
+        else if (arg == "--intern-stats")
+            lex::LexTree::options.intern = lex::LexTree::options.intern_stats = true;
+        else if (arg == "--cache")
+            lex::LexTree::options.cache = true;
+        else if (arg == "--prelude" && i + 1 < argc)
+            lex::LexTree::prelude = argv[++i];
+        else if (arg == "--latency")
+            lex::LexTree::repl_latency = true;
+        else if (arg == "--batch" && i + 1 < argc)
+            batch = argv[++i];
+        else if (arg == "--batch-out" && i + 1 < argc)
+            batch_out = argv[++i];
+        else if (arg == "--jobs" && i + 1 < argc && is_count(argv[i + 1]))
+            jobs = std::stoul(argv[++i]);
+        else if (arg == "--slice" && i + 1 < argc && is_count(argv[i + 1]))
+            slice = std::stoull(argv[++i]);
+        else if (arg == "--serve" && i + 1 < argc)
+            serve = argv[++i];
+        else if (arg == "--connect" && i + 1 < argc)
+            connect = argv[++i];
+        else if (arg == "--time-limit" && i + 1 < argc && is_count(argv[i + 1]))
+            lex::LexTree::options.time_limit_ms = std::stoull(argv[++i]);
+        else if (arg == "--step-limit" && i + 1 < argc && is_count(argv[i + 1]))
+            lex::LexTree::options.step_limit = std::stoull(argv[++i]);
+        else if (arg == "--memory-limit" && i + 1 < argc && is_count(argv[i + 1]))
+            lex::LexTree::options.memory_limit = std::stoull(argv[++i]);
+        else if (arg == "--memory-stats")
+            lex::LexTree::options.memory_stats = true;
+        else if (arg == "--stats")
+            lex::LexTree::options.stats = true;
+        else if (arg == "--profile" && i + 1 < argc)
+            lex::LexTree::options.profile = argv[++i];
+        else if (arg == "--profile-every" && i + 1 < argc && is_count(argv[i + 1]))
+            lex::LexTree::options.profile_every = std::stoull(argv[++i]);
+        else if (arg == "--coverage" && i + 1 < argc)
+            lex::LexTree::options.coverage = argv[++i];
+        else if (arg == "--annotate" && i + 1 < argc)
+            lex::LexTree::options.annotate = argv[++i];
+        else if (arg == "--trace" && i + 1 < argc)
+            trace = argv[++i];
+        else if (arg == "-" && script.empty())
+            script = arg;
+        else if (arg.rfind("--", 0) != 0 && script.empty())
+            script = arg;
+        else
+        {
+            std::cout << "Usage: lextree [--vm] [--vm-stats] [--vm-dump] [--emit-cpp] [--dump-optimized-ast] [--no-optimize] [--intern] [--intern-stats] [--cache] [--prelude <script>] [--latency] [--time-limit MS] [--step-limit N] [--memory-limit BYTES] [--memory-stats] [--stats] [--profile FILE [--profile-every N]] [--coverage FILE] [--annotate FILE] [--trace FILE] [--batch <dir|manifest> [--jobs N] [--batch-out DIR] [--slice N]] [--serve <socket> [--jobs N]] [--connect <socket> <script|->] [script]" << std::endl;
+            return 64;
+        }
+    }
+
+    if (!trace.empty() && !lex::Trace::start(trace))
+        std::cerr << "[trace] this build has no trace spans, configure with -DLEXTREE_TRACING=ON" << std::endl;
+
+    if (!batch.empty())
     {
-        std::cout << "Usage: lextree [script]" << std::endl;
-        return 64;
+        return lex::LexTree::runBatch(batch, jobs, batch_out, slice);
     }
-    else if (argc == 2)
+
+    if (!serve.empty())
+    {
+        return lex::LexTree::runServer(serve, jobs);
+    }
+
+    if (!connect.empty())
+    {
+        return lex::LexTree::runClient(connect, script.empty() ? "-" : script);
+    }
+
+    if (!script.empty())
     {
-        lex::LexTree::runFile(argv[1]);
+        lex::LexTree::runFile(script);
     }
     else
     {
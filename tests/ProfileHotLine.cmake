@@ -0,0 +1,17 @@
+# cmake -DLEXTREE=<binary> -DSCRIPT=<script> -DLINE=<n> -DOUT=<folded file> -P ProfileHotLine.cmake
+# profiles the script and checks that line LINE is the hottest, with most of the samples
+execute_process(COMMAND "${LEXTREE}" --profile "${OUT}" "${SCRIPT}"
+        OUTPUT_QUIET
+        ERROR_VARIABLE report
+        RESULT_VARIABLE status)
+if(NOT status EQUAL 0)
+    message(FATAL_ERROR "${SCRIPT} failed (exit ${status}):\n${report}")
+endif()
+
+# the first row under "  line  samples       %  source"
+if(NOT report MATCHES "line +samples +% +source\n +([0-9]+) +[0-9]+ +([0-9]+)\\.[0-9]%")
+    message(FATAL_ERROR "no hot lines in the profile report:\n${report}")
+endif()
+if(NOT CMAKE_MATCH_1 EQUAL LINE OR CMAKE_MATCH_2 LESS 50)
+    message(FATAL_ERROR "expected line ${LINE} to get most of the samples:\n${report}")
+endif()
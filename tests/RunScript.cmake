@@ -0,0 +1,50 @@
+# cmake -DLEXTREE=<binary> -DSCRIPT=<name>.lex [-DFLAGS=--vm;...] [-DCACHE_DIR=<dir>] -P RunScript.cmake
+# runs the script and compares its stdout to <name>.out next to it; with CACHE_DIR it runs with --cache twice,
+# once writing the .lexc into CACHE_DIR and once loading it. Optional files next to the script: <name>.flags holds
+# more flags for every run (one line, e.g. a --step-limit), <name>.exit the expected exit code (0 otherwise).
+string(REGEX REPLACE "\\.lex$" ".out" expected_file "${SCRIPT}")
+file(READ "${expected_file}" expected)
+
+string(REGEX REPLACE "\\.lex$" ".flags" flags_file "${SCRIPT}")
+if(EXISTS "${flags_file}")
+    file(READ "${flags_file}" script_flags)
+    string(STRIP "${script_flags}" script_flags)
+    separate_arguments(script_flags UNIX_COMMAND "${script_flags}")
+    list(APPEND FLAGS ${script_flags})
+endif()
+string(REGEX REPLACE "\\.lex$" ".exit" exit_file "${SCRIPT}")
+set(expected_status 0)
+if(EXISTS "${exit_file}")
+    file(READ "${exit_file}" expected_status)
+    string(STRIP "${expected_status}" expected_status)
+endif()
+
+set(runs run)
+if(CACHE_DIR)
+    file(REMOVE_RECURSE "${CACHE_DIR}")
+    file(MAKE_DIRECTORY "${CACHE_DIR}")
+    set(ENV{LEXTREE_CACHE_DIR} "${CACHE_DIR}")
+    list(APPEND FLAGS --cache)
+    set(runs store load)
+endif()
+
+foreach(run ${runs})
+    execute_process(COMMAND "${LEXTREE}" ${FLAGS} "${SCRIPT}"
+            OUTPUT_VARIABLE output
+            ERROR_VARIABLE errors
+            RESULT_VARIABLE status)
+    if(NOT output STREQUAL expected)
+        message(FATAL_ERROR "${SCRIPT} ${FLAGS} (${run}): output differs from ${expected_file} (exit ${status})\n"
+                "--- expected\n${expected}--- got\n${output}--- stderr\n${errors}")
+    endif()
+    if(NOT status STREQUAL expected_status)
+        message(FATAL_ERROR "${SCRIPT} ${FLAGS} (${run}): exit ${status}, expected ${expected_status}\n"
+                "--- stderr\n${errors}")
+    endif()
+    if(run STREQUAL "store")
+        file(GLOB cached "${CACHE_DIR}/*.lexc")
+        if(NOT cached)
+            message(FATAL_ERROR "${SCRIPT} ${FLAGS}: no .lexc written to ${CACHE_DIR}")
+        endif()
+    endif()
+endforeach()
@@ -0,0 +1,46 @@
+// ProgramCache keeps at most its capacity of programs and evicts the least recently used one
+#include "LexTree/Core.h"
+#include <cstdio>
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool condition, const char *what)
+    {
+        if (!condition)
+        {
+            std::fprintf(stderr, "FAILED: %s\n", what);
+            failures++;
+        }
+    }
+}
+
+int main()
+{
+    lex::EngineOptions options;
+    lex::ProgramCache cache(2);
+
+    lex::ProgramPtr a = cache.get("print 1;", options);
+    cache.get("print 2;", options);
+    check(cache.get("print 1;", options) == a, "a hit returns the cached program");
+    check(cache.size() == 2 && cache.evictions() == 0, "nothing is evicted below the capacity");
+
+    // b is now the least recently used
+    cache.get("print 3;", options);
+    check(cache.size() == 2 && cache.evictions() == 1, "the third program evicts one");
+    check(cache.get("print 1;", options) == a, "the recently used program stays");
+    check(cache.hits() == 2 && cache.misses() == 3, "hits and misses so far");
+
+    cache.get("print 2;", options);
+    check(cache.misses() == 4 && cache.evictions() == 2, "the evicted program is compiled again");
+    check(a->statements.size() == 1, "an evicted program stays usable for whoever holds it");
+
+    // the same source with other switches is another entry
+    lex::EngineOptions unoptimized;
+    unoptimized.optimize = false;
+    check(cache.get("print 2;", unoptimized) != cache.get("print 2;", options), "entries are per switches");
+    check(cache.size() == 2, "the size stays at the capacity");
+
+    return failures == 0 ? 0 : 1;
+}
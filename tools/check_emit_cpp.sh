@@ -0,0 +1,57 @@
+#!/bin/bash
+# Compiles every script through `lextree --emit-cpp` and checks that the native binary
+# prints the same output (stdout, stderr and exit code) as the interpreter.
+#
+# usage: tools/check_emit_cpp.sh [path/to/LexTree] [scripts...]
+# defaults to build/release/LexTree (./build.sh) and test.lex + bench/corpus/*.lex
+
+cd "$(dirname "$0")/.."
+
+LEXTREE=${1:-build/release/LexTree}
+shift
+SCRIPTS=("$@")
+if [ ${#SCRIPTS[@]} -eq 0 ]; then
+    SCRIPTS=(test.lex bench/corpus/*.lex)
+fi
+CXX=${CXX:-c++}
+
+if [ ! -x "$LEXTREE" ]; then
+    echo "LexTree binary not found: $LEXTREE (run build.sh first)"
+    exit 1
+fi
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+failed=0
+for script in "${SCRIPTS[@]}"; do
+    name=$(basename "$script" .lex)
+
+    "$LEXTREE" "$script" > "$WORK/$name.expected" 2>&1
+    echo "exit $?" >> "$WORK/$name.expected"
+
+    if ! "$LEXTREE" --emit-cpp "$script" > "$WORK/$name.cpp"; then
+        echo "FAIL $script (emit)"
+        failed=1
+        continue
+    fi
+    if ! $CXX -std=c++20 -O2 -o "$WORK/$name" "$WORK/$name.cpp" 2> "$WORK/$name.log"; then
+        echo "FAIL $script (compile)"
+        cat "$WORK/$name.log"
+        failed=1
+        continue
+    fi
+
+    "$WORK/$name" > "$WORK/$name.actual" 2>&1
+    echo "exit $?" >> "$WORK/$name.actual"
+
+    if diff -u "$WORK/$name.expected" "$WORK/$name.actual" > "$WORK/$name.diff"; then
+        echo "ok   $script"
+    else
+        echo "FAIL $script (output differs)"
+        head -20 "$WORK/$name.diff"
+        failed=1
+    fi
+done
+
+exit $failed
@@ -0,0 +1,339 @@
+#!/usr/bin/env python3
+"""Compares the performance of two LexTree builds on the benchmark corpus.
+
+Runs every script on a baseline and a candidate build, interleaved and pinned to one CPU, `--repeat` times each.
+For every script it compares:
+- wall time;
+- peak RSS;
+- each phase `--stats` reports (lex, parse, execute, ...);
+- instructions, when `perf stat` can count them.
+
+A change is reported as significant when a Mann-Whitney U test says the two sets of samples differ and the medians
+are further apart than --threshold. With dozens of comparisons some would pass by chance, so the p-values are
+adjusted for their number (Benjamini-Hochberg, the reported q) before they are held against --alpha. The report is
+markdown on stdout, or in --out, as JSON when the file ends in .json. Standard library
+only, nothing leaves the machine.
+
+usage: tools/perf_diff.py BASELINE CANDIDATE [options] [scripts...]
+       BASELINE/CANDIDATE: a LexTree binary or a build directory with one (build/release)
+       scripts default to bench/corpus/*.lex, lextree_gen output works too
+"""
+
+import argparse
+import functools
+import glob
+import hashlib
+import json
+import math
+import os
+import platform
+import re
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+STATS_LINE = re.compile(r"^\[stats\] ([a-z ]+): ([0-9.e+-]+) ms", re.MULTILINE)
+
+
+def find_binary(path):
+    if os.path.isdir(path):
+        path = os.path.join(path, "LexTree")
+    if not (os.path.isfile(path) and os.access(path, os.X_OK)):
+        sys.exit(f"no LexTree binary at {path}")
+    return os.path.abspath(path)
+
+
+def digest(path):
+    with open(path, "rb") as file:
+        return hashlib.sha256(file.read()).hexdigest()[:12]
+
+
+# --- statistics -------------------------------------------------------------------------------------------------
+
+@functools.lru_cache(maxsize=None)
+def u_distribution(n1, n2):
+    """orderings of n1 a's and n2 b's by U (pairs with the a above the b), index is U"""
+    if n1 == 0 or n2 == 0:
+        return (1,)
+    counts = [0] * (n1 * n2 + 1)
+    for u, count in enumerate(u_distribution(n1 - 1, n2)):  # largest is an a, above all n2 b's
+        counts[u + n2] += count
+    for u, count in enumerate(u_distribution(n1, n2 - 1)):  # largest is a b
+        counts[u] += count
+    return tuple(counts)
+
+
+def mann_whitney(a, b):
+    """two-sided p-value of a Mann-Whitney U test, exact for small samples without ties"""
+    n1, n2 = len(a), len(b)
+    if n1 < 2 or n2 < 2:
+        return 1.0
+    ordered = sorted((value, i) for i, value in enumerate(a + b))
+    ranks = [0.0] * (n1 + n2)
+    ties = 0
+    i = 0
+    while i < len(ordered):
+        j = i
+        while j + 1 < len(ordered) and ordered[j + 1][0] == ordered[i][0]:
+            j += 1
+        for k in range(i, j + 1):
+            ranks[ordered[k][1]] = (i + j) / 2 + 1
+        ties += (j - i + 1) ** 3 - (j - i + 1)
+        i = j + 1
+
+    u1 = sum(ranks[:n1]) - n1 * (n1 + 1) / 2
+    u = min(u1, n1 * n2 - u1)
+    if ties == 0 and n1 * n2 <= 400:
+        counts = u_distribution(n1, n2)
+        return min(1.0, 2 * sum(counts[: int(u) + 1]) / math.comb(n1 + n2, n1))
+
+    n = n1 + n2
+    variance = n1 * n2 / 12 * ((n + 1) - ties / (n * (n - 1)))
+    if variance <= 0:
+        return 1.0  # every sample the same
+    z = (u - n1 * n2 / 2 + 0.5) / math.sqrt(variance)
+    return min(1.0, 2 * statistics.NormalDist().cdf(z))
+
+
+# --- running ----------------------------------------------------------------------------------------------------
+
+class Perf:
+    """`perf stat` for user-space instructions, if it is installed and allowed to count them"""
+
+    def __init__(self, enabled):
+        self.available = enabled and shutil.which("perf") is not None and self.count(["true"]) is not None
+
+    @staticmethod
+    def count(command):
+        with tempfile.NamedTemporaryFile("r", suffix=".perf") as out:
+            result = subprocess.run(["perf", "stat", "-x", ",", "-e", "instructions:u", "-o", out.name, "--"] + command,
+                                    stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+            if result.returncode != 0:
+                return None
+            for line in out.read().splitlines():
+                fields = line.split(",")
+                if len(fields) > 2 and fields[2].startswith("instructions") and fields[0].isdigit():
+                    return int(fields[0])
+        return None
+
+
+def run_once(command, stdout):
+    """wall seconds, peak RSS in KB, exit code and stderr of one run"""
+    with tempfile.TemporaryFile() as err:
+        start = time.perf_counter()
+        process = subprocess.Popen(command, stdout=stdout, stderr=err, stdin=subprocess.DEVNULL)
+        _, status, usage = os.wait4(process.pid, 0)
+        wall = time.perf_counter() - start
+        process.returncode = os.waitstatus_to_exitcode(status)
+        err.seek(0)
+        return wall, usage.ru_maxrss, process.returncode, err.read().decode(errors="replace")
+
+
+def output_of(command):
+    result = subprocess.run(command, capture_output=True, stdin=subprocess.DEVNULL)
+    return result.returncode, hashlib.sha256(result.stdout).hexdigest()
+
+
+def measure(builds, scripts, args, perf, log):
+    """samples[script][build][metric] = [values]; notes about scripts whose output differs between the builds"""
+    samples = {}
+    notes = []
+    flags = args.flags.split()
+    for script in scripts:
+        name = os.path.relpath(script, ROOT) if script.startswith(ROOT) else script
+        log(f"{name} ")
+        per_build = {build: {} for build in builds}
+
+        # warm-up, which also checks both builds still do the same thing
+        outputs = {build: output_of([builds[build]] + flags + [script]) for build in builds}
+        if len(set(outputs.values())) > 1:
+            notes.append(f"`{name}`: output or exit code differs between the builds")
+
+        for round_number in range(args.repeat):
+            # alternate the order so neither build always runs first after the other
+            order = list(builds) if round_number % 2 == 0 else list(reversed(builds))
+            for build in order:
+                wall, rss, _, stderr = run_once([builds[build]] + flags + ["--stats", script], subprocess.DEVNULL)
+                metrics = per_build[build]
+                metrics.setdefault("wall ms", []).append(wall * 1000)
+                metrics.setdefault("peak RSS KB", []).append(rss)
+                for phase, ms in STATS_LINE.findall(stderr):
+                    metrics.setdefault(f"{phase} ms", []).append(float(ms))
+            log(".")
+
+        if perf.available:
+            # instruction counts hardly vary, a few runs are enough
+            for _ in range(min(args.repeat, 3)):
+                for build in builds:
+                    count = perf.count([builds[build]] + flags + [script])
+                    if count is not None:
+                        per_build[build].setdefault("instructions", []).append(count)
+        log("\n")
+        samples[name] = per_build
+    return samples, notes
+
+
+# --- report -----------------------------------------------------------------------------------------------------
+
+def adjusted(p_values):
+    """Benjamini-Hochberg q-values, in the order of `p_values`"""
+    order = sorted(range(len(p_values)), key=lambda i: p_values[i])
+    q = [1.0] * len(p_values)
+    smallest = 1.0
+    for rank in range(len(order), 0, -1):
+        i = order[rank - 1]
+        smallest = min(smallest, p_values[i] * len(p_values) / rank)
+        q[i] = smallest
+    return q
+
+
+def compare(samples, args):
+    rows = []
+    for script, per_build in samples.items():
+        baseline, candidate = per_build["baseline"], per_build["candidate"]
+        for metric in baseline:
+            if metric not in candidate:
+                continue  # e.g. a phase only one build reports
+            before, after = baseline[metric], candidate[metric]
+            old, new = statistics.median(before), statistics.median(after)
+            change = (new - old) / old if old else 0.0
+            rows.append({"script": script, "metric": metric, "baseline": old, "candidate": new, "change": change,
+                         "p": mann_whitney(before, after), "baseline_samples": before, "candidate_samples": after})
+
+    for row, q in zip(rows, adjusted([row["p"] for row in rows])):
+        row["q"] = q
+        row["verdict"] = ""
+        if q < args.alpha and abs(row["change"]) >= args.threshold / 100:
+            if row["metric"] == "peak RSS KB":
+                row["verdict"] = "more memory" if row["change"] > 0 else "less memory"
+            else:
+                row["verdict"] = "slower" if row["change"] > 0 else "faster"
+    return rows
+
+
+def environment(builds, args, perf):
+    cpu_model = ""
+    try:
+        with open("/proc/cpuinfo") as info:
+            cpu_model = next((line.split(":", 1)[1].strip() for line in info if line.startswith("model name")), "")
+    except OSError:
+        pass
+    governor = ""
+    if args.cpu is not None:
+        try:
+            with open(f"/sys/devices/system/cpu/cpu{args.cpu}/cpufreq/scaling_governor") as file:
+                governor = file.read().strip()
+        except OSError:
+            pass
+    return {
+        "baseline": {"path": builds["baseline"], "sha256": digest(builds["baseline"])},
+        "candidate": {"path": builds["candidate"], "sha256": digest(builds["candidate"])},
+        "host": platform.node(),
+        "cpu": cpu_model,
+        "pinned_cpu": args.cpu,
+        "governor": governor,
+        "repeat": args.repeat,
+        "flags": args.flags,
+        "alpha": args.alpha,
+        "threshold_percent": args.threshold,
+        "instructions": perf.available,
+        "date": time.strftime("%Y-%m-%d %H:%M:%S"),
+    }
+
+
+def number(value):
+    return f"{value:,.0f}" if abs(value) >= 1000 else f"{value:.3g}"
+
+
+def markdown(rows, notes, env):
+    slower = sum(1 for row in rows if row["verdict"] in ("slower", "more memory"))
+    faster = sum(1 for row in rows if row["verdict"] in ("faster", "less memory"))
+    lines = [
+        "# LexTree performance: candidate against baseline",
+        "",
+        f"{slower} significant regressions, {faster} improvements, {len(rows) - slower - faster} unchanged "
+        f"(Mann-Whitney U, q < {env['alpha']} after Benjamini-Hochberg, at least {env['threshold_percent']}% apart, "
+        f"{env['repeat']} runs each).",
+        "",
+    ]
+    lines += [f"- {note}" for note in notes]
+    if notes:
+        lines.append("")
+    lines += ["| Script | Metric | Baseline | Candidate | Change | q | |",
+              "|--------|--------|---------:|----------:|-------:|--:|-|"]
+    for row in rows:
+        mark = {"slower": "**slower**", "more memory": "**more memory**"}.get(row["verdict"], row["verdict"])
+        lines.append(f"| {row['script']} | {row['metric']} | {number(row['baseline'])} | {number(row['candidate'])} "
+                     f"| {row['change'] * 100:+.1f}% | {row['q']:.3f} | {mark} |")
+    lines += ["", "Medians of every run. Wall time and peak RSS are of the whole process, the phases are what "
+                  "`--stats` reports.", ""]
+    lines += ["| | |", "|-|-|"]
+    lines.append(f"| Baseline | `{env['baseline']['path']}` ({env['baseline']['sha256']}) |")
+    lines.append(f"| Candidate | `{env['candidate']['path']}` ({env['candidate']['sha256']}) |")
+    lines.append(f"| Machine | {env['host']}, {env['cpu'] or 'unknown CPU'} |")
+    pinned = "not pinned" if env["pinned_cpu"] is None else f"CPU {env['pinned_cpu']}"
+    lines.append(f"| CPU | {pinned}{', governor ' + env['governor'] if env['governor'] else ''} |")
+    lines.append(f"| Flags | `{env['flags'] or '(none)'}` |")
+    lines.append(f"| Instructions | {'perf stat' if env['instructions'] else 'not counted (no usable perf)'} |")
+    lines.append(f"| Date | {env['date']} |")
+    return "\n".join(lines) + "\n"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("baseline", help="LexTree binary or build directory")
+    parser.add_argument("candidate", help="LexTree binary or build directory")
+    parser.add_argument("scripts", nargs="*", help="default: bench/corpus/*.lex")
+    parser.add_argument("--repeat", type=int, default=10, help="runs of each script on each build (default 10)")
+    parser.add_argument("--flags", default="", help="passed to both builds, e.g. \"--vm\"")
+    parser.add_argument("--cpu", type=int, help="CPU to pin the runs to (default: the last one available)")
+    parser.add_argument("--no-pin", action="store_true", help="do not pin to a CPU")
+    parser.add_argument("--no-perf", action="store_true", help="do not count instructions")
+    parser.add_argument("--alpha", type=float, default=0.05, help="significance level (default 0.05)")
+    parser.add_argument("--threshold", type=float, default=1.0,
+                        help="smallest change in %% reported as significant (default 1)")
+    parser.add_argument("--out", help="write the report here, JSON when it ends in .json")
+    parser.add_argument("--fail-on-regression", action="store_true", help="exit with 1 on a significant regression")
+    args = parser.parse_intermixed_args()
+
+    builds = {"baseline": find_binary(args.baseline), "candidate": find_binary(args.candidate)}
+    scripts = [os.path.abspath(script) for script in args.scripts] or \
+        sorted(glob.glob(os.path.join(ROOT, "bench", "corpus", "*.lex")))
+    if not scripts:
+        sys.exit("no scripts to run")
+    if args.repeat < 1:
+        sys.exit("--repeat must be at least 1")
+
+    if args.no_pin or not hasattr(os, "sched_setaffinity"):
+        args.cpu = None
+    else:
+        if args.cpu is None:
+            args.cpu = max(os.sched_getaffinity(0))
+        os.sched_setaffinity(0, {args.cpu})  # the builds inherit it
+
+    perf = Perf(not args.no_perf)
+    samples, notes = measure(builds, scripts, args, perf, lambda text: print(text, end="", file=sys.stderr, flush=True))
+    rows = compare(samples, args)
+    env = environment(builds, args, perf)
+
+    if args.out and args.out.endswith(".json"):
+        report = json.dumps({"environment": env, "notes": notes, "results": rows}, indent=2) + "\n"
+    else:
+        report = markdown(rows, notes, env)
+    if args.out:
+        with open(args.out, "w") as file:
+            file.write(report)
+        print(f"report written to {args.out}", file=sys.stderr)
+    else:
+        sys.stdout.write(report)
+
+    regressed = any(row["verdict"] in ("slower", "more memory") for row in rows)
+    return 1 if args.fail_on_regression and regressed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())